@@ -0,0 +1,144 @@
+/**
+ * @file accel_convert.h
+ * @brief Batch conversion of accelerometer readings to calibrated milli-g
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __ACCEL_CONVERT_H__
+#define __ACCEL_CONVERT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <drivers/sensor.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define ACCEL_CONVERT_AXIS_COUNT 3
+#define ACCEL_CONVERT_GAIN_UNITY_PPM 1000000
+#define ACCEL_CONVERT_GAIN_MIN_PPM 500000
+#define ACCEL_CONVERT_GAIN_MAX_PPM 1500000
+
+/* Size of one raw sample, little endian 16-bit X, Y and Z output registers */
+#define ACCEL_CONVERT_RAW_SAMPLE_SIZE 6
+
+/* Per axis correction, milli-g = gain * reading + offset */
+struct accel_calibration {
+	int16_t offset_mg[ACCEL_CONVERT_AXIS_COUNT];
+	uint32_t gain_ppm[ACCEL_CONVERT_AXIS_COUNT];
+};
+
+/* Conversion factors precalculated from a calibration, set up with
+ * AccelConvertInit and AccelConvertSetRawFormat
+ */
+struct accel_convert {
+	struct accel_calibration calibration;
+	/* Raw words are masked to their valid (left justified) bits, in both
+	 * halves so two words are masked at once
+	 */
+	uint32_t raw_mask;
+	/* Milli-g per raw word LSB in Q14 */
+	int16_t raw_scale[ACCEL_CONVERT_AXIS_COUNT];
+	/* Offset in Q14 plus the rounding constant */
+	int32_t raw_bias[ACCEL_CONVERT_AXIS_COUNT];
+	/* Milli-g per micro m/s^2 in Q40 */
+	int32_t value_scale[ACCEL_CONVERT_AXIS_COUNT];
+	/* Offset in Q40 plus the rounding constant */
+	int64_t value_bias[ACCEL_CONVERT_AXIS_COUNT];
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Gets the calibration from the project configuration, no correction
+ *        if CONFIG_ACCEL_CALIBRATION is not set
+ *
+ * @param calibration Set to the configured calibration
+ */
+void AccelCalibrationGetConfig(struct accel_calibration *calibration);
+
+/**
+ * @brief Sets up a converter for a calibration, with raw words taken as
+ *        1 milli-g per LSB until AccelConvertSetRawFormat is called
+ *
+ * @param convert Converter to set up
+ * @param calibration Correction to apply, copied into the converter
+ *
+ * @retval 0 on success, -EINVAL if a gain is outside
+ *         ACCEL_CONVERT_GAIN_MIN_PPM to ACCEL_CONVERT_GAIN_MAX_PPM
+ */
+int AccelConvertInit(struct accel_convert *convert,
+		     const struct accel_calibration *calibration);
+
+/**
+ * @brief Sets the format of the raw words passed to AccelConvertRaw. The
+ *        LIS2DH left justifies its readings, so the reading is the word
+ *        shifted right by 4 bits in high resolution mode (12-bit) or 8 bits
+ *        in low power mode (8-bit)
+ *
+ * @param convert Converter to update
+ * @param shift Number of unused low bits in each word
+ * @param sensitivity_mg Milli-g per LSB of the shifted reading
+ *
+ * @retval 0 on success, -EINVAL if the shift is over 14 bits or the
+ *         calibrated scale does not fit in Q14
+ */
+int AccelConvertSetRawFormat(struct accel_convert *convert, uint8_t shift,
+			     uint16_t sensitivity_mg);
+
+/**
+ * @brief Converts raw sensor output register samples to calibrated milli-g,
+ *        saturated to the int16_t range. On Cortex-M cores with the DSP
+ *        extension two words are processed per load with SMLAD, otherwise
+ *        this is AccelConvertRawReference
+ *
+ * @param convert Converter to use
+ * @param raw Samples of ACCEL_CONVERT_RAW_SAMPLE_SIZE bytes, no alignment
+ *            is required
+ * @param mg Set to the X, Y and Z milli-g values of each sample
+ * @param count Number of samples
+ */
+void AccelConvertRaw(const struct accel_convert *convert, const uint8_t *raw,
+		     int16_t (*mg)[ACCEL_CONVERT_AXIS_COUNT], uint32_t count);
+
+/**
+ * @brief Plain C version of AccelConvertRaw, with identical results
+ *
+ * @param convert Converter to use
+ * @param raw Samples of ACCEL_CONVERT_RAW_SAMPLE_SIZE bytes
+ * @param mg Set to the X, Y and Z milli-g values of each sample
+ * @param count Number of samples
+ */
+void AccelConvertRawReference(const struct accel_convert *convert,
+			      const uint8_t *raw,
+			      int16_t (*mg)[ACCEL_CONVERT_AXIS_COUNT],
+			      uint32_t count);
+
+/**
+ * @brief Converts sensor driver readings in m/s^2 to calibrated milli-g,
+ *        rounded to nearest and saturated to the int16_t range. Each value
+ *        takes one 32 x 32 bit multiply accumulate rather than a division
+ *
+ * @param convert Converter to use
+ * @param values X, Y and Z readings of each sample
+ * @param mg Set to the X, Y and Z milli-g values of each sample
+ * @param count Number of samples
+ */
+void AccelConvertValues(const struct accel_convert *convert,
+			const struct sensor_value *values,
+			int16_t (*mg)[ACCEL_CONVERT_AXIS_COUNT], uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ACCEL_CONVERT_H__ */
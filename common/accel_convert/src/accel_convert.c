@@ -0,0 +1,270 @@
+/**
+ * @file accel_convert.c
+ * @brief Batch conversion of accelerometer readings to calibrated milli-g
+ *
+ * The calibration gain and offset are folded into a single fixed point
+ * scale and bias per axis when the converter is set up, so converting a
+ * reading is a multiply, an add and a shift with no division.
+ *
+ * Raw output register words are 16 bits, so on the Cortex-M33 two of them
+ * are loaded and masked per instruction and each is scaled with a dual
+ * 16-bit multiply accumulate: SMLAD multiplies the bottom half by the axis
+ * scale and SMLADX the top half, the other half of the scale word being 0.
+ * The results are saturated to 16 bits and packed back into a word, so a
+ * pair of samples (six words) takes three loads and three stores.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <drivers/sensor.h>
+#if defined(__ARM_FEATURE_DSP)
+#include <arch/arm/aarch32/cortex_m/cmsis.h>
+#endif
+
+#include "accel_convert.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define Q14_BITS 14
+#define Q40_BITS 40
+#define HALF_WORD_BITS 16
+#define HALF_WORD_MASK 0xFFFF
+
+#define MICRO_UNITS 1000000LL
+#define MILLI_UNITS 1000LL
+
+#if defined(CONFIG_ACCEL_CALIBRATION)
+#define CALIBRATION_OFFSET_X CONFIG_ACCEL_CALIBRATION_OFFSET_X_MG
+#define CALIBRATION_OFFSET_Y CONFIG_ACCEL_CALIBRATION_OFFSET_Y_MG
+#define CALIBRATION_OFFSET_Z CONFIG_ACCEL_CALIBRATION_OFFSET_Z_MG
+#define CALIBRATION_GAIN_X CONFIG_ACCEL_CALIBRATION_GAIN_X_PPM
+#define CALIBRATION_GAIN_Y CONFIG_ACCEL_CALIBRATION_GAIN_Y_PPM
+#define CALIBRATION_GAIN_Z CONFIG_ACCEL_CALIBRATION_GAIN_Z_PPM
+#else
+#define CALIBRATION_OFFSET_X 0
+#define CALIBRATION_OFFSET_Y 0
+#define CALIBRATION_OFFSET_Z 0
+#define CALIBRATION_GAIN_X ACCEL_CONVERT_GAIN_UNITY_PPM
+#define CALIBRATION_GAIN_Y ACCEL_CONVERT_GAIN_UNITY_PPM
+#define CALIBRATION_GAIN_Z ACCEL_CONVERT_GAIN_UNITY_PPM
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int16_t saturate(int64_t value);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int16_t saturate(int64_t value)
+{
+	if (value > INT16_MAX) {
+		return INT16_MAX;
+	} else if (value < INT16_MIN) {
+		return INT16_MIN;
+	}
+
+	return (int16_t)value;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void AccelCalibrationGetConfig(struct accel_calibration *calibration)
+{
+	calibration->offset_mg[0] = CALIBRATION_OFFSET_X;
+	calibration->offset_mg[1] = CALIBRATION_OFFSET_Y;
+	calibration->offset_mg[2] = CALIBRATION_OFFSET_Z;
+	calibration->gain_ppm[0] = CALIBRATION_GAIN_X;
+	calibration->gain_ppm[1] = CALIBRATION_GAIN_Y;
+	calibration->gain_ppm[2] = CALIBRATION_GAIN_Z;
+}
+
+int AccelConvertInit(struct accel_convert *convert,
+		     const struct accel_calibration *calibration)
+{
+	uint64_t numerator;
+	uint8_t axis = 0;
+
+	while (axis < ACCEL_CONVERT_AXIS_COUNT) {
+		if (calibration->gain_ppm[axis] < ACCEL_CONVERT_GAIN_MIN_PPM ||
+		    calibration->gain_ppm[axis] > ACCEL_CONVERT_GAIN_MAX_PPM) {
+			return -EINVAL;
+		}
+		++axis;
+	}
+
+	convert->calibration = *calibration;
+
+	/* Milli-g = micro m/s^2 * 1000 / (SENSOR_G * 1000000) * gain, with
+	 * the gain in parts per million
+	 */
+	for (axis = 0; axis < ACCEL_CONVERT_AXIS_COUNT; ++axis) {
+		numerator = (uint64_t)calibration->gain_ppm[axis] << Q40_BITS;
+		convert->value_scale[axis] =
+			(int32_t)((numerator + (SENSOR_G * MILLI_UNITS / 2)) /
+				  (SENSOR_G * MILLI_UNITS));
+		convert->value_bias[axis] =
+			((int64_t)calibration->offset_mg[axis] << Q40_BITS) +
+			BIT64(Q40_BITS - 1);
+	}
+
+	return AccelConvertSetRawFormat(convert, 0, 1);
+}
+
+int AccelConvertSetRawFormat(struct accel_convert *convert, uint8_t shift,
+			     uint16_t sensitivity_mg)
+{
+	int16_t scale[ACCEL_CONVERT_AXIS_COUNT];
+	uint32_t mask = (HALF_WORD_MASK << shift) & HALF_WORD_MASK;
+	uint64_t numerator;
+	uint8_t axis = 0;
+
+	if (shift > Q14_BITS) {
+		return -EINVAL;
+	}
+
+	while (axis < ACCEL_CONVERT_AXIS_COUNT) {
+		numerator = ((uint64_t)sensitivity_mg << (Q14_BITS - shift)) *
+			    convert->calibration.gain_ppm[axis];
+		numerator = (numerator + (MICRO_UNITS / 2)) / MICRO_UNITS;
+
+		if (numerator > INT16_MAX) {
+			return -EINVAL;
+		}
+
+		scale[axis] = (int16_t)numerator;
+		++axis;
+	}
+
+	for (axis = 0; axis < ACCEL_CONVERT_AXIS_COUNT; ++axis) {
+		convert->raw_scale[axis] = scale[axis];
+		convert->raw_bias[axis] =
+			((int32_t)convert->calibration.offset_mg[axis]
+			 << Q14_BITS) +
+			BIT(Q14_BITS - 1);
+	}
+
+	convert->raw_mask = mask | (mask << HALF_WORD_BITS);
+
+	return 0;
+}
+
+void AccelConvertRaw(const struct accel_convert *convert, const uint8_t *raw,
+		     int16_t (*mg)[ACCEL_CONVERT_AXIS_COUNT], uint32_t count)
+{
+#if defined(__ARM_FEATURE_DSP)
+	uint32_t mask = convert->raw_mask;
+	uint32_t scale_x = (uint16_t)convert->raw_scale[0];
+	uint32_t scale_y = (uint16_t)convert->raw_scale[1];
+	uint32_t scale_z = (uint16_t)convert->raw_scale[2];
+	uint32_t bias_x = (uint32_t)convert->raw_bias[0];
+	uint32_t bias_y = (uint32_t)convert->raw_bias[1];
+	uint32_t bias_z = (uint32_t)convert->raw_bias[2];
+	uint32_t words[ACCEL_CONVERT_AXIS_COUNT];
+	int32_t low;
+	int32_t high;
+
+	/* Two samples per loop are three words: X0 Y0, Z0 X1 and Y1 Z1. The
+	 * raw buffer and the output are not always word aligned, which LDR
+	 * and STR allow
+	 */
+	while (count >= 2) {
+		memcpy(words, raw, sizeof(words));
+
+		words[0] &= mask;
+		words[1] &= mask;
+		words[2] &= mask;
+
+		low = (int32_t)__SMLAD(words[0], scale_x, bias_x);
+		high = (int32_t)__SMLADX(words[0], scale_y, bias_y);
+		words[0] = __PKHBT(__SSAT(low >> Q14_BITS, 16),
+				   __SSAT(high >> Q14_BITS, 16),
+				   HALF_WORD_BITS);
+
+		low = (int32_t)__SMLAD(words[1], scale_z, bias_z);
+		high = (int32_t)__SMLADX(words[1], scale_x, bias_x);
+		words[1] = __PKHBT(__SSAT(low >> Q14_BITS, 16),
+				   __SSAT(high >> Q14_BITS, 16),
+				   HALF_WORD_BITS);
+
+		low = (int32_t)__SMLAD(words[2], scale_y, bias_y);
+		high = (int32_t)__SMLADX(words[2], scale_z, bias_z);
+		words[2] = __PKHBT(__SSAT(low >> Q14_BITS, 16),
+				   __SSAT(high >> Q14_BITS, 16),
+				   HALF_WORD_BITS);
+
+		memcpy(mg, words, sizeof(words));
+
+		raw += 2 * ACCEL_CONVERT_RAW_SAMPLE_SIZE;
+		mg += 2;
+		count -= 2;
+	}
+#endif
+
+	AccelConvertRawReference(convert, raw, mg, count);
+}
+
+void AccelConvertRawReference(const struct accel_convert *convert,
+			      const uint8_t *raw,
+			      int16_t (*mg)[ACCEL_CONVERT_AXIS_COUNT],
+			      uint32_t count)
+{
+	uint16_t mask = (uint16_t)convert->raw_mask;
+	uint32_t i = 0;
+	uint8_t axis;
+	int16_t word;
+
+	while (i < count) {
+		for (axis = 0; axis < ACCEL_CONVERT_AXIS_COUNT; ++axis) {
+			word = (int16_t)(sys_get_le16(&raw[axis *
+							   sizeof(int16_t)]) &
+					 mask);
+			mg[i][axis] = saturate(
+				(((int32_t)word * convert->raw_scale[axis]) +
+				 convert->raw_bias[axis]) >>
+				Q14_BITS);
+		}
+
+		raw += ACCEL_CONVERT_RAW_SAMPLE_SIZE;
+		++i;
+	}
+}
+
+void AccelConvertValues(const struct accel_convert *convert,
+			const struct sensor_value *values,
+			int16_t (*mg)[ACCEL_CONVERT_AXIS_COUNT], uint32_t count)
+{
+	int64_t micro;
+	uint32_t i = 0;
+	uint8_t axis;
+
+	while (i < count) {
+		for (axis = 0; axis < ACCEL_CONVERT_AXIS_COUNT; ++axis) {
+			/* Far beyond the int16_t milli-g range if clamped */
+			micro = ((int64_t)values[axis].val1 * MICRO_UNITS) +
+				values[axis].val2;
+			micro = MAX(MIN(micro, INT32_MAX), INT32_MIN);
+
+			mg[i][axis] = saturate(
+				(((int64_t)(int32_t)micro *
+				  convert->value_scale[axis]) +
+				 convert->value_bias[axis]) >>
+				Q40_BITS);
+		}
+
+		values += ACCEL_CONVERT_AXIS_COUNT;
+		++i;
+	}
+}
@@ -26,6 +26,9 @@ LOG_MODULE_REGISTER(bl5340_spi_ili9340);
 #include "bl5340_spi_ili9340.h"
 #include "bl5340_gpio.h"
 #include "bl5340_i2c_ft5336.h"
+#ifdef CONFIG_LVGL_ASYNC_FLUSH
+#include "lvgl_async_flush.h"
+#endif
 
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
@@ -182,6 +185,13 @@ static void bl5340_spi_ili9340_background_thread(void *unused1, void *unused2,
 	if (!dev) {
 		BL5340_SPI_ILI9340_LOG_ERR("Couldn't find SPI device!\n");
 	} else {
+#ifdef CONFIG_LVGL_ASYNC_FLUSH
+		/* Send draw buffers with asynchronous SPI transfers */
+		if (LvglAsyncFlushInit()) {
+			BL5340_SPI_ILI9340_LOG_ERR(
+				"Couldn't set up asynchronous flush!\n");
+		}
+#endif
 		lv_task_handler();
 		display_blanking_off(dev);
 	}
@@ -0,0 +1,59 @@
+/**
+ * @file cycles.h
+ * @brief CPU cycle counter access for the vibration demo benchmarks
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __CYCLES_H__
+#define __CYCLES_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+#include <arch/arm/aarch32/cortex_m/cmsis.h>
+#endif
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+/**
+ * @brief Enables the CPU cycle counter. The kernel cycle counter is used
+ *        where there is no DWT (it runs at the system timer rate, which is
+ *        far lower than the CPU clock on the BL5340)
+ */
+static inline void CyclesInit(void)
+{
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/**
+ * @brief Gets the current CPU cycle count
+ *
+ * @retval Free running cycle count
+ */
+static inline uint32_t CyclesGet(void)
+{
+#if defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	return DWT->CYCCNT;
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CYCLES_H__ */
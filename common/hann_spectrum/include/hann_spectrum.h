@@ -0,0 +1,86 @@
+/**
+ * @file hann_spectrum.h
+ * @brief Hann windowed Q15 magnitude spectrum of accelerometer samples
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HANN_SPECTRUM_H__
+#define __HANN_SPECTRUM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <arm_math.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* The FFT, window and working buffers for one window length. arm_rfft_q15
+ * modifies its input and writes the conjugate symmetric half of the
+ * spectrum as well, so needs a copy of the input and twice the output.
+ */
+struct hann_spectrum {
+	arm_rfft_instance_q15 rfft;
+	q15_t *hann;
+	q15_t *scratch;
+	q15_t *fft_output;
+	uint16_t samples;
+};
+
+/**
+ * @brief Statically defines a spectrum and its buffers
+ *
+ * @param name Name of the spectrum
+ * @param length Window length, a power of two supported by arm_rfft_q15
+ */
+#define HANN_SPECTRUM_DEFINE(name, length)                                     \
+	BUILD_ASSERT(((length) & ((length) - 1)) == 0,                         \
+		     "Spectrum window length must be a power of two");         \
+	static q15_t _hann_spectrum_window_##name[length];                     \
+	static q15_t _hann_spectrum_scratch_##name[length];                    \
+	static q15_t _hann_spectrum_output_##name[(length) * 2];               \
+	static struct hann_spectrum name = {                                   \
+		.hann = _hann_spectrum_window_##name,                          \
+		.scratch = _hann_spectrum_scratch_##name,                      \
+		.fft_output = _hann_spectrum_output_##name,                    \
+		.samples = (length),                                           \
+	}
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the FFT and fills in the Hann window
+ *
+ * @param spectrum Spectrum to set up
+ *
+ * @retval 0 on success, -EINVAL if the window length is not supported by
+ *         the FFT
+ */
+int HannSpectrumInit(struct hann_spectrum *spectrum);
+
+/**
+ * @brief Calculates the amplitude of each bin of a window of samples, except
+ *        bin 0 (DC)
+ *
+ * @param spectrum Spectrum to calculate with
+ * @param data Window of samples with the mean removed, which is not changed
+ * @param peak Largest magnitude of any sample in data
+ * @param amplitudes Set to the amplitudes of bins 1 to samples / 2 in the
+ *                   units of the samples, saturated to UINT16_MAX
+ */
+void HannSpectrumAmplitudes(struct hann_spectrum *spectrum, const q15_t *data,
+			    q15_t peak, uint16_t *amplitudes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HANN_SPECTRUM_H__ */
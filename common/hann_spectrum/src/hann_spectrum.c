@@ -0,0 +1,88 @@
+/**
+ * @file hann_spectrum.c
+ * @brief Hann windowed Q15 magnitude spectrum of accelerometer samples
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <arm_math.h>
+
+#include "hann_spectrum.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+/* arm_rfft_q15 scales its output by 1 / samples, a Hann window halves the
+ * amplitude of a tone and arm_cmplx_mag_q15 outputs in 2.14 format. A bin
+ * centred sine wave of amplitude A therefore has a magnitude of A / 8.
+ */
+#define AMPLITUDE_SHIFT 3
+
+#define Q15_ONE 32768
+#define Q15_MAX 32767
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int HannSpectrumInit(struct hann_spectrum *spectrum)
+{
+	uint32_t i = 0;
+
+	if (arm_rfft_init_q15(&spectrum->rfft, spectrum->samples, 0, 1) !=
+	    ARM_MATH_SUCCESS) {
+		return -EINVAL;
+	}
+
+	/* Hann window, 0.5 - 0.5 * cos(2 * pi * n / N) */
+	while (i < spectrum->samples) {
+		spectrum->hann[i] =
+			(Q15_MAX - arm_cos_q15((q15_t)((i * Q15_ONE) /
+						       spectrum->samples))) >>
+			1;
+		++i;
+	}
+
+	return 0;
+}
+
+void HannSpectrumAmplitudes(struct hann_spectrum *spectrum, const q15_t *data,
+			    q15_t peak, uint16_t *amplitudes)
+{
+	uint32_t bins = spectrum->samples / 2;
+	int8_t shift = 0;
+	uint32_t amplitude;
+	uint32_t i;
+
+	/* Use the full Q15 range so that low amplitude vibration keeps its
+	 * resolution through the scaled down FFT stages
+	 */
+	if (peak > 0) {
+		while ((peak << (shift + 1)) <= Q15_MAX) {
+			++shift;
+		}
+	}
+
+	arm_shift_q15(data, shift, spectrum->fft_output, spectrum->samples);
+	arm_mult_q15(spectrum->fft_output, spectrum->hann, spectrum->scratch,
+		     spectrum->samples);
+	arm_rfft_q15(&spectrum->rfft, spectrum->scratch, spectrum->fft_output);
+
+	/* The windowed input is no longer needed, so the magnitudes of bins
+	 * 0 to samples / 2 go in its place
+	 */
+	arm_cmplx_mag_q15(spectrum->fft_output, spectrum->scratch, bins + 1);
+
+	for (i = 0; i < bins; ++i) {
+		amplitude = ((uint32_t)spectrum->scratch[i + 1]
+			     << AMPLITUDE_SHIFT) >>
+			    shift;
+		amplitudes[i] = (uint16_t)MIN(amplitude, UINT16_MAX);
+	}
+}
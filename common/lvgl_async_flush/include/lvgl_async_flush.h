@@ -0,0 +1,76 @@
+/**
+ * @file lvgl_async_flush.h
+ * @brief Asynchronous double buffered LVGL flush for the ILI9340 display
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LVGL_ASYNC_FLUSH_H__
+#define __LVGL_ASYNC_FLUSH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+struct lvgl_flush_stats {
+	/* Display refreshes completed by LVGL */
+	uint32_t frames;
+	/* Refreshes per second since the statistics were reset, in tenths */
+	uint32_t fps_x10;
+	/* Time LVGL took to render and flush the latest refresh */
+	uint32_t frame_ms;
+	/* Draw buffers sent to the display */
+	uint32_t flushes;
+	/* SPI transfer time of the latest draw buffer */
+	uint32_t flush_us;
+	uint32_t max_flush_us;
+	/* Pixel data throughput of the SPI transfers */
+	uint32_t flush_kbps;
+	/* Total time LVGL waited for a draw buffer to be sent before it could
+	 * render into it
+	 */
+	uint32_t wait_us;
+	/* Transfers which failed to start or complete */
+	uint32_t errors;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Replaces the flush of the default LVGL display with asynchronous
+ *        SPI transfers and starts the thread which completes them. Must be
+ *        called from the thread which calls lv_task_handler, before the
+ *        display is first refreshed
+ *
+ * @retval 0 on success, -ENODEV if the display, SPI bus or command/data
+ *         GPIO is not available
+ */
+int LvglAsyncFlushInit(void);
+
+/**
+ * @brief Gets the frame rate and flush statistics
+ *
+ * @param stats Copy of the statistics
+ */
+void LvglAsyncFlushGetStats(struct lvgl_flush_stats *stats);
+
+/**
+ * @brief Clears the frame rate and flush statistics
+ */
+void LvglAsyncFlushResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LVGL_ASYNC_FLUSH_H__ */
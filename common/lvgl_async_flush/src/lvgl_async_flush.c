@@ -0,0 +1,403 @@
+/**
+ * @file lvgl_async_flush.c
+ * @brief Asynchronous double buffered LVGL flush for the ILI9340 display
+ *
+ * The display driver write blocks the calling thread until the whole draw
+ * buffer has been clocked out over SPI, so LVGL cannot render while the
+ * display is being updated. Here the memory window is set with short
+ * blocking commands and the pixel data is sent with an asynchronous SPI
+ * transfer, which the SPIM EasyDMA moves without the CPU. LVGL renders the
+ * next part of the screen into its second draw buffer in the meantime and
+ * only waits when it needs the buffer still being sent.
+ *
+ * The SPI driver raises a poll signal from its interrupt when a transfer
+ * completes, and a high priority thread waiting on it hands the buffer
+ * back to LVGL with lv_disp_flush_ready.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <device.h>
+#include <logging/log.h>
+#include <sys/byteorder.h>
+#include <drivers/gpio.h>
+#include <drivers/spi.h>
+#include <lvgl.h>
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+#include "lvgl_async_flush.h"
+
+LOG_MODULE_REGISTER(lvgl_async_flush);
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define FLUSH_STACK_SIZE 1024
+
+#define TFT_NODE DT_INST(0, ilitek_ili9340)
+#if !DT_NODE_HAS_STATUS(TFT_NODE, okay)
+#error Unsupported TFT
+#endif
+
+/* ILI9340 commands used to write an area of the display */
+#define ILI9340_CMD_COLUMN_ADDR 0x2A
+#define ILI9340_CMD_PAGE_ADDR 0x2B
+#define ILI9340_CMD_MEM_WRITE 0x2C
+
+/* Logical levels of the command/data GPIO, as used by the display driver */
+#define ILI9340_CMD_DATA_COMMAND 1
+#define ILI9340_CMD_DATA_DATA 0
+
+/* Draw buffers are sent as they are, so they must already be in the
+ * display's big endian RGB565 format
+ */
+BUILD_ASSERT(LV_COLOR_DEPTH == 16, "ILI9340 flush needs 16-bit colour");
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct device *flush_spi_dev;
+static const struct device *flush_cmd_data_dev;
+static struct spi_config flush_spi_config;
+#if DT_SPI_DEV_HAS_CS_GPIOS(TFT_NODE)
+static struct spi_cs_control flush_cs_control;
+#endif
+
+/* Pixel data transfer in progress */
+static struct spi_buf flush_buf;
+static const struct spi_buf_set flush_bufs = { .buffers = &flush_buf,
+					       .count = 1 };
+static lv_disp_drv_t *flush_driver;
+static uint32_t flush_start;
+
+/* Raised by the SPI driver when the pixel data has been sent */
+static struct k_poll_signal flush_signal;
+static struct k_poll_event flush_event;
+
+/* Given each time a draw buffer is handed back, so LVGL can sleep rather
+ * than spin while it waits for one
+ */
+static K_SEM_DEFINE(flush_done_sem, 0, 1);
+
+K_THREAD_STACK_DEFINE(flush_stack_area, FLUSH_STACK_SIZE);
+static struct k_thread flush_thread_data;
+
+static struct lvgl_flush_stats flush_stats;
+static uint64_t flush_total_bytes;
+static uint64_t flush_total_us;
+static int64_t flush_stats_start_ms;
+static struct k_spinlock flush_stats_lock;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int flush_command(uint8_t command, const void *data, size_t length);
+static void flush_cb(lv_disp_drv_t *driver, const lv_area_t *area,
+		     lv_color_t *color_p);
+static void flush_wait_cb(lv_disp_drv_t *driver);
+static void flush_monitor_cb(lv_disp_drv_t *driver, uint32_t time,
+			     uint32_t px);
+static void flush_record(uint32_t flush_us, uint32_t bytes, bool error);
+static void flush_thread(void *unused1, void *unused2, void *unused3);
+#if defined(CONFIG_SHELL)
+static int cmd_lcd_stats(const struct shell *shell, size_t argc, char **argv);
+static int cmd_lcd_reset(const struct shell *shell, size_t argc, char **argv);
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Sends a command and its parameters with blocking SPI writes. */
+static int flush_command(uint8_t command, const void *data, size_t length)
+{
+	struct spi_buf buf = { .buf = &command, .len = sizeof(command) };
+	struct spi_buf_set bufs = { .buffers = &buf, .count = 1 };
+	int rc;
+
+	gpio_pin_set(flush_cmd_data_dev, DT_GPIO_PIN(TFT_NODE, cmd_data_gpios),
+		     ILI9340_CMD_DATA_COMMAND);
+	rc = spi_write(flush_spi_dev, &flush_spi_config, &bufs);
+
+	if (rc == 0 && data != NULL) {
+		buf.buf = (void *)data;
+		buf.len = length;
+		gpio_pin_set(flush_cmd_data_dev,
+			     DT_GPIO_PIN(TFT_NODE, cmd_data_gpios),
+			     ILI9340_CMD_DATA_DATA);
+		rc = spi_write(flush_spi_dev, &flush_spi_config, &bufs);
+	}
+
+	return rc;
+}
+
+/** @brief Sets the display memory window to the area and starts sending the
+ *  draw buffer. LVGL does not call this again until the previous buffer has
+ *  been handed back, so only one transfer is ever in progress.
+ */
+static void flush_cb(lv_disp_drv_t *driver, const lv_area_t *area,
+		     lv_color_t *color_p)
+{
+	uint16_t window[2];
+	uint32_t bytes = lv_area_get_size(area) * sizeof(lv_color_t);
+	int rc;
+
+	window[0] = sys_cpu_to_be16(area->x1);
+	window[1] = sys_cpu_to_be16(area->x2);
+	rc = flush_command(ILI9340_CMD_COLUMN_ADDR, window, sizeof(window));
+
+	if (rc == 0) {
+		window[0] = sys_cpu_to_be16(area->y1);
+		window[1] = sys_cpu_to_be16(area->y2);
+		rc = flush_command(ILI9340_CMD_PAGE_ADDR, window,
+				   sizeof(window));
+	}
+
+	if (rc == 0) {
+		rc = flush_command(ILI9340_CMD_MEM_WRITE, NULL, 0);
+	}
+
+	if (rc == 0) {
+		gpio_pin_set(flush_cmd_data_dev,
+			     DT_GPIO_PIN(TFT_NODE, cmd_data_gpios),
+			     ILI9340_CMD_DATA_DATA);
+
+		flush_buf.buf = color_p;
+		flush_buf.len = bytes;
+		flush_driver = driver;
+		flush_start = k_cycle_get_32();
+		rc = spi_write_async(flush_spi_dev, &flush_spi_config,
+				     &flush_bufs, &flush_signal);
+	}
+
+	if (rc != 0) {
+		LOG_ERR("Display flush failed (%d)", rc);
+		flush_record(0, 0, true);
+		lv_disp_flush_ready(driver);
+	}
+}
+
+/** @brief Called by LVGL while it waits for a draw buffer to be sent. */
+static void flush_wait_cb(lv_disp_drv_t *driver)
+{
+	uint32_t start = k_cycle_get_32();
+	uint32_t wait_us;
+	k_spinlock_key_t key;
+
+	ARG_UNUSED(driver);
+
+	/* LVGL checks the buffer again on return, so a give left over from a
+	 * buffer it did not wait for only costs an extra call
+	 */
+	(void)k_sem_take(&flush_done_sem, K_FOREVER);
+	wait_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	key = k_spin_lock(&flush_stats_lock);
+	flush_stats.wait_us += wait_us;
+	k_spin_unlock(&flush_stats_lock, key);
+}
+
+/** @brief Called by LVGL when a refresh of the display has completed. */
+static void flush_monitor_cb(lv_disp_drv_t *driver, uint32_t time,
+			     uint32_t px)
+{
+	k_spinlock_key_t key = k_spin_lock(&flush_stats_lock);
+
+	ARG_UNUSED(driver);
+	ARG_UNUSED(px);
+
+	++flush_stats.frames;
+	flush_stats.frame_ms = time;
+	k_spin_unlock(&flush_stats_lock, key);
+}
+
+static void flush_record(uint32_t flush_us, uint32_t bytes, bool error)
+{
+	k_spinlock_key_t key = k_spin_lock(&flush_stats_lock);
+
+	if (error) {
+		++flush_stats.errors;
+	} else {
+		++flush_stats.flushes;
+		flush_stats.flush_us = flush_us;
+		if (flush_us > flush_stats.max_flush_us) {
+			flush_stats.max_flush_us = flush_us;
+		}
+		flush_total_bytes += bytes;
+		flush_total_us += flush_us;
+	}
+	k_spin_unlock(&flush_stats_lock, key);
+}
+
+/** @brief Hands each draw buffer back to LVGL once it has been sent. */
+static void flush_thread(void *unused1, void *unused2, void *unused3)
+{
+	unsigned int signaled;
+	int result;
+
+	ARG_UNUSED(unused1);
+	ARG_UNUSED(unused2);
+	ARG_UNUSED(unused3);
+
+	while (1) {
+		(void)k_poll(&flush_event, 1, K_FOREVER);
+		k_poll_signal_check(&flush_signal, &signaled, &result);
+		k_poll_signal_reset(&flush_signal);
+		flush_event.state = K_POLL_STATE_NOT_READY;
+
+		if (result != 0) {
+			LOG_ERR("Display transfer failed (%d)", result);
+		}
+		flush_record(k_cyc_to_us_floor32(k_cycle_get_32() - flush_start),
+			     flush_buf.len, (result != 0));
+
+		lv_disp_flush_ready(flush_driver);
+		k_sem_give(&flush_done_sem);
+	}
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_lcd_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	struct lvgl_flush_stats stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	LvglAsyncFlushGetStats(&stats);
+
+	shell_print(shell, "Frames: %u, %u.%u fps", stats.frames,
+		    stats.fps_x10 / 10, stats.fps_x10 % 10);
+	shell_print(shell, "Frame time: %u ms", stats.frame_ms);
+	shell_print(shell, "Flushes: %u (%u failed)", stats.flushes,
+		    stats.errors);
+	shell_print(shell, "Flush time: %u us (max %u us), %u kB/s",
+		    stats.flush_us, stats.max_flush_us, stats.flush_kbps);
+	shell_print(shell, "Waiting for a buffer: %u us", stats.wait_us);
+
+	return 0;
+}
+
+static int cmd_lcd_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	LvglAsyncFlushResetStats();
+	shell_print(shell, "Statistics cleared");
+
+	return 0;
+}
+#endif
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int LvglAsyncFlushInit(void)
+{
+	lv_disp_t *disp = lv_disp_get_default();
+	lv_disp_drv_t driver;
+
+	flush_spi_dev = device_get_binding(DT_BUS_LABEL(TFT_NODE));
+	flush_cmd_data_dev =
+		device_get_binding(DT_GPIO_LABEL(TFT_NODE, cmd_data_gpios));
+
+	if (disp == NULL || flush_spi_dev == NULL ||
+	    flush_cmd_data_dev == NULL) {
+		LOG_ERR("Display flush devices were not found");
+		return -ENODEV;
+	}
+
+	/* Same bus settings as the display driver, which has already
+	 * configured the command/data GPIO and reset the display
+	 */
+	flush_spi_config.frequency = DT_PROP(TFT_NODE, spi_max_frequency);
+	flush_spi_config.operation = SPI_OP_MODE_MASTER | SPI_WORD_SET(8);
+	flush_spi_config.slave = DT_REG_ADDR(TFT_NODE);
+#if DT_SPI_DEV_HAS_CS_GPIOS(TFT_NODE)
+	flush_cs_control.gpio_dev =
+		device_get_binding(DT_SPI_DEV_CS_GPIOS_LABEL(TFT_NODE));
+	flush_cs_control.gpio_pin = DT_SPI_DEV_CS_GPIOS_PIN(TFT_NODE);
+	flush_cs_control.gpio_dt_flags = DT_SPI_DEV_CS_GPIOS_FLAGS(TFT_NODE);
+	flush_cs_control.delay = 0;
+	flush_spi_config.cs = &flush_cs_control;
+#endif
+
+	k_poll_signal_init(&flush_signal);
+	k_poll_event_init(&flush_event, K_POLL_TYPE_SIGNAL,
+			  K_POLL_MODE_NOTIFY_ONLY, &flush_signal);
+
+	k_thread_create(&flush_thread_data, flush_stack_area,
+			K_THREAD_STACK_SIZEOF(flush_stack_area), flush_thread,
+			NULL, NULL, NULL, CONFIG_LVGL_ASYNC_FLUSH_PRIORITY, 0,
+			K_NO_WAIT);
+	k_thread_name_set(&flush_thread_data, "lcd_flush");
+
+	LvglAsyncFlushResetStats();
+
+	driver = disp->driver;
+	driver.flush_cb = flush_cb;
+	driver.wait_cb = flush_wait_cb;
+	driver.monitor_cb = flush_monitor_cb;
+	lv_disp_drv_update(disp, &driver);
+
+	if (!lv_disp_is_double_buf(disp)) {
+		LOG_WRN("Single draw buffer, rendering waits for each flush");
+	}
+
+	return 0;
+}
+
+void LvglAsyncFlushGetStats(struct lvgl_flush_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&flush_stats_lock);
+	int64_t elapsed_ms = k_uptime_get() - flush_stats_start_ms;
+
+	*stats = flush_stats;
+	if (elapsed_ms > 0) {
+		stats->fps_x10 =
+			(uint32_t)(((uint64_t)flush_stats.frames * 10000) /
+				   elapsed_ms);
+	}
+	/* Bytes per ms is kB/s */
+	if (flush_total_us > 0) {
+		stats->flush_kbps =
+			(uint32_t)((flush_total_bytes * 1000) / flush_total_us);
+	}
+	k_spin_unlock(&flush_stats_lock, key);
+}
+
+void LvglAsyncFlushResetStats(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&flush_stats_lock);
+
+	memset(&flush_stats, 0, sizeof(flush_stats));
+	flush_total_bytes = 0;
+	flush_total_us = 0;
+	flush_stats_start_ms = k_uptime_get();
+	k_spin_unlock(&flush_stats_lock, key);
+}
+
+/******************************************************************************/
+/* Shell Command Registration                                                 */
+/******************************************************************************/
+#if defined(CONFIG_SHELL)
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	lcd_cmds,
+	SHELL_CMD(stats, NULL, "Show display frame rate and flush statistics",
+		  cmd_lcd_stats),
+	SHELL_CMD(reset, NULL, "Clear display frame rate and flush statistics",
+		  cmd_lcd_reset),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(lcd, &lcd_cmds, "Display commands", NULL);
+#endif
@@ -0,0 +1,134 @@
+/**
+ * @file sample_ring.h
+ * @brief Lock-free single producer/single consumer sample ring buffer
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SAMPLE_RING_H__
+#define __SAMPLE_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/atomic.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Holds samples of any one type, set by SAMPLE_RING_DEFINE. The head is
+ * only written by the producer and the tail only by the consumer, both are
+ * free running and wrap with the power of two size
+ */
+struct sample_ring {
+	uint8_t *buffer;
+	size_t sample_size;
+	uint32_t mask;
+	atomic_t head;
+	atomic_t tail;
+	/* Producer owned statistics */
+	uint32_t overruns;
+	uint32_t high_water;
+};
+
+/**
+ * @brief Statically defines a sample ring
+ *
+ * @param name Name of the ring
+ * @param type Type of the samples, which are copied in and out of the ring
+ * @param samples Number of samples the ring holds, must be a power of two
+ */
+#define SAMPLE_RING_DEFINE(name, type, samples)                                \
+	BUILD_ASSERT(((samples) & ((samples) - 1)) == 0,                       \
+		     "Sample ring size must be a power of two");               \
+	static type _sample_ring_buffer_##name[samples];                       \
+	static struct sample_ring name = {                                     \
+		.buffer = (uint8_t *)_sample_ring_buffer_##name,               \
+		.sample_size = sizeof(type),                                   \
+		.mask = (samples) - 1,                                         \
+	}
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Adds a sample to the ring, must only be called by the producer
+ *
+ * @param ring Ring to add to
+ * @param sample Sample to add, of the type the ring was defined with
+ *
+ * @retval False if the ring was full and the sample was dropped
+ */
+bool SampleRingPut(struct sample_ring *ring, const void *sample);
+
+/**
+ * @brief Removes the oldest sample from the ring, must only be called by the
+ *        consumer
+ *
+ * @param ring Ring to remove from
+ * @param sample Set to the removed sample, of the type the ring was defined
+ *               with
+ *
+ * @retval False if the ring was empty
+ */
+bool SampleRingGet(struct sample_ring *ring, void *sample);
+
+/**
+ * @brief Gets the number of samples waiting in the ring
+ *
+ * @param ring Ring to check
+ *
+ * @retval Number of samples
+ */
+uint32_t SampleRingUsed(struct sample_ring *ring);
+
+/**
+ * @brief Gets the free running count of samples added to the ring, which
+ *        wraps at 2^32. The sample added with this count is taken once
+ *        SampleRingTaken passes it
+ *
+ * @param ring Ring to check
+ *
+ * @retval Samples added since the ring was defined
+ */
+static inline uint32_t SampleRingAdded(struct sample_ring *ring)
+{
+	return (uint32_t)atomic_get(&ring->head);
+}
+
+/**
+ * @brief Gets the free running count of samples taken from the ring, which
+ *        wraps at 2^32
+ *
+ * @param ring Ring to check
+ *
+ * @retval Samples taken since the ring was defined
+ */
+static inline uint32_t SampleRingTaken(struct sample_ring *ring)
+{
+	return (uint32_t)atomic_get(&ring->tail);
+}
+
+/**
+ * @brief Gets the number of samples the ring can hold
+ *
+ * @param ring Ring to check
+ *
+ * @retval Capacity in samples
+ */
+static inline uint32_t SampleRingSize(const struct sample_ring *ring)
+{
+	return ring->mask + 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_RING_H__ */
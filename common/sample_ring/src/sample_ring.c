@@ -0,0 +1,65 @@
+/**
+ * @file sample_ring.c
+ * @brief Lock-free single producer/single consumer sample ring buffer
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <sys/atomic.h>
+
+#include "sample_ring.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+bool SampleRingPut(struct sample_ring *ring, const void *sample)
+{
+	/* atomic_get/atomic_set are sequentially consistent so the sample is
+	 * stored before the consumer can observe the new head
+	 */
+	uint32_t head = (uint32_t)atomic_get(&ring->head);
+	uint32_t used = head - (uint32_t)atomic_get(&ring->tail);
+
+	if (used > ring->mask) {
+		++ring->overruns;
+		return false;
+	}
+
+	memcpy(&ring->buffer[(head & ring->mask) * ring->sample_size], sample,
+	       ring->sample_size);
+	atomic_set(&ring->head, (atomic_val_t)(head + 1));
+
+	if ((used + 1) > ring->high_water) {
+		ring->high_water = used + 1;
+	}
+
+	return true;
+}
+
+bool SampleRingGet(struct sample_ring *ring, void *sample)
+{
+	uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+
+	if (tail == (uint32_t)atomic_get(&ring->head)) {
+		return false;
+	}
+
+	memcpy(sample, &ring->buffer[(tail & ring->mask) * ring->sample_size],
+	       ring->sample_size);
+	atomic_set(&ring->tail, (atomic_val_t)(tail + 1));
+
+	return true;
+}
+
+uint32_t SampleRingUsed(struct sample_ring *ring)
+{
+	return (uint32_t)atomic_get(&ring->head) -
+	       (uint32_t)atomic_get(&ring->tail);
+}
@@ -0,0 +1,296 @@
+/**
+ * @file stream_stats.h
+ * @brief Fixed point streaming statistics for accelerometer samples
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __STREAM_STATS_H__
+#define __STREAM_STATS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Fractional bits of the Welford mean and squared deviation sum */
+#define STREAM_VARIANCE_Q_BITS 8
+/* Fractional bits of the EWMA value */
+#define STREAM_EWMA_Q_BITS 16
+/* Largest EWMA shift, giving a time constant of about 32768 samples */
+#define STREAM_EWMA_SHIFT_MAX 15
+
+/* Mean and variance of the last size samples. The sum and sum of squares
+ * are exact for 16-bit samples, so removing the oldest sample never leaves
+ * a rounding error behind however long the window runs
+ */
+struct stream_window {
+	int16_t *samples;
+	uint16_t size;
+	/* Position the next sample is written to, which is also the oldest
+	 * sample once the window is full
+	 */
+	uint16_t next;
+	uint16_t count;
+	int32_t sum;
+	uint64_t sum_squares;
+};
+
+/* Welford mean and variance of every sample since the last reset */
+struct stream_variance {
+	uint32_t count;
+	/* Mean in Q8 */
+	int32_t mean;
+	/* Sum of squared deviations from the mean in Q8 */
+	uint64_t m2;
+};
+
+/* Exponentially weighted moving average, each sample weighted 2^-shift */
+struct stream_ewma {
+	/* Average in Q16 */
+	int32_t value;
+	uint8_t shift;
+	bool primed;
+};
+
+struct stream_minmax_entry {
+	uint32_t sequence;
+	int16_t value;
+};
+
+/* Circular queue of the samples which can still become the minimum or the
+ * maximum, oldest first, with values rising (minimum) or falling (maximum)
+ */
+struct stream_minmax_queue {
+	struct stream_minmax_entry *entries;
+	uint16_t head;
+	uint16_t count;
+};
+
+/* Minimum and maximum of the last size samples. Each sample is added to
+ * and removed from each queue at most once, so an update takes amortised
+ * constant time whatever the window size
+ */
+struct stream_minmax {
+	struct stream_minmax_queue min;
+	struct stream_minmax_queue max;
+	uint16_t size;
+	/* Number of the next sample added */
+	uint32_t sequence;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up an empty sliding window
+ *
+ * @param window Window to set up
+ * @param buffer Storage for size samples
+ * @param size Number of samples in the window, at least 1
+ */
+void StreamWindowInit(struct stream_window *window, int16_t *buffer,
+		      uint16_t size);
+
+/**
+ * @brief Removes all samples from the window
+ *
+ * @param window Window to clear
+ */
+void StreamWindowReset(struct stream_window *window);
+
+/**
+ * @brief Adds a sample, replacing the oldest once the window is full
+ *
+ * @param window Window to add to
+ * @param value Sample to add
+ */
+static inline void StreamWindowAdd(struct stream_window *window, int16_t value)
+{
+	int16_t oldest = 0;
+
+	if (window->count == window->size) {
+		oldest = window->samples[window->next];
+	} else {
+		++window->count;
+	}
+
+	window->samples[window->next] = value;
+	window->sum += (int32_t)value - oldest;
+	window->sum_squares += (uint32_t)((int32_t)value * value);
+	window->sum_squares -= (uint32_t)((int32_t)oldest * oldest);
+
+	++window->next;
+	if (window->next >= window->size) {
+		window->next = 0;
+	}
+}
+
+/**
+ * @brief Gets the mean of the samples in the window
+ *
+ * @param window Window to read
+ *
+ * @retval Mean rounded to nearest, 0 if the window is empty
+ */
+int16_t StreamWindowMean(const struct stream_window *window);
+
+/**
+ * @brief Gets the population variance of the samples in the window, which
+ *        takes a 64-bit division so is best read only when needed
+ *
+ * @param window Window to read
+ *
+ * @retval Variance in squared sample units, 0 if the window is empty
+ */
+uint32_t StreamWindowVariance(const struct stream_window *window);
+
+/**
+ * @brief Clears the running variance
+ *
+ * @param variance Variance to clear
+ */
+void StreamVarianceReset(struct stream_variance *variance);
+
+/**
+ * @brief Adds a sample to the running mean and variance. The count stops at
+ *        UINT32_MAX, after which each sample is weighted as if it were that
+ *        sample
+ *
+ * @param variance Variance to add to
+ * @param value Sample to add
+ */
+void StreamVarianceAdd(struct stream_variance *variance, int16_t value);
+
+/**
+ * @brief Gets the mean of the samples added since the last reset
+ *
+ * @param variance Variance to read
+ *
+ * @retval Mean rounded to nearest
+ */
+int16_t StreamVarianceMean(const struct stream_variance *variance);
+
+/**
+ * @brief Gets the population variance of the samples added since the last
+ *        reset
+ *
+ * @param variance Variance to read
+ *
+ * @retval Variance in squared sample units, 0 if no samples were added
+ */
+uint32_t StreamVarianceGet(const struct stream_variance *variance);
+
+/**
+ * @brief Sets up an empty moving average
+ *
+ * @param ewma Average to set up
+ * @param shift Weight of each sample is 2^-shift, so the average follows
+ *              a step with a time constant of about 2^shift samples. Up to
+ *              STREAM_EWMA_SHIFT_MAX
+ */
+void StreamEwmaInit(struct stream_ewma *ewma, uint8_t shift);
+
+/**
+ * @brief Adds a sample to the average, the first sample after set up sets
+ *        the average rather than being weighted against 0
+ *
+ * @param ewma Average to add to
+ * @param value Sample to add
+ */
+static inline void StreamEwmaAdd(struct stream_ewma *ewma, int16_t value)
+{
+	int64_t target = (int64_t)value << STREAM_EWMA_Q_BITS;
+
+	if (!ewma->primed) {
+		ewma->value = (int32_t)target;
+		ewma->primed = true;
+	} else {
+		ewma->value += (int32_t)((target - ewma->value) >> ewma->shift);
+	}
+}
+
+/**
+ * @brief Gets the moving average
+ *
+ * @param ewma Average to read
+ *
+ * @retval Average rounded to nearest, 0 if no samples were added
+ */
+static inline int16_t StreamEwmaGet(const struct stream_ewma *ewma)
+{
+	return (int16_t)(((int64_t)ewma->value +
+			  BIT(STREAM_EWMA_Q_BITS - 1)) >>
+			 STREAM_EWMA_Q_BITS);
+}
+
+/**
+ * @brief Sets up an empty sliding minimum and maximum
+ *
+ * @param minmax Window to set up
+ * @param buffer Storage for 2 * size entries
+ * @param size Number of samples in the window, at least 1
+ */
+void StreamMinMaxInit(struct stream_minmax *minmax,
+		      struct stream_minmax_entry *buffer, uint16_t size);
+
+/**
+ * @brief Removes all samples from the window
+ *
+ * @param minmax Window to clear
+ */
+void StreamMinMaxReset(struct stream_minmax *minmax);
+
+/**
+ * @brief Adds a sample, dropping the oldest once the window is full
+ *
+ * @param minmax Window to add to
+ * @param value Sample to add
+ */
+void StreamMinMaxAdd(struct stream_minmax *minmax, int16_t value);
+
+/**
+ * @brief Gets the smallest sample in the window
+ *
+ * @param minmax Window to read
+ *
+ * @retval Minimum, 0 if the window is empty
+ */
+static inline int16_t StreamMinMaxMin(const struct stream_minmax *minmax)
+{
+	if (minmax->min.count == 0) {
+		return 0;
+	}
+
+	return minmax->min.entries[minmax->min.head].value;
+}
+
+/**
+ * @brief Gets the largest sample in the window
+ *
+ * @param minmax Window to read
+ *
+ * @retval Maximum, 0 if the window is empty
+ */
+static inline int16_t StreamMinMaxMax(const struct stream_minmax *minmax)
+{
+	if (minmax->max.count == 0) {
+		return 0;
+	}
+
+	return minmax->max.entries[minmax->max.head].value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STREAM_STATS_H__ */
@@ -0,0 +1,224 @@
+/**
+ * @file stream_stats.c
+ * @brief Fixed point streaming statistics for accelerometer samples
+ *
+ * Every statistic is updated in constant time per sample, with no loop over
+ * the window. The sliding window keeps an exact integer sum and sum of
+ * squares, the running variance uses Welford's method in Q8 so that it
+ * does not need the squares of the samples since the last reset, the moving
+ * average is a shift and an add in Q16 and the sliding minimum and maximum
+ * are each kept in a queue of the samples which can still become the
+ * minimum or maximum, so the oldest entry is always the answer.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+#include "stream_stats.h"
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int32_t divide_rounded(int32_t value, uint32_t divisor);
+static void minmax_queue_add(struct stream_minmax_queue *queue, uint16_t size,
+			     uint32_t sequence, int16_t value, bool minimum);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void StreamWindowInit(struct stream_window *window, int16_t *buffer,
+		      uint16_t size)
+{
+	window->samples = buffer;
+	window->size = size;
+	StreamWindowReset(window);
+}
+
+void StreamWindowReset(struct stream_window *window)
+{
+	window->next = 0;
+	window->count = 0;
+	window->sum = 0;
+	window->sum_squares = 0;
+}
+
+int16_t StreamWindowMean(const struct stream_window *window)
+{
+	if (window->count == 0) {
+		return 0;
+	}
+
+	return (int16_t)divide_rounded(window->sum, window->count);
+}
+
+uint32_t StreamWindowVariance(const struct stream_window *window)
+{
+	uint64_t count = window->count;
+	uint64_t square_of_sum;
+
+	if (count == 0) {
+		return 0;
+	}
+
+	/* n * sum(x^2) - sum(x)^2 is n^2 times the variance and cannot be
+	 * negative as both sums are exact
+	 */
+	square_of_sum = (uint64_t)((int64_t)window->sum * window->sum);
+
+	return (uint32_t)(((count * window->sum_squares) - square_of_sum) /
+			  (count * count));
+}
+
+void StreamVarianceReset(struct stream_variance *variance)
+{
+	variance->count = 0;
+	variance->mean = 0;
+	variance->m2 = 0;
+}
+
+void StreamVarianceAdd(struct stream_variance *variance, int16_t value)
+{
+	int32_t sample = (int32_t)value << STREAM_VARIANCE_Q_BITS;
+	int32_t delta;
+	uint64_t deviation;
+
+	if (variance->count < UINT32_MAX) {
+		++variance->count;
+	}
+
+	delta = sample - variance->mean;
+	variance->mean += divide_rounded(delta, variance->count);
+
+	/* Both deltas have the same sign, as the mean moves towards the
+	 * sample by at most the distance to it
+	 */
+	deviation = (uint64_t)(((int64_t)delta * (sample - variance->mean)) >>
+			       STREAM_VARIANCE_Q_BITS);
+
+	if (variance->m2 > UINT64_MAX - deviation) {
+		variance->m2 = UINT64_MAX;
+	} else {
+		variance->m2 += deviation;
+	}
+}
+
+int16_t StreamVarianceMean(const struct stream_variance *variance)
+{
+	return (int16_t)((variance->mean + BIT(STREAM_VARIANCE_Q_BITS - 1)) >>
+			 STREAM_VARIANCE_Q_BITS);
+}
+
+uint32_t StreamVarianceGet(const struct stream_variance *variance)
+{
+	if (variance->count == 0) {
+		return 0;
+	}
+
+	return (uint32_t)(((variance->m2 / variance->count) +
+			   BIT(STREAM_VARIANCE_Q_BITS - 1)) >>
+			  STREAM_VARIANCE_Q_BITS);
+}
+
+void StreamEwmaInit(struct stream_ewma *ewma, uint8_t shift)
+{
+	ewma->value = 0;
+	ewma->shift = MIN(shift, STREAM_EWMA_SHIFT_MAX);
+	ewma->primed = false;
+}
+
+void StreamMinMaxInit(struct stream_minmax *minmax,
+		      struct stream_minmax_entry *buffer, uint16_t size)
+{
+	minmax->min.entries = buffer;
+	minmax->max.entries = &buffer[size];
+	minmax->size = size;
+	StreamMinMaxReset(minmax);
+}
+
+void StreamMinMaxReset(struct stream_minmax *minmax)
+{
+	minmax->min.head = 0;
+	minmax->min.count = 0;
+	minmax->max.head = 0;
+	minmax->max.count = 0;
+	minmax->sequence = 0;
+}
+
+void StreamMinMaxAdd(struct stream_minmax *minmax, int16_t value)
+{
+	minmax_queue_add(&minmax->min, minmax->size, minmax->sequence, value,
+			 true);
+	minmax_queue_add(&minmax->max, minmax->size, minmax->sequence, value,
+			 false);
+	++minmax->sequence;
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Divides rounding to nearest, with an unsigned division so that
+ *  divisors above INT32_MAX do not need a 64-bit division.
+ */
+static int32_t divide_rounded(int32_t value, uint32_t divisor)
+{
+	uint32_t magnitude;
+
+	if (value < 0) {
+		magnitude = (uint32_t)(-(int64_t)value);
+		return -(int32_t)((magnitude + (divisor / 2)) / divisor);
+	}
+
+	magnitude = (uint32_t)value;
+	return (int32_t)((magnitude + (divisor / 2)) / divisor);
+}
+
+/** @brief Drops the oldest entry if it has left the window, then every
+ *  newer entry which the sample replaces as a future minimum (or maximum),
+ *  and adds the sample. Entries are added and dropped at most once each.
+ */
+static void minmax_queue_add(struct stream_minmax_queue *queue, uint16_t size,
+			     uint32_t sequence, int16_t value, bool minimum)
+{
+	struct stream_minmax_entry *newest;
+	uint32_t position;
+
+	/* At most one entry leaves the window per sample */
+	if (queue->count > 0 &&
+	    (sequence - queue->entries[queue->head].sequence) >= size) {
+		++queue->head;
+		if (queue->head >= size) {
+			queue->head = 0;
+		}
+		--queue->count;
+	}
+
+	while (queue->count > 0) {
+		position = (uint32_t)queue->head + queue->count - 1;
+		if (position >= size) {
+			position -= size;
+		}
+
+		newest = &queue->entries[position];
+		if (minimum ? (newest->value < value) :
+			      (newest->value > value)) {
+			break;
+		}
+
+		--queue->count;
+	}
+
+	position = (uint32_t)queue->head + queue->count;
+	if (position >= size) {
+		position -= size;
+	}
+
+	queue->entries[position].sequence = sequence;
+	queue->entries[position].value = value;
+	++queue->count;
+}
@@ -0,0 +1,374 @@
+/**
+ * @file main.c
+ * @brief Tests of the fixed point streaming statistics against brute force
+ *        calculations over the same samples
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <ztest.h>
+
+#include "stream_stats.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define TEST_SAMPLES 3000
+#define TEST_WINDOW_MAX 64
+
+/* Full scale of the accelerometer at 16 g in milli-g */
+#define TEST_RANGE_MG 16000
+
+/* Welford rounds its Q8 mean at every sample, allow the variance to differ
+ * from the exact value by this many parts per thousand
+ */
+#define TEST_VARIANCE_TOLERANCE_PPT 2
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const uint16_t test_window_sizes[] = { 1, 2, 7, 32, TEST_WINDOW_MAX };
+
+static int16_t history[TEST_SAMPLES];
+static int16_t window_buffer[TEST_WINDOW_MAX];
+static struct stream_minmax_entry minmax_buffer[2 * TEST_WINDOW_MAX];
+static uint32_t random_state;
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Repeatable pseudo random samples across the full range. */
+static int16_t random_sample(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+
+	return (int16_t)((random_state % ((2 * TEST_RANGE_MG) + 1)) -
+			 TEST_RANGE_MG);
+}
+
+static void fill_history(uint32_t seed)
+{
+	uint32_t i = 0;
+
+	random_state = seed;
+	while (i < TEST_SAMPLES) {
+		history[i] = random_sample();
+		++i;
+	}
+}
+
+/** @brief Rounds to nearest with halves away from zero, as the statistics
+ *  do.
+ */
+static int64_t divide_rounded(int64_t value, int64_t divisor)
+{
+	if (value < 0) {
+		return -((-value + (divisor / 2)) / divisor);
+	}
+
+	return (value + (divisor / 2)) / divisor;
+}
+
+/** @brief Checks the window statistics after each of the samples against the
+ *  same statistics calculated over the last size samples of the history.
+ */
+static void check_window(uint16_t size)
+{
+	struct stream_window window;
+	int64_t sum;
+	int64_t sum_squares;
+	int64_t count;
+	int64_t variance;
+	uint32_t i = 0;
+	uint32_t j;
+
+	StreamWindowInit(&window, window_buffer, size);
+
+	while (i < TEST_SAMPLES) {
+		StreamWindowAdd(&window, history[i]);
+
+		count = MIN(i + 1, size);
+		sum = 0;
+		sum_squares = 0;
+		for (j = (i + 1) - count; j <= i; ++j) {
+			sum += history[j];
+			sum_squares += (int64_t)history[j] * history[j];
+		}
+		variance = ((count * sum_squares) - (sum * sum)) /
+			   (count * count);
+
+		zassert_equal(StreamWindowMean(&window),
+			      divide_rounded(sum, count),
+			      "Mean of %u samples wrong at sample %u", size, i);
+		zassert_equal(StreamWindowVariance(&window), variance,
+			      "Variance of %u samples wrong at sample %u", size,
+			      i);
+		++i;
+	}
+}
+
+static void check_minmax(uint16_t size, uint32_t first_sequence)
+{
+	struct stream_minmax minmax;
+	int16_t minimum;
+	int16_t maximum;
+	uint32_t i = 0;
+	uint32_t j;
+
+	StreamMinMaxInit(&minmax, minmax_buffer, size);
+	minmax.sequence = first_sequence;
+
+	while (i < TEST_SAMPLES) {
+		StreamMinMaxAdd(&minmax, history[i]);
+
+		minimum = INT16_MAX;
+		maximum = INT16_MIN;
+		for (j = (i + 1) - MIN(i + 1, size); j <= i; ++j) {
+			minimum = MIN(minimum, history[j]);
+			maximum = MAX(maximum, history[j]);
+		}
+
+		zassert_equal(StreamMinMaxMin(&minmax), minimum,
+			      "Minimum of %u samples wrong at sample %u", size,
+			      i);
+		zassert_equal(StreamMinMaxMax(&minmax), maximum,
+			      "Maximum of %u samples wrong at sample %u", size,
+			      i);
+		++i;
+	}
+}
+
+/******************************************************************************/
+/* Tests                                                                      */
+/******************************************************************************/
+static void test_window_empty(void)
+{
+	struct stream_window window;
+
+	StreamWindowInit(&window, window_buffer, TEST_WINDOW_MAX);
+	zassert_equal(StreamWindowMean(&window), 0, "Empty mean not 0");
+	zassert_equal(StreamWindowVariance(&window), 0,
+		      "Empty variance not 0");
+
+	StreamWindowAdd(&window, 100);
+	StreamWindowReset(&window);
+	zassert_equal(StreamWindowMean(&window), 0, "Reset mean not 0");
+}
+
+static void test_window_brute_force(void)
+{
+	uint8_t i = 0;
+
+	fill_history(0x12345678);
+	while (i < ARRAY_SIZE(test_window_sizes)) {
+		check_window(test_window_sizes[i]);
+		++i;
+	}
+}
+
+static void test_window_full_scale(void)
+{
+	struct stream_window window;
+	uint32_t i = 0;
+
+	/* Alternating extremes give the largest sum of squares */
+	StreamWindowInit(&window, window_buffer, TEST_WINDOW_MAX);
+	while (i < (4 * TEST_WINDOW_MAX)) {
+		StreamWindowAdd(&window, (i & 1) ? INT16_MAX : -INT16_MAX);
+		++i;
+	}
+
+	zassert_equal(StreamWindowMean(&window), 0, "Full scale mean wrong");
+	zassert_equal(StreamWindowVariance(&window),
+		      (uint32_t)INT16_MAX * INT16_MAX,
+		      "Full scale variance wrong");
+}
+
+static void test_variance_welford(void)
+{
+	struct stream_variance variance;
+	int64_t sum = 0;
+	int64_t sum_squares = 0;
+	int64_t count;
+	int64_t exact;
+	int64_t error;
+	uint32_t i = 0;
+
+	StreamVarianceReset(&variance);
+	zassert_equal(StreamVarianceGet(&variance), 0,
+		      "Empty variance not 0");
+
+	fill_history(0x9abcdef0);
+	while (i < TEST_SAMPLES) {
+		StreamVarianceAdd(&variance, history[i]);
+		sum += history[i];
+		sum_squares += (int64_t)history[i] * history[i];
+		++i;
+
+		count = i;
+		exact = ((count * sum_squares) - (sum * sum)) / (count * count);
+		error = (int64_t)StreamVarianceGet(&variance) - exact;
+
+		zassert_within(StreamVarianceMean(&variance),
+			       divide_rounded(sum, count), 1,
+			       "Mean wrong after %u samples", i);
+		zassert_true(((error < 0) ? -error : error) <=
+				     MAX(1, (exact * TEST_VARIANCE_TOLERANCE_PPT) /
+						    1000),
+			     "Variance %u not %lld after %u samples",
+			     StreamVarianceGet(&variance), (long long)exact, i);
+	}
+}
+
+static void test_variance_constant(void)
+{
+	struct stream_variance variance;
+	uint32_t i = 0;
+
+	StreamVarianceReset(&variance);
+	while (i < 1000) {
+		StreamVarianceAdd(&variance, -1234);
+		++i;
+	}
+
+	zassert_equal(StreamVarianceMean(&variance), -1234, "Mean wrong");
+	zassert_equal(StreamVarianceGet(&variance), 0,
+		      "Constant input has variance");
+}
+
+static void test_ewma_priming(void)
+{
+	struct stream_ewma ewma;
+
+	StreamEwmaInit(&ewma, 4);
+	zassert_equal(StreamEwmaGet(&ewma), 0, "Empty average not 0");
+
+	/* The first sample sets the average rather than moving it from 0 */
+	StreamEwmaAdd(&ewma, -1500);
+	zassert_equal(StreamEwmaGet(&ewma), -1500, "First sample not taken");
+
+	StreamEwmaAdd(&ewma, -1500 + 16);
+	zassert_equal(StreamEwmaGet(&ewma), -1499, "Second sample not 1/16");
+
+	/* Setting up again forgets the average */
+	StreamEwmaInit(&ewma, 4);
+	StreamEwmaAdd(&ewma, 700);
+	zassert_equal(StreamEwmaGet(&ewma), 700, "Not primed again");
+}
+
+static void test_ewma_rounding(void)
+{
+	struct stream_ewma ewma;
+	uint32_t i = 0;
+
+	/* Half way rounds up */
+	StreamEwmaInit(&ewma, 1);
+	StreamEwmaAdd(&ewma, 0);
+	StreamEwmaAdd(&ewma, 1);
+	zassert_equal(StreamEwmaGet(&ewma), 1, "0.5 not rounded up");
+
+	/* 0.25 rounds down, 0.75 rounds up */
+	StreamEwmaInit(&ewma, 2);
+	StreamEwmaAdd(&ewma, 0);
+	StreamEwmaAdd(&ewma, 1);
+	zassert_equal(StreamEwmaGet(&ewma), 0, "0.25 not rounded down");
+	StreamEwmaInit(&ewma, 2);
+	StreamEwmaAdd(&ewma, 0);
+	StreamEwmaAdd(&ewma, 3);
+	zassert_equal(StreamEwmaGet(&ewma), 1, "0.75 not rounded up");
+
+	/* The Q16 fraction lets a step settle on the new value, from below
+	 * and from above
+	 */
+	StreamEwmaInit(&ewma, STREAM_EWMA_SHIFT_MAX);
+	StreamEwmaAdd(&ewma, 0);
+	while (i < 1000000) {
+		StreamEwmaAdd(&ewma, 1000);
+		++i;
+	}
+	zassert_equal(StreamEwmaGet(&ewma), 1000, "Rising step not settled");
+
+	i = 0;
+	while (i < 1000000) {
+		StreamEwmaAdd(&ewma, -1000);
+		++i;
+	}
+	zassert_equal(StreamEwmaGet(&ewma), -1000, "Falling step not settled");
+}
+
+static void test_ewma_shift_limit(void)
+{
+	struct stream_ewma ewma;
+
+	StreamEwmaInit(&ewma, STREAM_EWMA_SHIFT_MAX + 5);
+	zassert_equal(ewma.shift, STREAM_EWMA_SHIFT_MAX, "Shift not limited");
+}
+
+static void test_minmax_brute_force(void)
+{
+	uint8_t i = 0;
+
+	fill_history(0x0badf00d);
+	while (i < ARRAY_SIZE(test_window_sizes)) {
+		check_minmax(test_window_sizes[i], 0);
+		++i;
+	}
+}
+
+static void test_minmax_monotonic(void)
+{
+	uint32_t i = 0;
+
+	/* Falling then rising samples fill the maximum queue and then the
+	 * minimum queue, so both wrap round their storage
+	 */
+	while (i < TEST_SAMPLES) {
+		history[i] = (i < (TEST_SAMPLES / 2)) ?
+				     (int16_t)(TEST_RANGE_MG - (int32_t)i) :
+				     (int16_t)((int32_t)i - TEST_RANGE_MG);
+		++i;
+	}
+
+	i = 0;
+	while (i < ARRAY_SIZE(test_window_sizes)) {
+		check_minmax(test_window_sizes[i], 0);
+		++i;
+	}
+}
+
+static void test_minmax_sequence_wrap(void)
+{
+	uint8_t i = 0;
+
+	/* The sample sequence number passes UINT32_MAX part way through */
+	fill_history(0x5eed5eed);
+	while (i < ARRAY_SIZE(test_window_sizes)) {
+		check_minmax(test_window_sizes[i],
+			     UINT32_MAX - (TEST_SAMPLES / 2));
+		++i;
+	}
+}
+
+void test_main(void)
+{
+	ztest_test_suite(stream_stats,
+			 ztest_unit_test(test_window_empty),
+			 ztest_unit_test(test_window_brute_force),
+			 ztest_unit_test(test_window_full_scale),
+			 ztest_unit_test(test_variance_welford),
+			 ztest_unit_test(test_variance_constant),
+			 ztest_unit_test(test_ewma_priming),
+			 ztest_unit_test(test_ewma_rounding),
+			 ztest_unit_test(test_ewma_shift_limit),
+			 ztest_unit_test(test_minmax_brute_force),
+			 ztest_unit_test(test_minmax_monotonic),
+			 ztest_unit_test(test_minmax_sequence_wrap));
+	ztest_run_test_suite(stream_stats);
+}
@@ -26,6 +26,24 @@ extern "C" {
  */
 void ApplicationStart(void);
 
+/**
+ * @brief Changes the sample rate whilst running
+ *
+ * @param rate_hz Sample rate in Hz. With sensor FIFO acquisition this must
+ *                be one of the LIS2DH output data rates, otherwise it can
+ *                be up to SAMPLER_RATE_MAX_HZ
+ *
+ * @retval 0 on success, -EINVAL if the rate is not supported
+ */
+int ApplicationSetRate(uint32_t rate_hz);
+
+/**
+ * @brief Gets the current sample rate
+ *
+ * @retval Sample rate in Hz
+ */
+uint32_t ApplicationGetRate(void);
+
 #ifdef __cplusplus
 }
 #endif
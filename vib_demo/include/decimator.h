@@ -0,0 +1,100 @@
+/**
+ * @file decimator.h
+ * @brief Anti-aliasing FIR decimator for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __DECIMATOR_H__
+#define __DECIMATOR_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define DECIMATOR_RATIO_MAX CONFIG_APP_DECIMATION_RATIO_MAX
+#define DECIMATOR_TAPS_PER_PHASE CONFIG_APP_DECIMATION_TAPS_PER_PHASE
+#define DECIMATOR_TAPS_MAX (DECIMATOR_RATIO_MAX * DECIMATOR_TAPS_PER_PHASE)
+#define DECIMATOR_AXIS_COUNT 3
+
+struct decimator {
+	/* Linear phase low pass filter in Q15, ratio * taps per phase long */
+	int16_t coefficients[DECIMATOR_TAPS_MAX];
+	/* Each sample is stored twice, taps apart, so that the newest taps
+	 * samples are always contiguous starting at position
+	 */
+	int16_t history[DECIMATOR_AXIS_COUNT][DECIMATOR_TAPS_MAX * 2];
+	uint16_t taps;
+	uint16_t position;
+	uint8_t ratio;
+	/* Input samples until the next output sample */
+	uint8_t countdown;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Designs the filter for a decimation ratio and clears the history.
+ *        The filter is a Blackman windowed sinc with its stop band starting
+ *        at half the output rate, at least 64 dB down with the default taps
+ *        per phase, and a gain of exactly 1 at DC
+ *
+ * @param decimator Decimator to set up
+ * @param ratio Input samples per output sample, 1 passes samples through
+ *
+ * @retval 0 on success, -EINVAL if the ratio is 0 or above
+ *         DECIMATOR_RATIO_MAX
+ */
+int DecimatorInit(struct decimator *decimator, uint8_t ratio);
+
+/**
+ * @brief Clears the history, so the next output only depends on samples
+ *        added after this call
+ *
+ * @param decimator Decimator to reset
+ */
+void DecimatorReset(struct decimator *decimator);
+
+/**
+ * @brief Adds a sample and, once every ratio samples, calculates an output
+ *        sample. Only the output samples are filtered, so the filter costs
+ *        taps per phase multiplies per axis per input sample
+ *
+ * @param decimator Decimator to add to
+ * @param mg X, Y and Z readings in milli-g
+ * @param axes Indexes (0 = X, 1 = Y, 2 = Z) of the axes to filter, only
+ *             these entries of mg and out are used
+ * @param axis_count Number of entries in axes
+ * @param out Set to the filtered X, Y and Z readings when an output sample
+ *            is due
+ *
+ * @retval True if out has been set
+ */
+bool DecimatorAdd(struct decimator *decimator, const int16_t *mg,
+		  const uint8_t *axes, uint8_t axis_count, int16_t *out);
+
+/**
+ * @brief Gets the delay through the filter, outputs correspond to the input
+ *        this many input samples before the newest one
+ *
+ * @param decimator Decimator to query
+ *
+ * @retval Group delay in input samples multiplied by 2
+ */
+uint32_t DecimatorGetDelayX2(const struct decimator *decimator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DECIMATOR_H__ */
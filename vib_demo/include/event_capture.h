@@ -0,0 +1,122 @@
+/**
+ * @file event_capture.h
+ * @brief Triggered pre/post event capture for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __EVENT_CAPTURE_H__
+#define __EVENT_CAPTURE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define EVENT_CAPTURE_AXIS_COUNT 3
+
+enum event_trigger {
+	/* Deviation of the acceleration vector from its resting value */
+	EVENT_TRIGGER_MAGNITUDE = 0,
+	/* Change of the acceleration vector between consecutive samples */
+	EVENT_TRIGGER_JERK,
+	/* Rise of the short term RMS deviation above the long term RMS */
+	EVENT_TRIGGER_RMS_STEP,
+	EVENT_TRIGGER_COUNT,
+};
+
+struct event_capture_stats {
+	/* Events captured and queued for output */
+	uint32_t events;
+	/* Events output */
+	uint32_t emitted;
+	/* Triggers missed because every window buffer was waiting to be
+	 * output
+	 */
+	uint32_t missed;
+	/* Time from the trigger sample to the end of the latest event's
+	 * output in us
+	 */
+	uint32_t latency_us;
+	/* Largest trigger to output end time in us */
+	uint32_t max_latency_us;
+	/* Time the latest event waited after its last sample for output to
+	 * start in us
+	 */
+	uint32_t queue_us;
+	/* Largest time an event waited for output to start in us */
+	uint32_t max_queue_us;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the window buffers with the configured trigger thresholds
+ *        and starts the thread which outputs captured events
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int EventCaptureInit(void);
+
+/**
+ * @brief Adds a sample to the pre-trigger ring, or to the event being
+ *        captured, and checks it against the triggers. Called by acquisition
+ *        for every sample, only the sample is copied, events are output on
+ *        the event thread
+ *
+ * @param mg X, Y and Z readings in milli-g
+ * @param timestamp_us Time the reading was taken in microseconds since start
+ *                     up, modulo 2^32
+ */
+void EventCaptureAdd(const int16_t *mg, uint32_t timestamp_us);
+
+/**
+ * @brief Sets the threshold of a trigger, taking effect from the next sample
+ *
+ * @param trigger Trigger to set
+ * @param threshold_mg Threshold in milli-g, 0 disables the trigger
+ *
+ * @retval 0 on success, -EINVAL for an unknown trigger
+ */
+int EventCaptureSetThreshold(enum event_trigger trigger,
+			     uint16_t threshold_mg);
+
+/**
+ * @brief Gets the threshold of a trigger
+ *
+ * @param trigger Trigger to get
+ *
+ * @retval Threshold in milli-g, 0 if the trigger is disabled or unknown
+ */
+uint16_t EventCaptureGetThreshold(enum event_trigger trigger);
+
+/**
+ * @brief Gets the name used for a trigger in the output and shell
+ *
+ * @param trigger Trigger to name
+ *
+ * @retval Name, or NULL for an unknown trigger
+ */
+const char *EventCaptureTriggerName(enum event_trigger trigger);
+
+/**
+ * @brief Gets the event counts and latencies
+ *
+ * @param stats Set to the current statistics
+ */
+void EventCaptureGetStats(struct event_capture_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __EVENT_CAPTURE_H__ */
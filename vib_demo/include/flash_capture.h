@@ -0,0 +1,150 @@
+/**
+ * @file flash_capture.h
+ * @brief High rate burst capture to QSPI flash for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __FLASH_CAPTURE_H__
+#define __FLASH_CAPTURE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Recordings are a sequence of flash page sized records, written from the
+ * start of the capture region (all fields little endian):
+ *
+ *   offset  size  field
+ *   0       2     sync word (0xC55C, sent as 0x5C 0xC5)
+ *   2       2     record number within the recording, from 0
+ *   4       2     sample rate in Hz
+ *   6       1     axis mask (bit 0 = X, bit 1 = Y, bit 2 = Z), always 0x07
+ *   7       1     number of samples (N) in the record, the final record of
+ *                 a recording may be partly filled
+ *   8       6*N   int16 milli-g values, interleaved per sample in X/Y/Z order
+ *   254     2     crc16_ccitt() (seed 0xFFFF) of bytes 2 to 253
+ *
+ * The end of a recording is the first record which is erased or out of
+ * sequence. Sectors are erased ahead of the writes, and if a recording
+ * ends exactly on a sector boundary the following sector is erased when it
+ * stops, so records left by an earlier, longer recording are never dumped.
+ * Records are dumped over the UART exactly as stored.
+ */
+#define FLASH_CAPTURE_SYNC_WORD 0xC55C
+#define FLASH_CAPTURE_RECORD_SIZE 256
+#define FLASH_CAPTURE_HEADER_SIZE 8
+#define FLASH_CAPTURE_CRC_SIZE 2
+#define FLASH_CAPTURE_CRC_SEED 0xFFFF
+#define FLASH_CAPTURE_AXIS_COUNT 3
+#define FLASH_CAPTURE_RECORD_SAMPLES                                           \
+	((FLASH_CAPTURE_RECORD_SIZE - FLASH_CAPTURE_HEADER_SIZE -              \
+	  FLASH_CAPTURE_CRC_SIZE) /                                            \
+	 (FLASH_CAPTURE_AXIS_COUNT * sizeof(int16_t)))
+
+enum flash_capture_state {
+	/* Not recording, samples are ignored */
+	FLASH_CAPTURE_IDLE = 0,
+	/* Waiting for a sample beyond the trigger threshold */
+	FLASH_CAPTURE_ARMED,
+	/* Recording samples */
+	FLASH_CAPTURE_RECORDING,
+	/* Sending the recording out of the UART */
+	FLASH_CAPTURE_DUMPING,
+};
+
+struct flash_capture_stats {
+	enum flash_capture_state state;
+	/* Samples recorded by the current or last capture */
+	uint32_t samples;
+	/* Bytes of records written to flash by the current or last capture */
+	uint32_t bytes_written;
+	/* Samples dropped because both record buffers were waiting to be
+	 * written
+	 */
+	uint32_t dropped;
+	/* Times a record write waited for its sector to be erased because
+	 * erasing had not kept ahead of the writes
+	 */
+	uint32_t erase_stalls;
+	/* Time from the first sample to the last record write in ms */
+	uint32_t elapsed_ms;
+	/* Time spent in flash write calls in us */
+	uint32_t write_us;
+	/* Time spent erasing sectors in us */
+	uint32_t erase_us;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the capture region and starts the flash writer thread. If
+ *        a trigger threshold is configured, capture is armed immediately
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int FlashCaptureInit(void);
+
+/**
+ * @brief Passes a sample to the capture, called by acquisition for every
+ *        sample at the full sensor rate. Only copies the sample into a
+ *        record buffer, flash access happens on the writer thread
+ *
+ * @param mg X, Y and Z readings in milli-g
+ */
+void FlashCaptureAdd(const int16_t *mg);
+
+/**
+ * @brief Starts recording immediately, overwriting any previous recording
+ *
+ * @retval 0 on success, -EBUSY if a capture or dump is in progress
+ */
+int FlashCaptureStart(void);
+
+/**
+ * @brief Waits for a sample beyond the trigger threshold then records,
+ *        overwriting any previous recording
+ *
+ * @param threshold_mg Deviation from the resting value of any axis which
+ *                     starts the recording
+ *
+ * @retval 0 on success, -EBUSY if a capture or dump is in progress
+ */
+int FlashCaptureArm(uint16_t threshold_mg);
+
+/**
+ * @brief Stops recording (or disarms the trigger), writing out any partly
+ *        filled record
+ */
+void FlashCaptureStop(void);
+
+/**
+ * @brief Sends the recording out of the UART as stored. Sample output is
+ *        suspended until the dump completes
+ *
+ * @retval 0 on success, -EBUSY if a capture or dump is in progress
+ */
+int FlashCaptureDump(void);
+
+/**
+ * @brief Gets the capture statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void FlashCaptureGetStats(struct flash_capture_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FLASH_CAPTURE_H__ */
@@ -0,0 +1,152 @@
+/**
+ * @file frame.h
+ * @brief Binary framed sample output encoder for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __FRAME_H__
+#define __FRAME_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Frame layout (all fields little endian):
+ *
+ *   offset  size  field
+ *   0       2     sync word (0xA55A, sent as 0x5A 0xA5)
+ *   2       2     sequence number, increments per frame
+ *   4       2     sample rate in Hz
+ *   6       1     axis mask (bit 0 = X, bit 1 = Y, bit 2 = Z), bit 7 is set
+ *                 for compressed frames and bit 6 for timestamped frames
+ *   7       1     number of samples (N) in the frame
+ *   8       2*A*N int16 milli-g values, interleaved per sample in X/Y/Z
+ *                 order for the A axes that are set in the axis mask
+ *   8+2*A*N 2     crc16_ccitt() (seed 0xFFFF) of bytes 2 to 8+2*A*N-1
+ *
+ * Compressed frames replace the values with:
+ *
+ *   8       2     length (L) of the compressed values in bytes
+ *   10      L     A*N values, interleaved as above. Each is zigzag encoded
+ *                 (0, -1, 1, -2... become 0, 1, 2, 3...) then sent as a
+ *                 varint (7 bits per byte, least significant first, bit 7
+ *                 set on all but the last byte). The first sample of the
+ *                 frame is the milli-g reading, later samples are the
+ *                 difference from the previous sample of the same axis
+ *   10+L    2     crc16_ccitt() (seed 0xFFFF) of bytes 2 to 10+L-1
+ *
+ * Every compressed frame starts with a keyframe, so a lost or corrupt frame
+ * does not affect the decoding of the next one.
+ *
+ * Timestamped frames put the sample time, in microseconds since start up
+ * modulo 2^32, before the axis values of each sample. It is a uint32 in
+ * frames which are not compressed, and is delta coded as an extra axis in
+ * compressed frames (the keyframe value is the timestamp as an int32).
+ */
+#define FRAME_SYNC_WORD 0xA55A
+#define FRAME_HEADER_SIZE 8
+#define FRAME_LENGTH_SIZE 2
+#define FRAME_CRC_SIZE 2
+#define FRAME_CRC_SEED 0xFFFF
+#define FRAME_AXIS_MAX 3
+#define FRAME_AXIS_X BIT(0)
+#define FRAME_AXIS_Y BIT(1)
+#define FRAME_AXIS_Z BIT(2)
+#define FRAME_FLAG_TIMESTAMPS BIT(6)
+#define FRAME_FLAG_COMPRESSED BIT(7)
+
+/* A zigzag encoded 17-bit difference needs at most 3 varint bytes, and a
+ * 32-bit one 5 bytes. Frames can be switched to compressed at runtime, so
+ * the buffer is always sized for compressed frames
+ */
+#define FRAME_VALUE_SIZE_MAX 3
+#define FRAME_TIMESTAMP_SIZE_MAX 5
+
+#define FRAME_SAMPLE_SIZE_MAX                                                  \
+	((FRAME_VALUE_SIZE_MAX * FRAME_AXIS_MAX) + FRAME_TIMESTAMP_SIZE_MAX)
+
+#define FRAME_SIZE_MAX                                                         \
+	(FRAME_HEADER_SIZE + FRAME_LENGTH_SIZE +                               \
+	 (FRAME_SAMPLE_SIZE_MAX * CONFIG_APP_BINARY_FRAME_SAMPLES) +           \
+	 FRAME_CRC_SIZE)
+
+struct frame_encoder {
+	uint8_t buffer[FRAME_SIZE_MAX];
+	size_t length;
+	uint16_t sequence;
+	uint16_t rate_hz;
+	uint8_t axis_mask;
+	uint8_t samples;
+	/* Previous sample, for compressed frames */
+	int16_t previous[FRAME_AXIS_MAX];
+	uint32_t previous_timestamp;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Initialises a frame encoder, resetting the sequence number
+ *
+ * @param encoder Encoder to initialise
+ * @param rate_hz Sample rate placed in each frame header
+ * @param axis_mask Axes (FRAME_AXIS_*) included in each sample, plus
+ *                  FRAME_FLAG_COMPRESSED to delta encode the samples and
+ *                  FRAME_FLAG_TIMESTAMPS to include sample timestamps
+ */
+void FrameEncoderInit(struct frame_encoder *encoder, uint16_t rate_hz,
+		      uint8_t axis_mask);
+
+/**
+ * @brief Changes the sample rate and axis mask of the following frames,
+ *        keeping the sequence numbering. Any partly built frame is discarded
+ *        so it must be read out with FrameEncoderFinish first
+ *
+ * @param encoder Encoder to change
+ * @param rate_hz Sample rate placed in each frame header
+ * @param axis_mask Axes and flags as for FrameEncoderInit
+ */
+void FrameEncoderConfigure(struct frame_encoder *encoder, uint16_t rate_hz,
+			   uint8_t axis_mask);
+
+/**
+ * @brief Adds a sample to the frame being built
+ *
+ * @param encoder Encoder to add the sample to
+ * @param mg X, Y and Z readings in milli-g, axes not in the mask are ignored
+ * @param timestamp_us Time the sample was taken, ignored unless the frames
+ *                     are timestamped
+ *
+ * @retval True if the frame is now complete and must be read out with
+ *         FrameEncoderFinish before further samples are added
+ */
+bool FrameEncoderAdd(struct frame_encoder *encoder, const int16_t *mg,
+		     uint32_t timestamp_us);
+
+/**
+ * @brief Completes the frame being built (even if it is not full) by
+ *        filling in the sample count and CRC
+ *
+ * @param encoder Encoder holding the frame
+ * @param length Set to the length of the frame in bytes, 0 if it was empty
+ *
+ * @retval Pointer to the frame data, valid until the next FrameEncoderAdd
+ */
+const uint8_t *FrameEncoderFinish(struct frame_encoder *encoder,
+				  size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FRAME_H__ */
@@ -0,0 +1,113 @@
+/**
+ * @file goertzel.h
+ * @brief Goertzel filter bank for monitoring fixed vibration frequencies
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __GOERTZEL_H__
+#define __GOERTZEL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define GOERTZEL_BINS_MAX CONFIG_APP_GOERTZEL_BINS_MAX
+#define GOERTZEL_AXIS_COUNT 3
+
+struct goertzel_bin {
+	/* Frequency the bin is tuned to in 0.1 Hz units */
+	uint32_t frequency_dhz;
+	/* Magnitude above which an alarm is raised in milli-g, 0 for none */
+	uint16_t threshold_mg;
+	/* False if the frequency is too close to DC or half the current
+	 * sample rate to be measured, the bin then always reads 0
+	 */
+	bool active;
+	/* Number of block magnitudes which exceeded the threshold, counted
+	 * separately for each axis
+	 */
+	uint32_t alarms;
+	/* Magnitude of each axis over the latest block in milli-g */
+	uint16_t magnitude_mg[GOERTZEL_AXIS_COUNT];
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the bins from CONFIG_APP_GOERTZEL_FREQUENCIES and
+ *        CONFIG_APP_GOERTZEL_THRESHOLDS_MG and starts a new block
+ *
+ * @param rate_hz Sample rate in Hz
+ *
+ * @retval Number of active bins, bins which cannot be measured at this
+ *         sample rate are deactivated. -EINVAL if the configured lists
+ *         cannot be parsed
+ */
+int GoertzelInit(uint32_t rate_hz);
+
+/**
+ * @brief Retunes the bins for a new sample rate and starts a new block.
+ *        Bins which cannot be measured at the new rate are deactivated
+ *
+ * @param rate_hz Sample rate in Hz
+ *
+ * @retval Number of active bins
+ */
+uint8_t GoertzelSetRate(uint32_t rate_hz);
+
+/**
+ * @brief Discards the samples of the current block and starts a new one
+ */
+void GoertzelReset(void);
+
+/**
+ * @brief Runs one sample through every bin of the given axes, the cost is
+ *        proportional to the number of bins times the number of axes
+ *
+ * @param mg X, Y and Z readings in milli-g
+ * @param axes Indexes (0 = X, 1 = Y, 2 = Z) of the axes to process
+ * @param axis_count Number of entries in axes
+ *
+ * @retval True if a block is complete and GoertzelCompute can be called
+ *         for it, the next block starts when the next sample is added
+ */
+bool GoertzelAdd(const int16_t *mg, const uint8_t *axes, uint8_t axis_count);
+
+/**
+ * @brief Calculates the bin magnitudes of one axis over the completed
+ *        block and checks them against the alarm thresholds
+ *
+ * @param axis Axis index (0 = X, 1 = Y, 2 = Z)
+ * @param magnitudes Set to the amplitude of each bin in milli-g, must hold
+ *                   GoertzelGetBins() entries
+ *
+ * @retval Bit mask of the bins whose threshold was exceeded
+ */
+uint32_t GoertzelCompute(uint8_t axis, uint16_t *magnitudes);
+
+/**
+ * @brief Gets the bin settings, alarm counts and latest magnitudes
+ *
+ * @param bins Set to the bins, may be NULL to only get the count. Must
+ *             hold GOERTZEL_BINS_MAX entries
+ *
+ * @retval Number of configured bins
+ */
+uint8_t GoertzelGetBins(struct goertzel_bin *bins);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GOERTZEL_H__ */
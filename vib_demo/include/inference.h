@@ -0,0 +1,108 @@
+/**
+ * @file inference.h
+ * @brief Double buffered sample windows for on-device inference
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __INFERENCE_H__
+#define __INFERENCE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define INFERENCE_AXIS_COUNT 3
+
+struct inference_result {
+	/* Name of the class the window was assigned to */
+	const char *label;
+	/* Confidence in the class, 0 to 100 */
+	uint8_t confidence;
+};
+
+/**
+ * @brief Classifies a window of samples, called on the inference thread.
+ *        The window is not overwritten until the classifier returns
+ *
+ * @param samples X, Y and Z readings in milli-g, oldest first
+ * @param count Number of samples in the window
+ * @param result Set to the classification
+ *
+ * @retval 0 on success, negative error code if the window could not be
+ *         classified
+ */
+typedef int (*inference_classifier_t)(
+	const int16_t (*samples)[INFERENCE_AXIS_COUNT], uint32_t count,
+	struct inference_result *result);
+
+struct inference_stats {
+	/* Windows filled */
+	uint32_t windows;
+	/* Windows classified */
+	uint32_t classified;
+	/* Windows of samples discarded because every window buffer was
+	 * still waiting to be classified
+	 */
+	uint32_t dropped;
+	/* Time from the first to the last sample of the latest window in us */
+	uint32_t fill_us;
+	/* Time the latest window waited for the inference thread in us */
+	uint32_t queue_us;
+	/* Largest time a window waited for the inference thread in us */
+	uint32_t max_queue_us;
+	/* Time taken by the classifier for the latest window in us */
+	uint32_t inference_us;
+	/* Largest time taken by the classifier in us */
+	uint32_t max_inference_us;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the window buffers and starts the inference thread
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int InferenceInit(void);
+
+/**
+ * @brief Replaces the classifier, the default classifies each window as
+ *        idle or motion from its peak-to-peak range. Must be called before
+ *        InferenceInit
+ *
+ * @param classifier Function called with each complete window
+ */
+void InferenceSetClassifier(inference_classifier_t classifier);
+
+/**
+ * @brief Adds a sample to the window being filled, called by acquisition
+ *        for every sample. Only copies the sample, classification happens on
+ *        the inference thread
+ *
+ * @param mg X, Y and Z readings in milli-g
+ */
+void InferenceAdd(const int16_t *mg);
+
+/**
+ * @brief Gets the windowing and inference timing statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void InferenceGetStats(struct inference_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INFERENCE_H__ */
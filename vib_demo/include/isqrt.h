@@ -0,0 +1,58 @@
+/**
+ * @file isqrt.h
+ * @brief Integer square root for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __ISQRT_H__
+#define __ISQRT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+/**
+ * @brief Calculates an integer square root one result bit at a time, using
+ *        only shifts, adds and compares
+ *
+ * @param value Value to take the square root of
+ *
+ * @retval Square root rounded down
+ */
+static inline uint32_t Isqrt64(uint64_t value)
+{
+	uint64_t root = 0;
+	uint64_t bit = BIT64(62);
+
+	while (bit > value) {
+		bit >>= 2;
+	}
+
+	while (bit != 0) {
+		if (value >= root + bit) {
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t)root;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ISQRT_H__ */
@@ -0,0 +1,86 @@
+/**
+ * @file lis2dh_fifo.h
+ * @brief LIS2DH hardware FIFO burst acquisition for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LIS2DH_FIFO_H__
+#define __LIS2DH_FIFO_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Depth of the LIS2DH FIFO in samples */
+#define LIS2DH_FIFO_DEPTH 32
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Configures the sensor for watermark driven FIFO streaming
+ *
+ * @param odr_hz Output data rate, must be one supported by the LIS2DH
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int Lis2dhFifoInit(uint16_t odr_hz);
+
+/**
+ * @brief Changes the output data rate. The change is made by the thread
+ *        calling Lis2dhFifoRead, which is woken to make it and returns no
+ *        samples, and any samples in the FIFO at the old rate are discarded
+ *
+ * @param odr_hz Output data rate, must be one supported by the LIS2DH
+ *
+ * @retval 0 on success, -EINVAL for an unsupported rate
+ */
+int Lis2dhFifoSetRate(uint16_t odr_hz);
+
+/**
+ * @brief Waits for the FIFO watermark and drains the FIFO in one burst
+ *
+ * @param samples Buffer for up to LIS2DH_FIFO_DEPTH X/Y/Z readings in
+ *                calibrated milli-g
+ * @param timestamps_us Buffer for the time each reading was taken, in
+ *                      microseconds since start up modulo 2^32, derived
+ *                      from the watermark interrupt time
+ * @param timeout Maximum time to wait for the watermark interrupt
+ *
+ * @retval Number of samples read, negative error code on failure
+ */
+int Lis2dhFifoRead(int16_t samples[LIS2DH_FIFO_DEPTH][3],
+		   uint32_t timestamps_us[LIS2DH_FIFO_DEPTH],
+		   k_timeout_t timeout);
+
+/**
+ * @brief Gets the number of times the FIFO has overrun (samples lost)
+ *        since initialisation
+ *
+ * @retval Overrun count
+ */
+uint32_t Lis2dhFifoGetOverruns(void);
+
+/**
+ * @brief Gets the sensor sample period measured from the watermark
+ *        interrupt times
+ *
+ * @retval Sample period in nanoseconds
+ */
+uint32_t Lis2dhFifoGetPeriodNs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LIS2DH_FIFO_H__ */
@@ -0,0 +1,57 @@
+/**
+ * @file lis2dh_replay.h
+ * @brief LIS2DH I2C emulator replaying recorded traces on native_posix
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LIS2DH_REPLAY_H__
+#define __LIS2DH_REPLAY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+struct lis2dh_replay_stats {
+	/* Rate the trace is replayed at in Hz */
+	uint32_t rate_hz;
+	/* Number of samples in the trace, which repeats when it ends */
+	uint32_t trace_samples;
+	/* Samples read from the emulated sensor */
+	uint32_t served;
+	/* Trace samples which were replaced by a newer one before being read */
+	uint32_t skipped;
+	/* Reads which returned the same trace sample as the previous read */
+	uint32_t repeated;
+	/* Simulated time since the first read in microseconds */
+	uint64_t elapsed_us;
+	/* Number of samples the benchmark should run for, 0 to run forever */
+	uint32_t benchmark_samples;
+	/* UART baud rate the benchmark reports the achievable sample rate for */
+	uint32_t benchmark_baud;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Gets the replay statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void Lis2dhReplayGetStats(struct lis2dh_replay_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LIS2DH_REPLAY_H__ */
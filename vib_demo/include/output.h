@@ -0,0 +1,206 @@
+/**
+ * @file output.h
+ * @brief Sample output formatting for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <drivers/sensor.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Axis mask bits, matching the frame header axis mask */
+#define OUTPUT_AXIS_X BIT(0)
+#define OUTPUT_AXIS_Y BIT(1)
+#define OUTPUT_AXIS_Z BIT(2)
+#define OUTPUT_AXIS_ALL (OUTPUT_AXIS_X | OUTPUT_AXIS_Y | OUTPUT_AXIS_Z)
+
+/* Sample stream formats which can be switched between at runtime, the
+ * feature, Goertzel, classification and event outputs are only selectable
+ * at build time
+ */
+enum output_format {
+	OUTPUT_FORMAT_CSV = 0,
+	OUTPUT_FORMAT_BINARY,
+	OUTPUT_FORMAT_COMPRESSED,
+	OUTPUT_FORMAT_COUNT,
+};
+
+struct output_stats {
+	/* Capacity of the buffer between acquisition and output */
+	uint32_t size;
+	/* Samples currently buffered */
+	uint32_t used;
+	/* Most samples that have been buffered at once */
+	uint32_t high_water;
+	/* Samples dropped because the buffer was full */
+	uint32_t overruns;
+	/* Times the output thread emptied the buffer with a binary frame
+	 * partly built, so the frame waited on the sensor rather than the
+	 * UART
+	 */
+	uint32_t underruns;
+	/* Bytes of CSV lines and binary frames written, modulo 2^32 */
+	uint32_t bytes;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the output path selected in the project configuration and
+ *        starts the output thread. Samples passed to OutputSample and
+ *        OutputSampleMg are buffered and written out by the output thread
+ *        so that slow output does not delay acquisition
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int OutputInit(void);
+
+/**
+ * @brief Outputs a single X/Y/Z accelerometer reading, only the axes in the
+ *        current axis mask are sent
+ *
+ * @param accel X, Y and Z readings as returned by the sensor driver
+ * @param timestamp_us Time the reading was taken in microseconds since start
+ *                     up, modulo 2^32
+ */
+void OutputSample(const struct sensor_value *accel, uint32_t timestamp_us);
+
+/**
+ * @brief Outputs a single X/Y/Z accelerometer reading already converted to
+ *        milli-g, only the axes in the current axis mask are sent
+ *
+ * @param mg X, Y and Z readings in 0.001 g units
+ * @param timestamp_us Time the reading was taken in microseconds since start
+ *                     up, modulo 2^32
+ */
+void OutputSampleMg(const int16_t *mg, uint32_t timestamp_us);
+
+/**
+ * @brief Suspends or resumes sample output, whilst suspended the output
+ *        thread discards samples so that another user can write to the UART.
+ *        Suspending waits until the output thread has finished sending the
+ *        current frame, or for the inference and event formats until the
+ *        current result has been printed, which holds up the next until
+ *        output is resumed. Must not be called from the output thread
+ *
+ * @param suspend True to suspend, false to resume
+ *
+ * @retval 0 on success, -EAGAIN if the output did not stop in time
+ */
+int OutputSuspend(bool suspend);
+
+/**
+ * @brief Takes the print lock, waiting whilst output is suspended. Held
+ *        around each result by the threads which print in place of the
+ *        output thread (inference and events)
+ */
+void OutputLock(void);
+
+/**
+ * @brief Releases the print lock taken by OutputLock
+ */
+void OutputUnlock(void);
+
+/**
+ * @brief Selects the axes which are output, taking effect from the next
+ *        sample the output thread writes. Any partly built frame is sent
+ *        first, so each frame describes its samples correctly
+ *
+ * @param axis_mask OUTPUT_AXIS_* bits, at least one must be set
+ *
+ * @retval 0 on success, -EINVAL if the mask is empty or invalid
+ */
+int OutputSetAxisMask(uint8_t axis_mask);
+
+/**
+ * @brief Gets the axes which are output
+ *
+ * @retval OUTPUT_AXIS_* bits
+ */
+uint8_t OutputGetAxisMask(void);
+
+/**
+ * @brief Switches the sample stream format, taking effect from the next
+ *        sample the output thread writes
+ *
+ * @param format Format to output
+ *
+ * @retval 0 on success, -EINVAL for an unknown format, -ENOTSUP if the
+ *         application was built for feature, Goertzel, classification or
+ *         event output
+ */
+int OutputSetFormat(enum output_format format);
+
+/**
+ * @brief Gets the sample stream format
+ *
+ * @retval Current format
+ */
+enum output_format OutputGetFormat(void);
+
+/**
+ * @brief Sets the decimation ratio of the sample stream, the samples are
+ *        low pass filtered to remove vibration above half the output rate
+ *        and only one in ratio is output. Takes effect from the next sample
+ *        the output thread writes
+ *
+ * @param ratio Input samples per output sample, 1 outputs every sample
+ *
+ * @retval 0 on success, -EINVAL if the ratio is above
+ *         CONFIG_APP_DECIMATION_RATIO_MAX, -ENOTSUP if the application was
+ *         built without decimation
+ */
+int OutputSetDecimation(uint8_t ratio);
+
+/**
+ * @brief Gets the decimation ratio of the sample stream
+ *
+ * @retval Input samples per output sample
+ */
+uint8_t OutputGetDecimation(void);
+
+/**
+ * @brief Sets the sample rate reported in frame headers, called when the
+ *        acquisition rate changes
+ *
+ * @param rate_hz Sample rate in Hz
+ */
+void OutputSetRate(uint16_t rate_hz);
+
+/**
+ * @brief Gets the highest sample rate the UART can carry with the current
+ *        axis mask, format and decimation ratio. For compressed frames this
+ *        is the rate for uncompressed frames, compression usually allows a
+ *        higher rate
+ *
+ * @retval Sample rate in Hz, 0 if the output is not a sample stream
+ */
+uint32_t OutputGetMaxRate(void);
+
+/**
+ * @brief Gets the output buffering statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void OutputGetStats(struct output_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OUTPUT_H__ */
@@ -0,0 +1,79 @@
+/**
+ * @file sample_format.h
+ * @brief Integer only sample conversion and formatting for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SAMPLE_FORMAT_H__
+#define __SAMPLE_FORMAT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <drivers/sensor.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Longest output of FormatSensorValue, e.g. "-2147483648.000" */
+#define SAMPLE_FORMAT_VALUE_MAX_LENGTH 15
+
+#define SAMPLE_AXIS_X 0
+#define SAMPLE_AXIS_Y 1
+#define SAMPLE_AXIS_Z 2
+#define SAMPLE_AXIS_COUNT 3
+
+/* X, Y and Z readings as returned by the sensor driver, and the time they
+ * were taken in microseconds since start up (modulo 2^32)
+ */
+struct accel_sample {
+	struct sensor_value axis[SAMPLE_AXIS_COUNT];
+	uint32_t timestamp_us;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Converts a sensor driver reading in m/s^2 to milli-g, rounding to
+ *        the nearest value and saturating to the int16_t range
+ *
+ * @param val Reading to convert
+ *
+ * @retval Reading in 0.001 g units
+ */
+int16_t SensorValueToMg(const struct sensor_value *val);
+
+/**
+ * @brief Converts a milli-g reading to a sensor driver reading in m/s^2
+ *
+ * @param mg Reading in 0.001 g units
+ * @param val Set to the converted reading
+ */
+void MgToSensorValue(int16_t mg, struct sensor_value *val);
+
+/**
+ * @brief Formats a reading to 3 decimal places without using floating point
+ *        printf. The output is identical to printf("%.3f") of
+ *        sensor_value_to_double(), including "-0.000" for small negative
+ *        values. The string is not NULL terminated
+ *
+ * @param buffer Buffer of at least SAMPLE_FORMAT_VALUE_MAX_LENGTH bytes
+ * @param val Reading to format
+ *
+ * @retval Number of characters written
+ */
+size_t FormatSensorValue(char *buffer, const struct sensor_value *val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLE_FORMAT_H__ */
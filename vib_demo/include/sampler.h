@@ -0,0 +1,92 @@
+/**
+ * @file sampler.h
+ * @brief Periodic sensor sampler thread for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <drivers/sensor.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Each sample is a separate I2C transaction and the LIS2DH driver runs the
+ * sensor at 1344 Hz, so polling is limited to 1 kHz
+ */
+#define SAMPLER_RATE_MAX_HZ 1000
+
+/**
+ * @brief Called from the sampler thread with each new X/Y/Z reading and the
+ *        time it was fetched in microseconds since start up, modulo 2^32
+ */
+typedef void (*sampler_handler_t)(const struct sensor_value *accel,
+				  uint32_t timestamp_us);
+
+struct sampler_stats {
+	/* Number of samples taken since the statistics were reset */
+	uint32_t samples;
+	/* Number of samples taken more than one period after their deadline */
+	uint32_t late;
+	/* Largest wake up latency seen in microseconds */
+	uint32_t max_latency_us;
+	/* Wake up latency histogram, the final bin holds all latencies
+	 * beyond the range of the others
+	 */
+	uint32_t histogram[CONFIG_APP_SAMPLER_HISTOGRAM_BINS];
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Starts the sampler thread, which reads the sensor at a fixed rate
+ *        on an absolute schedule and sleeps between samples
+ *
+ * @param sensor Sensor device to read
+ * @param rate_hz Sample rate in Hz
+ * @param handler Function called with each reading
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int SamplerStart(const struct device *sensor, uint32_t rate_hz,
+		 sampler_handler_t handler);
+
+/**
+ * @brief Gets a copy of the sampler timing statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void SamplerGetStats(struct sampler_stats *stats);
+
+/**
+ * @brief Changes the sample rate, the schedule restarts from the next
+ *        sample at the new rate
+ *
+ * @param rate_hz Sample rate in Hz, up to SAMPLER_RATE_MAX_HZ
+ *
+ * @retval 0 on success, -EINVAL if the rate is out of range
+ */
+int SamplerSetRate(uint32_t rate_hz);
+
+/**
+ * @brief Clears the sampler timing statistics
+ */
+void SamplerResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SAMPLER_H__ */
@@ -0,0 +1,77 @@
+/**
+ * @file vib_features.h
+ * @brief Windowed vibration feature extraction for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __VIB_FEATURES_H__
+#define __VIB_FEATURES_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Features of one axis over one window. Statistics are calculated after the
+ * window mean (gravity and sensor offset) has been removed
+ */
+struct axis_features {
+	/* Root mean square in milli-g */
+	uint16_t rms_mg;
+	/* Largest absolute deviation from the mean in milli-g */
+	uint16_t peak_mg;
+	/* Difference between the largest and smallest reading in milli-g */
+	uint16_t peak_to_peak_mg;
+	/* Peak divided by RMS, multiplied by 100 */
+	uint16_t crest_x100;
+	/* Kurtosis (3.00 for Gaussian noise), multiplied by 100 */
+	uint16_t kurtosis_x100;
+	/* Hann windowed FFT magnitude spectrum from just above DC to the
+	 * Nyquist frequency, grouped into equal width bands. Each band holds
+	 * the largest bin, in milli-g amplitude
+	 */
+	uint16_t bands[CONFIG_APP_FEATURE_SPECTRUM_BANDS];
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Initialises feature extraction, discarding any buffered samples
+ *
+ * @retval 0 on success, negative error code otherwise
+ */
+int FeaturesInit(void);
+
+/**
+ * @brief Adds a sample to the current window
+ *
+ * @param mg X, Y and Z readings in milli-g
+ *
+ * @retval True if a window is complete and FeaturesCompute can be called
+ *         for it, the window then advances when the next sample is added
+ */
+bool FeaturesAdd(const int16_t *mg);
+
+/**
+ * @brief Calculates the features of one axis over the completed window
+ *
+ * @param axis Axis index (0 = X, 1 = Y, 2 = Z)
+ * @param features Set to the calculated features
+ */
+void FeaturesCompute(uint8_t axis, struct axis_features *features);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VIB_FEATURES_H__ */
@@ -0,0 +1,248 @@
+/**
+ * @file decimator.c
+ * @brief Anti-aliasing FIR decimator for vibration demo
+ *
+ * Reduces the sample rate by an integer ratio after low pass filtering, so
+ * vibration above half the output rate is removed rather than aliased into
+ * the output. Only every ratio'th output of the filter is calculated, which
+ * is the polyphase decomposition of the decimating filter with its branch
+ * sums merged into a single dot product over the newest samples. On the
+ * Cortex-M33 the dot product uses the SMLAD dual 16-bit multiply
+ * accumulate, two taps per instruction.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arm_math.h>
+
+#include "decimator.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+BUILD_ASSERT((DECIMATOR_TAPS_PER_PHASE % 2) == 0,
+	     "Decimator taps per phase must be even");
+
+#define Q15_BITS 15
+#define Q15_ONE 32768
+#define Q31_BITS 31
+
+/* A Blackman window has a transition band about 5.5 / taps of the input
+ * rate wide, which is 5.5 / taps per phase of the output rate. The cut off
+ * is placed half of that below half the output rate so that the stop band
+ * starts at half the output rate. With 24 taps per phase it is about
+ * -68 dB there at ratios 2 to 8. The Q15 coefficients limit it: the taps
+ * at the ends of the window round to 0 and the rounding error of the rest
+ * raises the stop band to about -64 dB at ratio 16.
+ */
+#define PERMILLE 1000
+#define CUTOFF_PERMILLE (500 - (2750 / DECIMATOR_TAPS_PER_PHASE))
+
+/* Blackman window 0.42 - 0.5 cos(x) + 0.08 cos(2x) */
+#define BLACKMAN_A0_Q31 ((int64_t)42 * BIT64(Q31_BITS) / 100)
+#define BLACKMAN_A2_NUMERATOR 2
+#define BLACKMAN_A2_DENOMINATOR 25
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int64_t design_tap(uint16_t tap, uint16_t taps, uint8_t ratio);
+static void design_filter(struct decimator *decimator);
+static int16_t filter(const int16_t *coefficients, const int16_t *samples,
+		      uint16_t taps);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Calculates one tap of the windowed sinc, unscaled. */
+static int64_t design_tap(uint16_t tap, uint16_t taps, uint8_t ratio)
+{
+	/* Twice the distance from the centre of the filter, which is between
+	 * two taps as there are an even number of them, so this is odd
+	 */
+	uint32_t distance = abs((2 * tap) - (taps - 1));
+	uint32_t period = 2 * PERMILLE * ratio;
+	q31_t phase;
+	int64_t sinc;
+	int64_t window;
+
+	/* sin(2 * pi * cutoff * distance / 2) / distance, where arm_sin_q31
+	 * takes the angle as a fraction of a whole turn. The constant scale
+	 * of the sinc is removed when the filter is normalised
+	 */
+	phase = (q31_t)(((uint64_t)((CUTOFF_PERMILLE * distance) % period)
+			 << Q31_BITS) /
+			period);
+	sinc = arm_sin_q31(phase);
+
+	phase = (q31_t)((((uint64_t)tap << Q31_BITS) / (taps - 1)) &
+			INT32_MAX);
+	window = BLACKMAN_A0_Q31 - (arm_cos_q31(phase) / 2) +
+		 (((int64_t)arm_cos_q31((q31_t)(((uint32_t)phase * 2) &
+						INT32_MAX)) *
+		   BLACKMAN_A2_NUMERATOR) /
+		  BLACKMAN_A2_DENOMINATOR);
+
+	return ((sinc * window) >> Q31_BITS) / (int64_t)distance;
+}
+
+/** @brief Designs the filter for the decimator's ratio, scaled to a DC gain
+ *  of exactly 1 in Q15.
+ */
+static void design_filter(struct decimator *decimator)
+{
+	int64_t sum = 0;
+	int64_t tap;
+	int32_t total = 0;
+	uint16_t i = 0;
+
+	while (i < decimator->taps) {
+		sum += design_tap(i, decimator->taps, decimator->ratio);
+		++i;
+	}
+
+	for (i = 0; i < decimator->taps; ++i) {
+		tap = design_tap(i, decimator->taps, decimator->ratio) *
+		      Q15_ONE;
+		tap += (tap >= 0) ? (sum / 2) : -(sum / 2);
+		decimator->coefficients[i] = (int16_t)(tap / sum);
+		total += decimator->coefficients[i];
+	}
+
+	/* Put the rounding error into the centre tap */
+	decimator->coefficients[decimator->taps / 2] += Q15_ONE - total;
+}
+
+/** @brief Dot product of the filter and the newest samples, rounded and
+ *  saturated to 16 bits.
+ */
+static int16_t filter(const int16_t *coefficients, const int16_t *samples,
+		      uint16_t taps)
+{
+	int32_t sum = 0;
+#if defined(__ARM_FEATURE_DSP)
+	uint32_t c0;
+	uint32_t c1;
+	uint32_t x0;
+	uint32_t x1;
+
+	/* Four taps per loop as two SMLADs, taps is a multiple of 4 as it is
+	 * an even number of taps per phase times a ratio of at least 2. The
+	 * samples are not always word aligned, which LDR allows
+	 */
+	while (taps > 0) {
+		memcpy(&c0, &coefficients[0], sizeof(c0));
+		memcpy(&x0, &samples[0], sizeof(x0));
+		memcpy(&c1, &coefficients[2], sizeof(c1));
+		memcpy(&x1, &samples[2], sizeof(x1));
+		sum = (int32_t)__SMLAD(c0, x0, (uint32_t)sum);
+		sum = (int32_t)__SMLAD(c1, x1, (uint32_t)sum);
+		coefficients += 4;
+		samples += 4;
+		taps -= 4;
+	}
+
+	return (int16_t)__SSAT((sum + BIT(Q15_BITS - 1)) >> Q15_BITS, 16);
+#else
+	while (taps > 0) {
+		sum += (int32_t)*coefficients * *samples;
+		++coefficients;
+		++samples;
+		--taps;
+	}
+
+	sum = (sum + BIT(Q15_BITS - 1)) >> Q15_BITS;
+
+	return (int16_t)MAX(MIN(sum, INT16_MAX), INT16_MIN);
+#endif
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int DecimatorInit(struct decimator *decimator, uint8_t ratio)
+{
+	if (ratio == 0 || ratio > DECIMATOR_RATIO_MAX) {
+		return -EINVAL;
+	}
+
+	decimator->ratio = ratio;
+	decimator->taps = 0;
+
+	if (ratio > 1) {
+		decimator->taps = ratio * DECIMATOR_TAPS_PER_PHASE;
+		design_filter(decimator);
+	}
+
+	DecimatorReset(decimator);
+
+	return 0;
+}
+
+void DecimatorReset(struct decimator *decimator)
+{
+	memset(decimator->history, 0, sizeof(decimator->history));
+	decimator->position = 0;
+	decimator->countdown = decimator->ratio;
+}
+
+bool DecimatorAdd(struct decimator *decimator, const int16_t *mg,
+		  const uint8_t *axes, uint8_t axis_count, int16_t *out)
+{
+	uint16_t position = decimator->position;
+	int16_t *history;
+	uint8_t i = 0;
+
+	if (decimator->ratio == 1) {
+		while (i < axis_count) {
+			out[axes[i]] = mg[axes[i]];
+			++i;
+		}
+
+		return true;
+	}
+
+	while (i < axis_count) {
+		history = decimator->history[axes[i]];
+		history[position] = mg[axes[i]];
+		history[position + decimator->taps] = mg[axes[i]];
+		++i;
+	}
+
+	++position;
+	if (position == decimator->taps) {
+		position = 0;
+	}
+	decimator->position = position;
+
+	--decimator->countdown;
+	if (decimator->countdown > 0) {
+		return false;
+	}
+	decimator->countdown = decimator->ratio;
+
+	/* The filter is symmetric, so the oldest sample can be multiplied by
+	 * the first coefficient
+	 */
+	for (i = 0; i < axis_count; ++i) {
+		out[axes[i]] = filter(decimator->coefficients,
+				      &decimator->history[axes[i]][position],
+				      decimator->taps);
+	}
+
+	return true;
+}
+
+uint32_t DecimatorGetDelayX2(const struct decimator *decimator)
+{
+	return (decimator->taps > 0) ? (decimator->taps - 1) : 0;
+}
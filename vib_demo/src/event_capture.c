@@ -0,0 +1,440 @@
+/**
+ * @file event_capture.c
+ * @brief Triggered pre/post event capture for vibration demo
+ *
+ * Acquisition writes every sample into a window buffer used as a ring, so
+ * the latest pre-trigger samples are always held. When a trigger fires the
+ * ring stops wrapping: the post-trigger samples fill the slots in front of
+ * the trigger sample until they reach the oldest pre-trigger sample, and the
+ * buffer is then handed to a lower priority thread which outputs the event.
+ * Acquisition carries on in the next buffer, seeded with the newest samples
+ * of the event so that an event immediately following another still has its
+ * pre-trigger history. All buffers are static, if every one of them is
+ * still waiting to be output, triggers are counted as missed until one is
+ * returned.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/atomic.h>
+
+#include "event_capture.h"
+#include "application.h"
+#include "output.h"
+#include "isqrt.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define EVENT_STACK_SIZE 2048
+#define EVENT_PRIORITY 9
+
+#define WINDOW_COUNT CONFIG_APP_EVENT_BUFFERS
+#define PRE_SAMPLES CONFIG_APP_EVENT_PRE_SAMPLES
+#define POST_SAMPLES CONFIG_APP_EVENT_POST_SAMPLES
+#define WINDOW_SAMPLES (PRE_SAMPLES + POST_SAMPLES)
+
+BUILD_ASSERT(WINDOW_COUNT <= (sizeof(atomic_t) * 8),
+	     "Too many event buffers");
+
+/* The resting value (mostly gravity) is a moving average over about 64
+ * samples, held with 4 fractional bits
+ */
+#define BASELINE_FRACTION_BITS 4
+#define BASELINE_SHIFT 6
+
+/* The RMS step trigger compares the RMS deviation from the resting value
+ * over about the last 8 samples against that over about the last 256
+ */
+#define RMS_SHORT_SHIFT 3
+#define RMS_LONG_SHIFT 8
+
+struct event_window {
+	int16_t samples[WINDOW_SAMPLES][EVENT_CAPTURE_AXIS_COUNT];
+	uint32_t number;
+	/* Ring index of the first pre-trigger sample */
+	uint16_t start;
+	/* Number of pre-trigger samples, fewer than configured if the event
+	 * came too soon after start up or a missed trigger
+	 */
+	uint16_t pre;
+	uint32_t timestamp_us;
+	uint32_t rate_hz;
+	uint32_t trigger_cycles;
+	uint32_t ready_cycles;
+	enum event_trigger trigger;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const char *const trigger_names[EVENT_TRIGGER_COUNT] = { "magnitude",
+								 "jerk",
+								 "rms" };
+
+static struct event_window windows[WINDOW_COUNT];
+
+/* A window is owned by the event thread whilst its bit is set */
+static atomic_t windows_ready;
+
+/* Thresholds in milli-g, set from the shell */
+static atomic_t thresholds[EVENT_TRIGGER_COUNT];
+
+/* Acquisition owned */
+static uint8_t fill_index;
+static uint16_t head;
+static uint16_t filled;
+static uint16_t post_remaining;
+static bool discarding;
+static uint32_t event_number;
+static bool baseline_valid;
+static int32_t baseline[EVENT_CAPTURE_AXIS_COUNT];
+static int16_t previous[EVENT_CAPTURE_AXIS_COUNT];
+static int64_t rms_short;
+static int64_t rms_long;
+
+static struct event_capture_stats event_stats;
+static struct k_spinlock event_stats_lock;
+
+K_MSGQ_DEFINE(event_msgq, sizeof(uint8_t), WINDOW_COUNT, 1);
+
+K_THREAD_STACK_DEFINE(event_stack_area, EVENT_STACK_SIZE);
+static struct k_thread event_thread_data;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void event_thread(void *unused1, void *unused2, void *unused3);
+static void event_write(const struct event_window *window);
+static enum event_trigger check_triggers(const int16_t *mg);
+static void event_complete(void);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void event_thread(void *unused1, void *unused2, void *unused3)
+{
+	struct event_window *window;
+	uint32_t start;
+	uint32_t queue_us;
+	uint32_t latency_us;
+	k_spinlock_key_t key;
+	uint8_t index;
+
+	while (1) {
+		k_msgq_get(&event_msgq, &index, K_FOREVER);
+		window = &windows[index];
+
+		/* Held back whilst a flash capture dump has the UART */
+		OutputLock();
+		start = k_cycle_get_32();
+		event_write(window);
+		queue_us = k_cyc_to_us_floor32(start - window->ready_cycles);
+		latency_us = k_cyc_to_us_floor32(k_cycle_get_32() -
+						 window->trigger_cycles);
+
+		printf("end,%u,%u\r\n", window->number, latency_us);
+		OutputUnlock();
+
+		key = k_spin_lock(&event_stats_lock);
+		++event_stats.emitted;
+		event_stats.queue_us = queue_us;
+		event_stats.max_queue_us =
+			MAX(event_stats.max_queue_us, queue_us);
+		event_stats.latency_us = latency_us;
+		event_stats.max_latency_us =
+			MAX(event_stats.max_latency_us, latency_us);
+		k_spin_unlock(&event_stats_lock, key);
+
+		/* Hand the buffer back to acquisition */
+		atomic_clear_bit(&windows_ready, index);
+	}
+}
+
+/** @brief Outputs the header and samples of an event, oldest first. */
+static void event_write(const struct event_window *window)
+{
+	const int16_t *sample;
+	const char *separator;
+	uint8_t axis_mask = OutputGetAxisMask();
+	uint16_t index = window->start;
+	uint32_t i = 0;
+	uint8_t axis;
+
+	printf("event,%u,%s,%u,%u,%u,%u\r\n", window->number,
+	       trigger_names[window->trigger], window->timestamp_us,
+	       window->rate_hz, window->pre, POST_SAMPLES);
+
+	while (i < (uint32_t)window->pre + POST_SAMPLES) {
+		sample = window->samples[index];
+		separator = "";
+
+		for (axis = 0; axis < EVENT_CAPTURE_AXIS_COUNT; ++axis) {
+			if (axis_mask & BIT(axis)) {
+				printf("%s%d", separator, sample[axis]);
+				separator = ",";
+			}
+		}
+		printf("\r\n");
+
+		++index;
+		if (index == WINDOW_SAMPLES) {
+			index = 0;
+		}
+		++i;
+	}
+}
+
+/** @brief Updates the resting value and RMS averages with a sample and checks
+ *  it against the enabled triggers.
+ *
+ *  @retval Trigger which fired, EVENT_TRIGGER_COUNT if none did
+ */
+static enum event_trigger check_triggers(const int16_t *mg)
+{
+	uint32_t threshold;
+	uint64_t deviation = 0;
+	uint64_t jerk = 0;
+	uint64_t rms_limit;
+	int32_t value;
+	int32_t difference;
+	uint8_t axis = 0;
+
+	while (axis < EVENT_CAPTURE_AXIS_COUNT) {
+		value = (int32_t)mg[axis] << BASELINE_FRACTION_BITS;
+
+		if (!baseline_valid) {
+			baseline[axis] = value;
+			previous[axis] = mg[axis];
+		}
+
+		difference = (value - baseline[axis]) >> BASELINE_FRACTION_BITS;
+		deviation += (uint64_t)((int64_t)difference * difference);
+		difference = (int32_t)mg[axis] - previous[axis];
+		jerk += (uint64_t)((int64_t)difference * difference);
+
+		baseline[axis] += (value - baseline[axis]) >> BASELINE_SHIFT;
+		previous[axis] = mg[axis];
+		++axis;
+	}
+
+	baseline_valid = true;
+
+	/* Mean squares of the deviation, compared as RMS values */
+	rms_short += ((int64_t)deviation - rms_short) >> RMS_SHORT_SHIFT;
+	rms_long += ((int64_t)deviation - rms_long) >> RMS_LONG_SHIFT;
+
+	/* Thresholds are compared squared to avoid square roots */
+	threshold = (uint32_t)atomic_get(&thresholds[EVENT_TRIGGER_MAGNITUDE]);
+	if (threshold > 0 && deviation > (uint64_t)threshold * threshold) {
+		return EVENT_TRIGGER_MAGNITUDE;
+	}
+
+	threshold = (uint32_t)atomic_get(&thresholds[EVENT_TRIGGER_JERK]);
+	if (threshold > 0 && jerk > (uint64_t)threshold * threshold) {
+		return EVENT_TRIGGER_JERK;
+	}
+
+	threshold = (uint32_t)atomic_get(&thresholds[EVENT_TRIGGER_RMS_STEP]);
+	if (threshold > 0) {
+		rms_limit = Isqrt64((uint64_t)rms_long) + threshold;
+		if ((uint64_t)rms_short > rms_limit * rms_limit) {
+			return EVENT_TRIGGER_RMS_STEP;
+		}
+	}
+
+	return EVENT_TRIGGER_COUNT;
+}
+
+/** @brief Passes the buffer being filled to the event thread and moves on to
+ *  the next one, copying the newest samples into it as its pre-trigger
+ *  history.
+ */
+static void event_complete(void)
+{
+	struct event_window *window = &windows[fill_index];
+	struct event_window *next;
+	k_spinlock_key_t key;
+	uint16_t count;
+	uint16_t index;
+	uint16_t i = 0;
+
+	window->number = event_number;
+	window->ready_cycles = k_cycle_get_32();
+	++event_number;
+
+	atomic_set_bit(&windows_ready, fill_index);
+	k_msgq_put(&event_msgq, &fill_index, K_NO_WAIT);
+
+	key = k_spin_lock(&event_stats_lock);
+	++event_stats.events;
+	k_spin_unlock(&event_stats_lock, key);
+
+	fill_index = (fill_index + 1) % WINDOW_COUNT;
+	head = 0;
+	filled = 0;
+
+	/* Triggers are missed until the next buffer is returned */
+	discarding = atomic_test_bit(&windows_ready, fill_index);
+	if (discarding) {
+		return;
+	}
+
+	/* The event ended with the sample before head in its ring */
+	next = &windows[fill_index];
+	count = MIN(PRE_SAMPLES, window->pre + POST_SAMPLES);
+	index = (window->start + window->pre + POST_SAMPLES - count) %
+		WINDOW_SAMPLES;
+
+	while (i < count) {
+		memcpy(next->samples[i], window->samples[index],
+		       sizeof(next->samples[i]));
+		++index;
+		if (index == WINDOW_SAMPLES) {
+			index = 0;
+		}
+		++i;
+	}
+
+	head = count % WINDOW_SAMPLES;
+	filled = count;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int EventCaptureInit(void)
+{
+	fill_index = 0;
+	head = 0;
+	filled = 0;
+	post_remaining = 0;
+	discarding = false;
+	event_number = 0;
+	baseline_valid = false;
+	rms_short = 0;
+	rms_long = 0;
+	atomic_clear(&windows_ready);
+
+	atomic_set(&thresholds[EVENT_TRIGGER_MAGNITUDE],
+		   CONFIG_APP_EVENT_MAGNITUDE_MG);
+	atomic_set(&thresholds[EVENT_TRIGGER_JERK], CONFIG_APP_EVENT_JERK_MG);
+	atomic_set(&thresholds[EVENT_TRIGGER_RMS_STEP],
+		   CONFIG_APP_EVENT_RMS_STEP_MG);
+
+	k_thread_create(&event_thread_data, event_stack_area,
+			K_THREAD_STACK_SIZEOF(event_stack_area), event_thread,
+			NULL, NULL, NULL, EVENT_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&event_thread_data, "events");
+
+	return 0;
+}
+
+void EventCaptureAdd(const int16_t *mg, uint32_t timestamp_us)
+{
+	struct event_window *window;
+	enum event_trigger trigger = check_triggers(mg);
+	k_spinlock_key_t key;
+
+	if (discarding) {
+		discarding = atomic_test_bit(&windows_ready, fill_index);
+
+		if (!discarding) {
+			post_remaining = 0;
+		} else if (post_remaining > 0) {
+			/* Part of an event which has already been missed */
+			--post_remaining;
+			return;
+		} else {
+			if (trigger != EVENT_TRIGGER_COUNT) {
+				key = k_spin_lock(&event_stats_lock);
+				++event_stats.missed;
+				k_spin_unlock(&event_stats_lock, key);
+				post_remaining = POST_SAMPLES - 1;
+			}
+			return;
+		}
+	}
+
+	window = &windows[fill_index];
+	memcpy(window->samples[head], mg, sizeof(window->samples[head]));
+
+	++head;
+	if (head == WINDOW_SAMPLES) {
+		head = 0;
+	}
+	if (filled < WINDOW_SAMPLES) {
+		++filled;
+	}
+
+	if (post_remaining == 0) {
+		if (trigger == EVENT_TRIGGER_COUNT) {
+			return;
+		}
+
+		/* The trigger sample is the first post-trigger sample, the
+		 * post-trigger samples then overwrite the oldest samples in
+		 * the ring, which are not part of the event
+		 */
+		window->pre = MIN(filled - 1, PRE_SAMPLES);
+		window->start = (head + WINDOW_SAMPLES - 1 - window->pre) %
+				WINDOW_SAMPLES;
+		window->trigger = trigger;
+		window->timestamp_us = timestamp_us;
+		window->rate_hz = ApplicationGetRate();
+		window->trigger_cycles = k_cycle_get_32();
+		post_remaining = POST_SAMPLES;
+	}
+
+	--post_remaining;
+	if (post_remaining == 0) {
+		event_complete();
+	}
+}
+
+int EventCaptureSetThreshold(enum event_trigger trigger,
+			     uint16_t threshold_mg)
+{
+	if (trigger >= EVENT_TRIGGER_COUNT) {
+		return -EINVAL;
+	}
+
+	atomic_set(&thresholds[trigger], threshold_mg);
+
+	return 0;
+}
+
+uint16_t EventCaptureGetThreshold(enum event_trigger trigger)
+{
+	if (trigger >= EVENT_TRIGGER_COUNT) {
+		return 0;
+	}
+
+	return (uint16_t)atomic_get(&thresholds[trigger]);
+}
+
+const char *EventCaptureTriggerName(enum event_trigger trigger)
+{
+	if (trigger >= EVENT_TRIGGER_COUNT) {
+		return NULL;
+	}
+
+	return trigger_names[trigger];
+}
+
+void EventCaptureGetStats(struct event_capture_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&event_stats_lock);
+
+	*stats = event_stats;
+	k_spin_unlock(&event_stats_lock, key);
+}
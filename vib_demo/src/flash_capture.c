@@ -0,0 +1,526 @@
+/**
+ * @file flash_capture.c
+ * @brief High rate burst capture to QSPI flash for vibration demo
+ *
+ * Acquisition copies each sample into one of two page sized record buffers.
+ * When a record is full it is handed to the writer thread, which programs it
+ * into the next page of the capture region whilst acquisition fills the other
+ * buffer. Programming a page is fast but erasing a sector is not, so the
+ * writer erases sectors ahead of the write position whenever it has no record
+ * waiting; a record only has to wait for an erase (an erase stall) if the
+ * writes catch up with the erased area.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <device.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <logging/log.h>
+#include <drivers/flash.h>
+#include <drivers/uart.h>
+#include <sys/atomic.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+
+#include "application.h"
+#include "flash_capture.h"
+#include "output.h"
+
+LOG_MODULE_REGISTER(flash_capture);
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define CAPTURE_STACK_SIZE 2048
+#define CAPTURE_PRIORITY 5
+
+/* Smallest erasable unit of the MX25R6435 */
+#define CAPTURE_SECTOR_SIZE 4096
+
+#define CAPTURE_REGION_START CONFIG_APP_CAPTURE_REGION_OFFSET
+#define CAPTURE_REGION_END                                                     \
+	(CONFIG_APP_CAPTURE_REGION_OFFSET + CONFIG_APP_CAPTURE_REGION_SIZE)
+#define CAPTURE_REGION_RECORDS                                                 \
+	(CONFIG_APP_CAPTURE_REGION_SIZE / FLASH_CAPTURE_RECORD_SIZE)
+#define CAPTURE_ERASE_AHEAD                                                    \
+	(CONFIG_APP_CAPTURE_ERASE_AHEAD_SECTORS * CAPTURE_SECTOR_SIZE)
+
+BUILD_ASSERT((CONFIG_APP_CAPTURE_REGION_OFFSET % CAPTURE_SECTOR_SIZE) == 0,
+	     "Capture region must start on a sector boundary");
+BUILD_ASSERT((CONFIG_APP_CAPTURE_REGION_SIZE % CAPTURE_SECTOR_SIZE) == 0,
+	     "Capture region must be a whole number of sectors");
+
+#define CAPTURE_BUFFERS 2
+
+#define RECORD_OFFSET_SYNC 0
+#define RECORD_OFFSET_NUMBER 2
+#define RECORD_OFFSET_RATE 4
+#define RECORD_OFFSET_AXIS_MASK 6
+#define RECORD_OFFSET_COUNT 7
+#define RECORD_OFFSET_CRC                                                      \
+	(FLASH_CAPTURE_RECORD_SIZE - FLASH_CAPTURE_CRC_SIZE)
+#define RECORD_AXIS_MASK 0x07
+
+/* The trigger compares each sample against a slowly moving average of the
+ * resting value (mostly gravity), held with 4 fractional bits
+ */
+#define BASELINE_FRACTION_BITS 4
+#define BASELINE_SHIFT 4
+
+#define QSPI_NODE DT_INST(0, nordic_qspi_nor)
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct device *flash_dev;
+static const struct device *uart_dev;
+
+/* Record buffers, a buffer is owned by the writer whilst its bit is set in
+ * pending and by acquisition otherwise
+ */
+static uint8_t records[CAPTURE_BUFFERS][FLASH_CAPTURE_RECORD_SIZE];
+static atomic_t pending;
+static uint8_t dump_record[FLASH_CAPTURE_RECORD_SIZE];
+
+/* Acquisition owned, protected by capture_lock */
+static struct k_spinlock capture_lock;
+static enum flash_capture_state capture_state;
+static uint8_t fill_index;
+static uint8_t fill_count;
+static uint16_t record_number;
+static uint32_t records_queued;
+static uint32_t samples;
+static uint32_t dropped;
+static uint16_t threshold_mg;
+static bool baseline_valid;
+static int32_t baseline[FLASH_CAPTURE_AXIS_COUNT];
+static int64_t start_ticks;
+
+/* Writer owned */
+static uint8_t write_index;
+static uint32_t write_offset;
+static uint32_t erased_end;
+static uint32_t bytes_written;
+static uint32_t erase_stalls;
+static uint32_t write_us;
+static uint32_t erase_us;
+static int64_t end_ticks;
+static atomic_t restart;
+/* Set once the end of the capture has been marked, nothing needs marking
+ * at start up as any recording in the region was already complete
+ */
+static bool end_marked = true;
+
+K_SEM_DEFINE(capture_sem, 0, 1);
+
+K_THREAD_STACK_DEFINE(capture_stack_area, CAPTURE_STACK_SIZE);
+static struct k_thread capture_thread_data;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void capture_thread(void *unused1, void *unused2, void *unused3);
+static int capture_begin(enum flash_capture_state state, uint16_t threshold);
+static bool capture_triggered(const int16_t *mg);
+static void record_complete(void);
+static void write_pending(void);
+static bool erase_needed(void);
+static int erase_next(void);
+static void mark_end(void);
+static void dump(void);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void capture_thread(void *unused1, void *unused2, void *unused3)
+{
+	while (1) {
+		/* Only block when there is nothing left to erase ahead */
+		k_sem_take(&capture_sem,
+			   erase_needed() ? K_NO_WAIT : K_FOREVER);
+
+		if (atomic_cas(&restart, 1, 0)) {
+			write_index = 0;
+			write_offset = CAPTURE_REGION_START;
+			erased_end = CAPTURE_REGION_START;
+			bytes_written = 0;
+			erase_stalls = 0;
+			write_us = 0;
+			erase_us = 0;
+			end_ticks = start_ticks;
+			end_marked = false;
+		}
+
+		write_pending();
+		mark_end();
+
+		if (atomic_get(&pending) == 0 && erase_needed()) {
+			if (erase_next() != 0) {
+				FlashCaptureStop();
+			}
+		}
+
+		if (capture_state == FLASH_CAPTURE_DUMPING) {
+			dump();
+		}
+	}
+}
+
+static int capture_begin(enum flash_capture_state state, uint16_t threshold)
+{
+	k_spinlock_key_t key = k_spin_lock(&capture_lock);
+
+	/* The previous capture must be completely written, as the new one
+	 * starts again from the beginning of the region
+	 */
+	if (capture_state != FLASH_CAPTURE_IDLE ||
+	    atomic_get(&pending) != 0) {
+		k_spin_unlock(&capture_lock, key);
+		return -EBUSY;
+	}
+
+	fill_index = 0;
+	fill_count = 0;
+	record_number = 0;
+	records_queued = 0;
+	samples = 0;
+	dropped = 0;
+	threshold_mg = threshold;
+	baseline_valid = false;
+	start_ticks = k_uptime_ticks();
+	capture_state = state;
+	atomic_set(&restart, 1);
+	k_spin_unlock(&capture_lock, key);
+
+	k_sem_give(&capture_sem);
+
+	return 0;
+}
+
+/** @brief Checks a sample against the trigger threshold, must be called with
+ *  the capture lock held.
+ */
+static bool capture_triggered(const int16_t *mg)
+{
+	bool triggered = false;
+	uint8_t axis = 0;
+	int32_t value;
+
+	while (axis < FLASH_CAPTURE_AXIS_COUNT) {
+		value = (int32_t)mg[axis] << BASELINE_FRACTION_BITS;
+
+		if (!baseline_valid) {
+			baseline[axis] = value;
+		} else if (abs(value - baseline[axis]) >
+			   ((int32_t)threshold_mg << BASELINE_FRACTION_BITS)) {
+			triggered = true;
+		}
+
+		baseline[axis] += (value - baseline[axis]) >> BASELINE_SHIFT;
+		++axis;
+	}
+
+	baseline_valid = true;
+
+	return triggered;
+}
+
+/** @brief Fills in the header and CRC of the record being filled and passes
+ *  it to the writer, must be called with the capture lock held.
+ */
+static void record_complete(void)
+{
+	uint8_t *record = records[fill_index];
+
+	sys_put_le16(FLASH_CAPTURE_SYNC_WORD, &record[RECORD_OFFSET_SYNC]);
+	sys_put_le16(record_number, &record[RECORD_OFFSET_NUMBER]);
+	sys_put_le16(ApplicationGetRate(), &record[RECORD_OFFSET_RATE]);
+	record[RECORD_OFFSET_AXIS_MASK] = RECORD_AXIS_MASK;
+	record[RECORD_OFFSET_COUNT] = fill_count;
+	sys_put_le16(crc16_ccitt(FLASH_CAPTURE_CRC_SEED,
+				 &record[RECORD_OFFSET_NUMBER],
+				 RECORD_OFFSET_CRC - RECORD_OFFSET_NUMBER),
+		     &record[RECORD_OFFSET_CRC]);
+
+	atomic_set_bit(&pending, fill_index);
+	k_sem_give(&capture_sem);
+
+	++record_number;
+	++records_queued;
+	fill_index = (fill_index + 1) % CAPTURE_BUFFERS;
+	fill_count = 0;
+}
+
+static void write_pending(void)
+{
+	int64_t start;
+	int rc = 0;
+
+	while (atomic_test_bit(&pending, write_index)) {
+		if (write_offset >= erased_end) {
+			/* Erasing has fallen behind, the other buffer has to
+			 * absorb the samples whilst the erase completes
+			 */
+			++erase_stalls;
+			rc = erase_next();
+		}
+
+		if (rc == 0) {
+			start = k_uptime_ticks();
+			rc = flash_write(flash_dev, write_offset,
+					 records[write_index],
+					 FLASH_CAPTURE_RECORD_SIZE);
+			end_ticks = k_uptime_ticks();
+			write_us += k_ticks_to_us_floor32(end_ticks - start);
+		}
+
+		if (rc != 0) {
+			LOG_ERR("Capture flash access failed at 0x%x (%d)",
+				write_offset, rc);
+			FlashCaptureStop();
+			atomic_clear(&pending);
+			return;
+		}
+
+		write_offset += FLASH_CAPTURE_RECORD_SIZE;
+		bytes_written += FLASH_CAPTURE_RECORD_SIZE;
+		atomic_clear_bit(&pending, write_index);
+		write_index = (write_index + 1) % CAPTURE_BUFFERS;
+	}
+}
+
+static bool erase_needed(void)
+{
+	enum flash_capture_state state = capture_state;
+
+	return ((state == FLASH_CAPTURE_ARMED ||
+		 state == FLASH_CAPTURE_RECORDING) &&
+		!atomic_get(&restart) && erased_end < CAPTURE_REGION_END &&
+		(erased_end - write_offset) < CAPTURE_ERASE_AHEAD);
+}
+
+static int erase_next(void)
+{
+	int64_t start = k_uptime_ticks();
+	int rc = flash_erase(flash_dev, erased_end, CAPTURE_SECTOR_SIZE);
+
+	erase_us += k_ticks_to_us_floor32(k_uptime_ticks() - start);
+
+	if (rc == 0) {
+		erased_end += CAPTURE_SECTOR_SIZE;
+	}
+
+	return rc;
+}
+
+/** @brief Once a capture has stopped and its last record is written, erases
+ *  the sector after it if that was not already erased ahead, so that the
+ *  records of an earlier, longer capture do not carry on its sequence.
+ */
+static void mark_end(void)
+{
+	enum flash_capture_state state = capture_state;
+
+	if (end_marked || atomic_get(&restart) || atomic_get(&pending) != 0 ||
+	    state == FLASH_CAPTURE_ARMED || state == FLASH_CAPTURE_RECORDING) {
+		return;
+	}
+
+	if (write_offset >= erased_end && erased_end < CAPTURE_REGION_END) {
+		if (erase_next() != 0) {
+			LOG_ERR("Could not erase after capture at 0x%x",
+				erased_end);
+		}
+	}
+
+	end_marked = true;
+}
+
+/** @brief Sends each record of the recording out of the UART until one is
+ *  found which is erased or out of sequence, which also finds the end of a
+ *  recording made before a reset.
+ */
+static void dump(void)
+{
+	uint32_t offset = CAPTURE_REGION_START;
+	uint16_t number = 0;
+	size_t i;
+
+	if (OutputSuspend(true) != 0) {
+		LOG_ERR("Could not suspend sample output for the dump");
+		OutputSuspend(false);
+		capture_state = FLASH_CAPTURE_IDLE;
+		return;
+	}
+
+	while (offset < CAPTURE_REGION_END) {
+		if (flash_read(flash_dev, offset, dump_record,
+			       sizeof(dump_record)) != 0 ||
+		    sys_get_le16(&dump_record[RECORD_OFFSET_SYNC]) !=
+			    FLASH_CAPTURE_SYNC_WORD ||
+		    sys_get_le16(&dump_record[RECORD_OFFSET_NUMBER]) !=
+			    number) {
+			break;
+		}
+
+		/* Written directly to the UART as the console would insert
+		 * carriage returns before any 0x0a bytes
+		 */
+		for (i = 0; i < sizeof(dump_record); ++i) {
+			uart_poll_out(uart_dev, dump_record[i]);
+		}
+
+		offset += FLASH_CAPTURE_RECORD_SIZE;
+		++number;
+	}
+
+	OutputSuspend(false);
+	LOG_INF("Dumped %u capture records", number);
+
+	capture_state = FLASH_CAPTURE_IDLE;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int FlashCaptureInit(void)
+{
+	flash_dev = device_get_binding(DT_LABEL(QSPI_NODE));
+	uart_dev = device_get_binding(DT_LABEL(DT_CHOSEN(zephyr_console)));
+
+	if (flash_dev == NULL || uart_dev == NULL) {
+		LOG_ERR("Could not get capture flash or UART device");
+		return -ENODEV;
+	}
+
+	capture_state = FLASH_CAPTURE_IDLE;
+
+	k_thread_create(&capture_thread_data, capture_stack_area,
+			K_THREAD_STACK_SIZEOF(capture_stack_area),
+			capture_thread, NULL, NULL, NULL, CAPTURE_PRIORITY, 0,
+			K_NO_WAIT);
+	k_thread_name_set(&capture_thread_data, "capture");
+
+	if (CONFIG_APP_CAPTURE_TRIGGER_MG > 0) {
+		return FlashCaptureArm(CONFIG_APP_CAPTURE_TRIGGER_MG);
+	}
+
+	return 0;
+}
+
+void FlashCaptureAdd(const int16_t *mg)
+{
+	k_spinlock_key_t key = k_spin_lock(&capture_lock);
+	uint8_t *value;
+	uint8_t axis = 0;
+
+	if (capture_state == FLASH_CAPTURE_ARMED && capture_triggered(mg)) {
+		start_ticks = k_uptime_ticks();
+		capture_state = FLASH_CAPTURE_RECORDING;
+	}
+
+	if (capture_state != FLASH_CAPTURE_RECORDING) {
+		k_spin_unlock(&capture_lock, key);
+		return;
+	}
+
+	if (atomic_test_bit(&pending, fill_index)) {
+		/* Both buffers are waiting for the writer */
+		++dropped;
+		k_spin_unlock(&capture_lock, key);
+		return;
+	}
+
+	value = &records[fill_index][FLASH_CAPTURE_HEADER_SIZE +
+				    (fill_count * FLASH_CAPTURE_AXIS_COUNT *
+				     sizeof(int16_t))];
+
+	while (axis < FLASH_CAPTURE_AXIS_COUNT) {
+		sys_put_le16((uint16_t)mg[axis], value);
+		value += sizeof(int16_t);
+		++axis;
+	}
+	++fill_count;
+	++samples;
+
+	if (samples >= CONFIG_APP_CAPTURE_SAMPLES ||
+	    ((records_queued + 1) >= CAPTURE_REGION_RECORDS &&
+	     fill_count == FLASH_CAPTURE_RECORD_SAMPLES)) {
+		/* Burst complete or the region is full */
+		record_complete();
+		capture_state = FLASH_CAPTURE_IDLE;
+	} else if (fill_count == FLASH_CAPTURE_RECORD_SAMPLES) {
+		record_complete();
+	}
+
+	k_spin_unlock(&capture_lock, key);
+}
+
+int FlashCaptureStart(void)
+{
+	return capture_begin(FLASH_CAPTURE_RECORDING, 0);
+}
+
+int FlashCaptureArm(uint16_t threshold)
+{
+	return capture_begin(FLASH_CAPTURE_ARMED, threshold);
+}
+
+void FlashCaptureStop(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&capture_lock);
+
+	if (capture_state == FLASH_CAPTURE_RECORDING && fill_count > 0 &&
+	    !atomic_test_bit(&pending, fill_index)) {
+		record_complete();
+	}
+
+	if (capture_state != FLASH_CAPTURE_DUMPING) {
+		capture_state = FLASH_CAPTURE_IDLE;
+	}
+
+	k_spin_unlock(&capture_lock, key);
+}
+
+int FlashCaptureDump(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&capture_lock);
+
+	if (capture_state != FLASH_CAPTURE_IDLE ||
+	    atomic_get(&pending) != 0) {
+		k_spin_unlock(&capture_lock, key);
+		return -EBUSY;
+	}
+
+	capture_state = FLASH_CAPTURE_DUMPING;
+	k_spin_unlock(&capture_lock, key);
+
+	k_sem_give(&capture_sem);
+
+	return 0;
+}
+
+void FlashCaptureGetStats(struct flash_capture_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&capture_lock);
+
+	stats->state = capture_state;
+	stats->samples = samples;
+	stats->dropped = dropped;
+	stats->bytes_written = bytes_written;
+	stats->erase_stalls = erase_stalls;
+	stats->write_us = write_us;
+	stats->erase_us = erase_us;
+	stats->elapsed_ms = (end_ticks > start_ticks) ?
+				    k_ticks_to_ms_floor32(end_ticks -
+							  start_ticks) :
+				    0;
+	k_spin_unlock(&capture_lock, key);
+}
@@ -0,0 +1,189 @@
+/**
+ * @file frame.c
+ * @brief Binary framed sample output encoder for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/byteorder.h>
+#include <sys/crc.h>
+
+#include "frame.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define FRAME_OFFSET_SYNC 0
+#define FRAME_OFFSET_SEQUENCE 2
+#define FRAME_OFFSET_RATE 4
+#define FRAME_OFFSET_AXIS_MASK 6
+#define FRAME_OFFSET_COUNT 7
+#define FRAME_OFFSET_LENGTH 8
+
+#define VARINT_VALUE_BITS 7
+#define VARINT_VALUE_MASK 0x7F
+#define VARINT_CONTINUE BIT(7)
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void frame_start(struct frame_encoder *encoder);
+static size_t frame_header_size(const struct frame_encoder *encoder);
+static void frame_put_varint(struct frame_encoder *encoder, int32_t value);
+static void frame_put_value(struct frame_encoder *encoder, uint8_t axis,
+			    int16_t mg);
+static void frame_put_timestamp(struct frame_encoder *encoder,
+				uint32_t timestamp_us);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void frame_start(struct frame_encoder *encoder)
+{
+	sys_put_le16(FRAME_SYNC_WORD, &encoder->buffer[FRAME_OFFSET_SYNC]);
+	sys_put_le16(encoder->sequence,
+		     &encoder->buffer[FRAME_OFFSET_SEQUENCE]);
+	sys_put_le16(encoder->rate_hz, &encoder->buffer[FRAME_OFFSET_RATE]);
+	encoder->buffer[FRAME_OFFSET_AXIS_MASK] = encoder->axis_mask;
+	encoder->length = frame_header_size(encoder);
+	encoder->samples = 0;
+}
+
+static size_t frame_header_size(const struct frame_encoder *encoder)
+{
+	return (encoder->axis_mask & FRAME_FLAG_COMPRESSED) ?
+		       (FRAME_HEADER_SIZE + FRAME_LENGTH_SIZE) :
+		       FRAME_HEADER_SIZE;
+}
+
+/** @brief Appends a zigzag encoded varint, small magnitudes of either sign
+ *  take a single byte.
+ */
+static void frame_put_varint(struct frame_encoder *encoder, int32_t value)
+{
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+
+	while (zigzag > VARINT_VALUE_MASK) {
+		encoder->buffer[encoder->length++] =
+			(zigzag & VARINT_VALUE_MASK) | VARINT_CONTINUE;
+		zigzag >>= VARINT_VALUE_BITS;
+	}
+	encoder->buffer[encoder->length++] = zigzag;
+}
+
+static void frame_put_value(struct frame_encoder *encoder, uint8_t axis,
+			    int16_t mg)
+{
+	if (!(encoder->axis_mask & FRAME_FLAG_COMPRESSED)) {
+		sys_put_le16((uint16_t)mg, &encoder->buffer[encoder->length]);
+		encoder->length += sizeof(int16_t);
+	} else if (encoder->samples == 0) {
+		/* The first sample of each frame is a keyframe */
+		frame_put_varint(encoder, mg);
+		encoder->previous[axis] = mg;
+	} else {
+		frame_put_varint(encoder,
+				 (int32_t)mg - encoder->previous[axis]);
+		encoder->previous[axis] = mg;
+	}
+}
+
+static void frame_put_timestamp(struct frame_encoder *encoder,
+				uint32_t timestamp_us)
+{
+	if (!(encoder->axis_mask & FRAME_FLAG_COMPRESSED)) {
+		sys_put_le32(timestamp_us, &encoder->buffer[encoder->length]);
+		encoder->length += sizeof(uint32_t);
+	} else if (encoder->samples == 0) {
+		frame_put_varint(encoder, (int32_t)timestamp_us);
+	} else {
+		/* Wraps correctly as the difference is taken modulo 2^32 */
+		frame_put_varint(encoder,
+				 (int32_t)(timestamp_us -
+					   encoder->previous_timestamp));
+	}
+
+	encoder->previous_timestamp = timestamp_us;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void FrameEncoderInit(struct frame_encoder *encoder, uint16_t rate_hz,
+		      uint8_t axis_mask)
+{
+	encoder->sequence = 0;
+	encoder->rate_hz = rate_hz;
+	encoder->axis_mask = axis_mask;
+	frame_start(encoder);
+}
+
+void FrameEncoderConfigure(struct frame_encoder *encoder, uint16_t rate_hz,
+			   uint8_t axis_mask)
+{
+	encoder->rate_hz = rate_hz;
+	encoder->axis_mask = axis_mask;
+	frame_start(encoder);
+}
+
+bool FrameEncoderAdd(struct frame_encoder *encoder, const int16_t *mg,
+		     uint32_t timestamp_us)
+{
+	uint8_t i = 0;
+
+	if (encoder->samples == 0 &&
+	    encoder->length != frame_header_size(encoder)) {
+		/* Previous frame has been read out, begin the next one */
+		frame_start(encoder);
+	}
+
+	if (encoder->axis_mask & FRAME_FLAG_TIMESTAMPS) {
+		frame_put_timestamp(encoder, timestamp_us);
+	}
+
+	while (i < FRAME_AXIS_MAX) {
+		if (encoder->axis_mask & BIT(i)) {
+			frame_put_value(encoder, i, mg[i]);
+		}
+		++i;
+	}
+
+	++encoder->samples;
+
+	return (encoder->samples >= CONFIG_APP_BINARY_FRAME_SAMPLES);
+}
+
+const uint8_t *FrameEncoderFinish(struct frame_encoder *encoder,
+				  size_t *length)
+{
+	uint16_t crc;
+
+	if (encoder->samples == 0) {
+		*length = 0;
+		return encoder->buffer;
+	}
+
+	encoder->buffer[FRAME_OFFSET_COUNT] = encoder->samples;
+	if (encoder->axis_mask & FRAME_FLAG_COMPRESSED) {
+		sys_put_le16(encoder->length - FRAME_HEADER_SIZE -
+				     FRAME_LENGTH_SIZE,
+			     &encoder->buffer[FRAME_OFFSET_LENGTH]);
+	}
+	crc = crc16_ccitt(FRAME_CRC_SEED,
+			  &encoder->buffer[FRAME_OFFSET_SEQUENCE],
+			  encoder->length - FRAME_OFFSET_SEQUENCE);
+	sys_put_le16(crc, &encoder->buffer[encoder->length]);
+	*length = encoder->length + FRAME_CRC_SIZE;
+
+	/* Next add starts a fresh frame with the following sequence number */
+	++encoder->sequence;
+	encoder->samples = 0;
+
+	return encoder->buffer;
+}
@@ -0,0 +1,368 @@
+/**
+ * @file goertzel.c
+ * @brief Goertzel filter bank for monitoring fixed vibration frequencies
+ *
+ * Each bin is a second order resonator tuned to one frequency, updated with
+ * a single multiply per sample, so known fault frequencies (shaft rate,
+ * bearing defect frequencies, gear mesh) can be tracked at the full sensor
+ * rate without buffering samples for an FFT.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <arm_math.h>
+
+#include "goertzel.h"
+#include "isqrt.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define BLOCK_SAMPLES CONFIG_APP_GOERTZEL_BLOCK_SAMPLES
+
+/* Bins must be at least one bin width (the sample rate / BLOCK_SAMPLES) from
+ * DC and half the sample rate. A tone of amplitude A at the bin frequency
+ * grows the state to about A * N / (2 * sin(2 * pi * f / fs)), which this
+ * limits to below N^2 * A / (4 * pi). With N up to 1024 and A up to 16 g
+ * that fits the 32-bit state.
+ */
+#define BLOCK_SAMPLES_MAX 1024
+BUILD_ASSERT(BLOCK_SAMPLES <= BLOCK_SAMPLES_MAX,
+	     "Goertzel block length would overflow the filter state");
+
+#define DECI_UNITS 10
+#define FREQUENCY_MAX_DHZ (UINT16_MAX * DECI_UNITS)
+#define Q31_BITS 31
+#define Q30_BITS 30
+
+struct goertzel_state {
+	int32_t s1;
+	int32_t s2;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct goertzel_bin bank[GOERTZEL_BINS_MAX];
+static uint8_t bin_count;
+static struct k_spinlock bank_lock;
+
+/* cos(w) and sin(w) in Q31, cos(w) in Q31 is also the 2 * cos(w) resonator
+ * coefficient in Q30. Inactive bins have both set to 0
+ */
+static q31_t cosine[GOERTZEL_BINS_MAX];
+static q31_t sine[GOERTZEL_BINS_MAX];
+
+static struct goertzel_state state[GOERTZEL_AXIS_COUNT][GOERTZEL_BINS_MAX];
+static uint32_t block_fill;
+
+/* Gravity and sensor offset are removed before the filters using the mean
+ * of the previous block, so that they do not leak into low frequency bins
+ */
+static int32_t block_sum[GOERTZEL_AXIS_COUNT];
+static int16_t offset[GOERTZEL_AXIS_COUNT];
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int parse_list(const char *text, uint32_t *values, bool tenths);
+static bool bin_tune(uint8_t bin, uint32_t rate_hz);
+static uint16_t bin_magnitude(const struct goertzel_state *bin_state,
+			      uint8_t bin);
+static void block_start(void);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Parses a comma separated list of positive numbers, with up to one
+ *  decimal place if tenths is set, in which case the values are returned in
+ *  tenths.
+ *
+ *  @retval Number of values, -EINVAL if the list is malformed or too long
+ */
+static int parse_list(const char *text, uint32_t *values, bool tenths)
+{
+	uint8_t count = 0;
+	uint32_t value;
+	bool digits;
+
+	while (*text != '\0') {
+		while (*text == ' ') {
+			++text;
+		}
+
+		if (*text == '\0') {
+			break;
+		} else if (count == GOERTZEL_BINS_MAX) {
+			return -EINVAL;
+		}
+
+		value = 0;
+		digits = false;
+		while (*text >= '0' && *text <= '9' && value <= UINT16_MAX) {
+			value = (value * 10) + (*text - '0');
+			digits = true;
+			++text;
+		}
+
+		if (tenths) {
+			value *= DECI_UNITS;
+			if (*text == '.' && text[1] >= '0' && text[1] <= '9') {
+				value += text[1] - '0';
+				text += 2;
+			}
+		}
+
+		while (*text == ' ') {
+			++text;
+		}
+
+		if (!digits ||
+		    value > (tenths ? FREQUENCY_MAX_DHZ : UINT16_MAX)) {
+			return -EINVAL;
+		} else if (*text == ',') {
+			++text;
+		} else if (*text != '\0') {
+			return -EINVAL;
+		}
+
+		values[count] = value;
+		++count;
+	}
+
+	return count;
+}
+
+/** @brief Calculates the coefficients of a bin for the sample rate.
+ *
+ *  @retval True if the bin can be measured at this rate
+ */
+static bool bin_tune(uint8_t bin, uint32_t rate_hz)
+{
+	uint32_t rate_dhz = rate_hz * DECI_UNITS;
+	uint32_t width_dhz = DIV_ROUND_UP(rate_dhz, BLOCK_SAMPLES);
+	uint32_t frequency_dhz = bank[bin].frequency_dhz;
+	q31_t phase;
+
+	cosine[bin] = 0;
+	sine[bin] = 0;
+
+	if (frequency_dhz < width_dhz ||
+	    (frequency_dhz + width_dhz) > (rate_dhz / 2)) {
+		return false;
+	}
+
+	/* arm_cos_q31 takes the angle as a fraction of a whole turn */
+	phase = (q31_t)(((uint64_t)frequency_dhz << Q31_BITS) / rate_dhz);
+	cosine[bin] = arm_cos_q31(phase);
+	sine[bin] = arm_sin_q31(phase);
+
+	return true;
+}
+
+/** @brief Amplitude in milli-g at the bin frequency over the completed
+ *  block.
+ */
+static uint16_t bin_magnitude(const struct goertzel_state *bin_state,
+			      uint8_t bin)
+{
+	int64_t real = (int64_t)bin_state->s1 -
+		       (((int64_t)bin_state->s2 * cosine[bin]) >> Q31_BITS);
+	int64_t imag = ((int64_t)bin_state->s2 * sine[bin]) >> Q31_BITS;
+	uint8_t shift = 0;
+	uint64_t amplitude;
+
+	/* Keep the sum of squares within 64 bits */
+	while (real > INT32_MAX || real < -INT32_MAX || imag > INT32_MAX ||
+	       imag < -INT32_MAX) {
+		real >>= 1;
+		imag >>= 1;
+		++shift;
+	}
+
+	amplitude = (uint64_t)Isqrt64((uint64_t)(real * real) +
+				      (uint64_t)(imag * imag))
+		    << shift;
+
+	/* A tone of amplitude A at the bin frequency has a magnitude of
+	 * A * N / 2
+	 */
+	amplitude = (amplitude * 2) / BLOCK_SAMPLES;
+
+	return (amplitude > UINT16_MAX) ? UINT16_MAX : (uint16_t)amplitude;
+}
+
+static void block_start(void)
+{
+	uint8_t axis = 0;
+
+	while (axis < GOERTZEL_AXIS_COUNT) {
+		if (block_fill == BLOCK_SAMPLES) {
+			offset[axis] = (int16_t)(block_sum[axis] / BLOCK_SAMPLES);
+		}
+		block_sum[axis] = 0;
+		++axis;
+	}
+
+	memset(state, 0, sizeof(state));
+	block_fill = 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int GoertzelInit(uint32_t rate_hz)
+{
+	uint32_t frequencies[GOERTZEL_BINS_MAX];
+	uint32_t thresholds[GOERTZEL_BINS_MAX];
+	int frequency_count;
+	int threshold_count;
+	uint8_t i = 0;
+
+	frequency_count = parse_list(CONFIG_APP_GOERTZEL_FREQUENCIES,
+				     frequencies, true);
+	threshold_count = parse_list(CONFIG_APP_GOERTZEL_THRESHOLDS_MG,
+				     thresholds, false);
+
+	if (frequency_count <= 0 || threshold_count < 0 ||
+	    threshold_count > frequency_count) {
+		return -EINVAL;
+	}
+
+	memset(bank, 0, sizeof(bank));
+	bin_count = (uint8_t)frequency_count;
+
+	while (i < bin_count) {
+		bank[i].frequency_dhz = frequencies[i];
+		if (i < threshold_count) {
+			bank[i].threshold_mg = (uint16_t)thresholds[i];
+		}
+		++i;
+	}
+
+	/* As when the rate changes, bins which cannot be measured are
+	 * deactivated rather than stopping the others from running
+	 */
+	return GoertzelSetRate(rate_hz);
+}
+
+uint8_t GoertzelSetRate(uint32_t rate_hz)
+{
+	k_spinlock_key_t key;
+	uint8_t active = 0;
+	uint8_t i = 0;
+	bool tuned;
+
+	while (i < bin_count) {
+		tuned = bin_tune(i, rate_hz);
+
+		key = k_spin_lock(&bank_lock);
+		bank[i].active = tuned;
+		memset(bank[i].magnitude_mg, 0, sizeof(bank[i].magnitude_mg));
+		k_spin_unlock(&bank_lock, key);
+
+		if (tuned) {
+			++active;
+		}
+		++i;
+	}
+
+	GoertzelReset();
+
+	return active;
+}
+
+void GoertzelReset(void)
+{
+	/* Discarding the block keeps the offsets from the last complete one */
+	block_fill = 0;
+	block_start();
+}
+
+bool GoertzelAdd(const int16_t *mg, const uint8_t *axes, uint8_t axis_count)
+{
+	struct goertzel_state *axis_state;
+	int32_t x;
+	int32_t s0;
+	uint8_t axis = 0;
+	uint8_t bin;
+
+	if (block_fill == BLOCK_SAMPLES) {
+		block_start();
+	}
+
+	while (axis < axis_count) {
+		axis_state = state[axes[axis]];
+		block_sum[axes[axis]] += mg[axes[axis]];
+		x = mg[axes[axis]] - offset[axes[axis]];
+
+		/* s0 = x + 2 * cos(w) * s1 - s2, the multiply is a single
+		 * 32 x 32 -> 64 bit SMULL
+		 */
+		bin = 0;
+		while (bin < bin_count) {
+			s0 = x +
+			     (int32_t)(((int64_t)cosine[bin] *
+					axis_state[bin].s1) >>
+				       Q30_BITS) -
+			     axis_state[bin].s2;
+			axis_state[bin].s2 = axis_state[bin].s1;
+			axis_state[bin].s1 = s0;
+			++bin;
+		}
+		++axis;
+	}
+
+	++block_fill;
+
+	return block_fill == BLOCK_SAMPLES;
+}
+
+uint32_t GoertzelCompute(uint8_t axis, uint16_t *magnitudes)
+{
+	k_spinlock_key_t key;
+	uint32_t alarms = 0;
+	uint8_t i = 0;
+
+	while (i < bin_count) {
+		magnitudes[i] = bank[i].active ?
+					bin_magnitude(&state[axis][i], i) :
+					0;
+		++i;
+	}
+
+	key = k_spin_lock(&bank_lock);
+	for (i = 0; i < bin_count; ++i) {
+		bank[i].magnitude_mg[axis] = magnitudes[i];
+
+		if (bank[i].threshold_mg > 0 &&
+		    magnitudes[i] > bank[i].threshold_mg) {
+			++bank[i].alarms;
+			alarms |= BIT(i);
+		}
+	}
+	k_spin_unlock(&bank_lock, key);
+
+	return alarms;
+}
+
+uint8_t GoertzelGetBins(struct goertzel_bin *bins)
+{
+	k_spinlock_key_t key;
+
+	if (bins != NULL) {
+		key = k_spin_lock(&bank_lock);
+		memcpy(bins, bank, sizeof(bank));
+		k_spin_unlock(&bank_lock, key);
+	}
+
+	return bin_count;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file inference.c
+ * @brief Double buffered sample windows for on-device inference
+ *
+ * Acquisition fills one window buffer while a lower priority inference
+ * thread classifies a previously completed one, so classification never
+ * stalls sampling. With more than two buffers, complete windows queue up to
+ * absorb classifiers whose run time varies. If every buffer is still
+ * waiting, a window's worth of samples is discarded and counted as dropped,
+ * which keeps the following windows aligned to the sample stream.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <stdio.h>
+#include <logging/log.h>
+#include <sys/atomic.h>
+
+#include "inference.h"
+#include "output.h"
+
+LOG_MODULE_REGISTER(inference);
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define INFERENCE_STACK_SIZE 4096
+#define INFERENCE_PRIORITY 9
+
+#define WINDOW_COUNT CONFIG_APP_INFERENCE_WINDOWS
+#define WINDOW_SAMPLES CONFIG_APP_INFERENCE_WINDOW_SAMPLES
+
+BUILD_ASSERT(WINDOW_COUNT <= (sizeof(atomic_t) * 8),
+	     "Too many inference windows");
+
+struct inference_window {
+	int16_t samples[WINDOW_SAMPLES][INFERENCE_AXIS_COUNT];
+	uint32_t number;
+	uint32_t first_cycles;
+	uint32_t ready_cycles;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct inference_window windows[WINDOW_COUNT];
+
+/* A window is owned by the inference thread whilst its bit is set */
+static atomic_t windows_ready;
+
+/* Acquisition owned */
+static uint8_t fill_index;
+static uint32_t fill_count;
+static bool discarding;
+static uint32_t window_number;
+
+static inference_classifier_t inference_classifier;
+static struct inference_stats inference_stats;
+static struct k_spinlock inference_stats_lock;
+
+K_MSGQ_DEFINE(inference_msgq, sizeof(uint8_t), WINDOW_COUNT, 1);
+
+K_THREAD_STACK_DEFINE(inference_stack_area, INFERENCE_STACK_SIZE);
+static struct k_thread inference_thread_data;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void inference_thread(void *unused1, void *unused2, void *unused3);
+static void window_complete(void);
+static int motion_classifier(const int16_t (*samples)[INFERENCE_AXIS_COUNT],
+			     uint32_t count, struct inference_result *result);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void inference_thread(void *unused1, void *unused2, void *unused3)
+{
+	struct inference_result result;
+	struct inference_window *window;
+	uint32_t start;
+	uint32_t queue_us;
+	uint32_t inference_us;
+	k_spinlock_key_t key;
+	uint8_t index;
+	int rc;
+
+	while (1) {
+		k_msgq_get(&inference_msgq, &index, K_FOREVER);
+		window = &windows[index];
+
+		start = k_cycle_get_32();
+		rc = inference_classifier(window->samples, WINDOW_SAMPLES,
+					  &result);
+		inference_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+		queue_us = k_cyc_to_us_floor32(start - window->ready_cycles);
+
+		key = k_spin_lock(&inference_stats_lock);
+		inference_stats.fill_us = k_cyc_to_us_floor32(
+			window->ready_cycles - window->first_cycles);
+		inference_stats.queue_us = queue_us;
+		inference_stats.max_queue_us =
+			MAX(inference_stats.max_queue_us, queue_us);
+		inference_stats.inference_us = inference_us;
+		inference_stats.max_inference_us =
+			MAX(inference_stats.max_inference_us, inference_us);
+		if (rc == 0) {
+			++inference_stats.classified;
+		}
+		k_spin_unlock(&inference_stats_lock, key);
+
+		if (rc == 0) {
+			/* Held back whilst a flash capture dump has the UART */
+			OutputLock();
+			printf("%u,%s,%u,%u\r\n", window->number, result.label,
+			       result.confidence, inference_us);
+			OutputUnlock();
+		} else {
+			LOG_ERR("Window %u classification failed (%d)",
+				window->number, rc);
+		}
+
+		/* Hand the buffer back to acquisition */
+		atomic_clear_bit(&windows_ready, index);
+	}
+}
+
+static void window_complete(void)
+{
+	struct inference_window *window = &windows[fill_index];
+	k_spinlock_key_t key;
+	uint8_t next = (fill_index + 1) % WINDOW_COUNT;
+
+	key = k_spin_lock(&inference_stats_lock);
+	if (discarding) {
+		++inference_stats.dropped;
+	} else {
+		++inference_stats.windows;
+	}
+	k_spin_unlock(&inference_stats_lock, key);
+
+	if (!discarding) {
+		window->number = window_number;
+		window->ready_cycles = k_cycle_get_32();
+		atomic_set_bit(&windows_ready, fill_index);
+		k_msgq_put(&inference_msgq, &fill_index, K_NO_WAIT);
+		fill_index = next;
+	}
+
+	++window_number;
+	fill_count = 0;
+
+	/* Skip the next window of samples if its buffer is still queued */
+	discarding = atomic_test_bit(&windows_ready, fill_index);
+}
+
+/** @brief Default classifier, reports motion if the peak-to-peak range of
+ *  any axis exceeds the configured threshold.
+ */
+static int motion_classifier(const int16_t (*samples)[INFERENCE_AXIS_COUNT],
+			     uint32_t count, struct inference_result *result)
+{
+	int16_t min[INFERENCE_AXIS_COUNT];
+	int16_t max[INFERENCE_AXIS_COUNT];
+	int32_t range = 0;
+	uint32_t i = 0;
+	uint8_t axis;
+
+	for (axis = 0; axis < INFERENCE_AXIS_COUNT; ++axis) {
+		min[axis] = samples[0][axis];
+		max[axis] = samples[0][axis];
+	}
+
+	while (i < count) {
+		for (axis = 0; axis < INFERENCE_AXIS_COUNT; ++axis) {
+			min[axis] = MIN(min[axis], samples[i][axis]);
+			max[axis] = MAX(max[axis], samples[i][axis]);
+		}
+		++i;
+	}
+
+	for (axis = 0; axis < INFERENCE_AXIS_COUNT; ++axis) {
+		range = MAX(range, (int32_t)max[axis] - min[axis]);
+	}
+
+	result->label = (range > CONFIG_APP_INFERENCE_MOTION_MG) ? "motion" :
+								    "idle";
+	result->confidence = 100;
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int InferenceInit(void)
+{
+	if (inference_classifier == NULL) {
+		inference_classifier = motion_classifier;
+	}
+
+	fill_index = 0;
+	fill_count = 0;
+	discarding = false;
+	window_number = 0;
+	atomic_clear(&windows_ready);
+
+	k_thread_create(&inference_thread_data, inference_stack_area,
+			K_THREAD_STACK_SIZEOF(inference_stack_area),
+			inference_thread, NULL, NULL, NULL, INFERENCE_PRIORITY,
+			0, K_NO_WAIT);
+	k_thread_name_set(&inference_thread_data, "inference");
+
+	return 0;
+}
+
+void InferenceSetClassifier(inference_classifier_t classifier)
+{
+	inference_classifier = classifier;
+}
+
+void InferenceAdd(const int16_t *mg)
+{
+	struct inference_window *window = &windows[fill_index];
+	uint8_t axis = 0;
+
+	if (!discarding) {
+		if (fill_count == 0) {
+			window->first_cycles = k_cycle_get_32();
+		}
+
+		while (axis < INFERENCE_AXIS_COUNT) {
+			window->samples[fill_count][axis] = mg[axis];
+			++axis;
+		}
+	}
+
+	++fill_count;
+
+	if (fill_count == WINDOW_SAMPLES) {
+		window_complete();
+	}
+}
+
+void InferenceGetStats(struct inference_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&inference_stats_lock);
+
+	*stats = inference_stats;
+	k_spin_unlock(&inference_stats_lock, key);
+}
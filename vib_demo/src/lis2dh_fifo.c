@@ -0,0 +1,435 @@
+/**
+ * @file lis2dh_fifo.c
+ * @brief LIS2DH hardware FIFO burst acquisition for vibration demo
+ *
+ * The Zephyr LIS2DH driver only supports single sample reads, so this module
+ * configures the sensor FIFO directly over I2C. The FIFO runs in stream mode
+ * and the watermark interrupt on INT1 wakes the reader, which then drains
+ * every stored sample in a single I2C burst (the sensor wraps the output
+ * register address back to OUT_X_L when the FIFO is enabled).
+ *
+ * The watermark interrupt also timestamps the samples. The interrupt time
+ * (from the free running RTC behind the kernel tick) marks the arrival of
+ * the sample which took the FIFO past the watermark, the other samples in
+ * the burst are placed either side of it at the sensor's sample period. The
+ * period is measured from the interrupt times as the sensor's internal
+ * oscillator can be several percent off its nominal rate.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <device.h>
+#include <errno.h>
+#include <logging/log.h>
+#include <drivers/gpio.h>
+#include <drivers/i2c.h>
+#include <sys/atomic.h>
+
+#include "lis2dh_fifo.h"
+#include "accel_convert.h"
+
+LOG_MODULE_REGISTER(lis2dh_fifo);
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define LIS2DH_NODE DT_INST(0, st_lis2dh)
+
+#define LIS2DH_REG_CTRL1 0x20
+#define LIS2DH_REG_CTRL3 0x22
+#define LIS2DH_REG_CTRL4 0x23
+#define LIS2DH_REG_CTRL5 0x24
+#define LIS2DH_REG_OUT_X_L 0x28
+#define LIS2DH_REG_FIFO_CTRL 0x2E
+#define LIS2DH_REG_FIFO_SRC 0x2F
+#define LIS2DH_AUTOINCREMENT_ADDR BIT(7)
+
+#define LIS2DH_CTRL1_ODR_SHIFT 4
+#define LIS2DH_CTRL1_LP_EN BIT(3)
+#define LIS2DH_CTRL1_XYZ_EN (BIT(0) | BIT(1) | BIT(2))
+#define LIS2DH_CTRL3_I1_WTM BIT(2)
+#define LIS2DH_CTRL4_FS_SHIFT 4
+#define LIS2DH_CTRL4_HR BIT(3)
+#define LIS2DH_CTRL5_FIFO_EN BIT(6)
+#define LIS2DH_FIFO_CTRL_MODE_BYPASS 0
+#define LIS2DH_FIFO_CTRL_MODE_STREAM (2 << 6)
+#define LIS2DH_FIFO_SRC_OVRN BIT(6)
+#define LIS2DH_FIFO_SRC_FSS_MASK 0x1F
+
+#define LIS2DH_SAMPLE_SIZE ACCEL_CONVERT_RAW_SAMPLE_SIZE
+
+/* The sample period estimate is held in microseconds with 8 fractional
+ * bits and follows the measured period with a time constant of 8 bursts.
+ * Measurements more than 25% from the nominal period (a delayed interrupt)
+ * are ignored
+ */
+#define PERIOD_FRACTION_BITS 8
+#define PERIOD_FILTER_SHIFT 3
+#define PERIOD_TOLERANCE_SHIFT 2
+
+/* Data is left justified, high resolution mode is 12-bit and low power mode
+ * is 8-bit
+ */
+#define LIS2DH_HR_SHIFT 4
+#define LIS2DH_LP_SHIFT 8
+
+#if defined(CONFIG_LIS2DH_ACCEL_RANGE_2G)
+#define LIS2DH_FS 0
+#define LIS2DH_HR_SENSITIVITY_MG 1
+#elif defined(CONFIG_LIS2DH_ACCEL_RANGE_8G)
+#define LIS2DH_FS 2
+#define LIS2DH_HR_SENSITIVITY_MG 4
+#elif defined(CONFIG_LIS2DH_ACCEL_RANGE_16G)
+#define LIS2DH_FS 3
+#define LIS2DH_HR_SENSITIVITY_MG 12
+#else
+#define LIS2DH_FS 1
+#define LIS2DH_HR_SENSITIVITY_MG 2
+#endif
+
+struct lis2dh_odr {
+	uint16_t hz;
+	uint8_t odr;
+	bool low_power;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct lis2dh_odr odr_table[] = {
+	{ 1, 1, false },   { 10, 2, false },  { 25, 3, false },
+	{ 50, 4, false },  { 100, 5, false }, { 200, 6, false },
+	{ 400, 7, false }, { 1344, 9, false }, { 1620, 8, true },
+};
+
+static const struct device *i2c_dev;
+static const struct device *gpio_dev;
+static struct gpio_callback gpio_cb;
+static struct accel_convert accel_convert;
+static uint32_t overruns;
+static int64_t watermark_ticks;
+static struct k_spinlock watermark_lock;
+static int64_t previous_watermark_us;
+static uint8_t previous_count;
+static uint32_t nominal_period_q8;
+static uint32_t period_q8;
+static uint8_t burst_buffer[LIS2DH_FIFO_DEPTH * LIS2DH_SAMPLE_SIZE];
+
+/* Index into odr_table plus one of a rate change for the reader to apply,
+ * 0 if there is none
+ */
+static atomic_t pending_odr;
+
+K_SEM_DEFINE(fifo_watermark_sem, 0, 1);
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void fifo_watermark_handler(const struct device *dev,
+				   struct gpio_callback *cb, uint32_t pins);
+static int write_reg(uint8_t reg, uint8_t value);
+static const struct lis2dh_odr *find_odr(uint16_t odr_hz);
+static int fifo_configure(const struct lis2dh_odr *odr);
+static void update_period(int64_t watermark_us, bool overrun);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void fifo_watermark_handler(const struct device *dev,
+				   struct gpio_callback *cb, uint32_t pins)
+{
+	k_spinlock_key_t key = k_spin_lock(&watermark_lock);
+
+	watermark_ticks = k_uptime_ticks();
+	k_spin_unlock(&watermark_lock, key);
+	k_sem_give(&fifo_watermark_sem);
+}
+
+static int write_reg(uint8_t reg, uint8_t value)
+{
+	return i2c_reg_write_byte(i2c_dev, DT_REG_ADDR(LIS2DH_NODE), reg,
+				  value);
+}
+
+static const struct lis2dh_odr *find_odr(uint16_t odr_hz)
+{
+	uint8_t i = 0;
+
+	while (i < ARRAY_SIZE(odr_table)) {
+		if (odr_table[i].hz == odr_hz) {
+			return &odr_table[i];
+		}
+		++i;
+	}
+
+	return NULL;
+}
+
+/** @brief Resets the FIFO and starts sampling at the given rate, restarting
+ *  the sample period measurement.
+ */
+static int fifo_configure(const struct lis2dh_odr *odr)
+{
+	uint8_t shift = odr->low_power ? LIS2DH_LP_SHIFT : LIS2DH_HR_SHIFT;
+	int rc;
+
+	rc = AccelConvertSetRawFormat(
+		&accel_convert, shift,
+		LIS2DH_HR_SENSITIVITY_MG << (shift - LIS2DH_HR_SHIFT));
+
+	if (rc != 0) {
+		LOG_ERR("Calibration out of range for the sensor range");
+		return rc;
+	}
+
+	previous_count = 0;
+	nominal_period_q8 = (USEC_PER_SEC << PERIOD_FRACTION_BITS) / odr->hz;
+	period_q8 = nominal_period_q8;
+
+	/* Reset the FIFO by passing through bypass mode, then enable stream
+	 * mode with the watermark routed to INT1
+	 */
+	rc = write_reg(LIS2DH_REG_CTRL1, 0);
+
+	if (rc == 0) {
+		rc = write_reg(LIS2DH_REG_FIFO_CTRL,
+			       LIS2DH_FIFO_CTRL_MODE_BYPASS);
+	}
+
+	if (rc == 0) {
+		rc = write_reg(LIS2DH_REG_CTRL4,
+			       (LIS2DH_FS << LIS2DH_CTRL4_FS_SHIFT) |
+				       (odr->low_power ? 0 : LIS2DH_CTRL4_HR));
+	}
+
+	if (rc == 0) {
+		rc = write_reg(LIS2DH_REG_CTRL5, LIS2DH_CTRL5_FIFO_EN);
+	}
+
+	if (rc == 0) {
+		rc = write_reg(LIS2DH_REG_FIFO_CTRL,
+			       LIS2DH_FIFO_CTRL_MODE_STREAM |
+				       CONFIG_APP_FIFO_WATERMARK);
+	}
+
+	if (rc == 0) {
+		rc = write_reg(LIS2DH_REG_CTRL3, LIS2DH_CTRL3_I1_WTM);
+	}
+
+	if (rc == 0) {
+		/* Start sampling, the FIFO begins filling immediately */
+		rc = write_reg(LIS2DH_REG_CTRL1,
+			       (odr->odr << LIS2DH_CTRL1_ODR_SHIFT) |
+				       (odr->low_power ? LIS2DH_CTRL1_LP_EN :
+							 0) |
+				       LIS2DH_CTRL1_XYZ_EN);
+	}
+
+	if (rc != 0) {
+		LOG_ERR("Failed to configure sensor FIFO: %d", rc);
+	}
+
+	return rc;
+}
+
+/** @brief Refines the sample period estimate from the time between this and
+ *  the previous watermark interrupt, which is one previous burst of samples.
+ */
+static void update_period(int64_t watermark_us, bool overrun)
+{
+	uint32_t measured_q8;
+	uint32_t tolerance_q8 = nominal_period_q8 >> PERIOD_TOLERANCE_SHIFT;
+
+	if (previous_count > 0 && !overrun) {
+		measured_q8 = (uint32_t)(((watermark_us - previous_watermark_us)
+					  << PERIOD_FRACTION_BITS) /
+					 previous_count);
+
+		if (measured_q8 > (nominal_period_q8 - tolerance_q8) &&
+		    measured_q8 < (nominal_period_q8 + tolerance_q8)) {
+			period_q8 = (uint32_t)((int32_t)period_q8 +
+					       (((int32_t)measured_q8 -
+						 (int32_t)period_q8) >>
+						PERIOD_FILTER_SHIFT));
+		}
+	}
+
+	previous_watermark_us = watermark_us;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int Lis2dhFifoInit(uint16_t odr_hz)
+{
+	const struct lis2dh_odr *odr = find_odr(odr_hz);
+	struct accel_calibration calibration;
+	int rc;
+
+	if (odr == NULL) {
+		LOG_ERR("Unsupported FIFO output data rate %u Hz", odr_hz);
+		return -EINVAL;
+	}
+
+	i2c_dev = device_get_binding(DT_BUS_LABEL(LIS2DH_NODE));
+	gpio_dev = device_get_binding(
+		DT_GPIO_LABEL_BY_IDX(LIS2DH_NODE, irq_gpios, 0));
+
+	if (i2c_dev == NULL || gpio_dev == NULL) {
+		LOG_ERR("Could not get I2C bus or interrupt GPIO device");
+		return -ENODEV;
+	}
+
+	AccelCalibrationGetConfig(&calibration);
+	rc = AccelConvertInit(&accel_convert, &calibration);
+
+	if (rc != 0) {
+		LOG_ERR("Invalid accelerometer calibration");
+		return rc;
+	}
+
+	overruns = 0;
+	atomic_clear(&pending_odr);
+
+	gpio_pin_configure(gpio_dev,
+			   DT_GPIO_PIN_BY_IDX(LIS2DH_NODE, irq_gpios, 0),
+			   GPIO_INPUT |
+				   DT_GPIO_FLAGS_BY_IDX(LIS2DH_NODE, irq_gpios,
+							0));
+	gpio_init_callback(&gpio_cb, fifo_watermark_handler,
+			   BIT(DT_GPIO_PIN_BY_IDX(LIS2DH_NODE, irq_gpios, 0)));
+	gpio_add_callback(gpio_dev, &gpio_cb);
+	rc = gpio_pin_interrupt_configure(
+		gpio_dev, DT_GPIO_PIN_BY_IDX(LIS2DH_NODE, irq_gpios, 0),
+		GPIO_INT_EDGE_TO_ACTIVE);
+
+	if (rc != 0) {
+		LOG_ERR("Failed to configure FIFO interrupt: %d", rc);
+		return rc;
+	}
+
+	return fifo_configure(odr);
+}
+
+int Lis2dhFifoSetRate(uint16_t odr_hz)
+{
+	const struct lis2dh_odr *odr = find_odr(odr_hz);
+
+	if (odr == NULL) {
+		return -EINVAL;
+	}
+
+	/* The sensor is only accessed by the reader, so wake it to make the
+	 * change
+	 */
+	atomic_set(&pending_odr, (odr - odr_table) + 1);
+	k_sem_give(&fifo_watermark_sem);
+
+	return 0;
+}
+
+int Lis2dhFifoRead(int16_t samples[LIS2DH_FIFO_DEPTH][3],
+		   uint32_t timestamps_us[LIS2DH_FIFO_DEPTH],
+		   k_timeout_t timeout)
+{
+	k_spinlock_key_t key;
+	int64_t watermark_us;
+	bool overrun = false;
+	atomic_val_t odr_index;
+	uint8_t fifo_src;
+	uint8_t count = 0;
+	uint8_t i = 0;
+	int rc;
+
+	if (k_sem_take(&fifo_watermark_sem, timeout) != 0) {
+		return -EAGAIN;
+	}
+
+	/* Samples still in the FIFO at the old rate are discarded */
+	odr_index = atomic_set(&pending_odr, 0);
+	if (odr_index > 0) {
+		return fifo_configure(&odr_table[odr_index - 1]);
+	}
+
+	key = k_spin_lock(&watermark_lock);
+	watermark_us = k_ticks_to_us_floor64(watermark_ticks);
+	k_spin_unlock(&watermark_lock, key);
+
+	rc = i2c_reg_read_byte(i2c_dev, DT_REG_ADDR(LIS2DH_NODE),
+			       LIS2DH_REG_FIFO_SRC, &fifo_src);
+
+	if (rc == 0) {
+		count = fifo_src & LIS2DH_FIFO_SRC_FSS_MASK;
+
+		if (fifo_src & LIS2DH_FIFO_SRC_OVRN) {
+			/* FIFO is full and the oldest data has been lost */
+			++overruns;
+			overrun = true;
+			count = LIS2DH_FIFO_DEPTH;
+		}
+
+		if (count > 0) {
+			rc = i2c_burst_read(i2c_dev, DT_REG_ADDR(LIS2DH_NODE),
+					    LIS2DH_REG_OUT_X_L |
+						    LIS2DH_AUTOINCREMENT_ADDR,
+					    burst_buffer,
+					    count * LIS2DH_SAMPLE_SIZE);
+		}
+	}
+
+	/* The interrupt is edge triggered, if the watermark was reached again
+	 * whilst the FIFO was being read there will be no new edge so check
+	 * the line level and schedule another read
+	 */
+	if (gpio_pin_get(gpio_dev,
+			 DT_GPIO_PIN_BY_IDX(LIS2DH_NODE, irq_gpios, 0)) > 0) {
+		/* The crossing happened during the read, take now as the
+		 * closest estimate of its time
+		 */
+		key = k_spin_lock(&watermark_lock);
+		watermark_ticks = k_uptime_ticks();
+		k_spin_unlock(&watermark_lock, key);
+		k_sem_give(&fifo_watermark_sem);
+	}
+
+	if (rc != 0) {
+		return rc;
+	}
+
+	update_period(watermark_us, overrun);
+	previous_count = count;
+
+	/* The burst is in the sensor's output register layout */
+	AccelConvertRaw(&accel_convert, burst_buffer, samples, count);
+
+	while (i < count) {
+		/* Sample CONFIG_APP_FIFO_WATERMARK is the one which raised
+		 * the interrupt
+		 */
+		timestamps_us[i] = (uint32_t)(
+			watermark_us +
+			((((int64_t)i - CONFIG_APP_FIFO_WATERMARK) *
+			  period_q8) >>
+			 PERIOD_FRACTION_BITS));
+		++i;
+	}
+
+	return count;
+}
+
+uint32_t Lis2dhFifoGetOverruns(void)
+{
+	return overruns;
+}
+
+uint32_t Lis2dhFifoGetPeriodNs(void)
+{
+	return (uint32_t)(((uint64_t)period_q8 * NSEC_PER_USEC) >>
+			  PERIOD_FRACTION_BITS);
+}
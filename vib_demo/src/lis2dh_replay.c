@@ -0,0 +1,475 @@
+/**
+ * @file lis2dh_replay.c
+ * @brief LIS2DH I2C emulator replaying recorded traces on native_posix
+ *
+ * Sits behind the native_posix I2C emulation controller in place of the
+ * sensor, so the unmodified LIS2DH driver and the rest of the application
+ * run as they would on the DVK. Reads of the output registers return the
+ * trace sample due at the current (simulated) time, so the trace plays back
+ * at its own rate whatever rate the application samples at. Readings are
+ * quantised to the range and resolution the driver configured.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT st_lis2dh
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <string.h>
+#include <logging/log.h>
+#include <sys/byteorder.h>
+#include <drivers/emul.h>
+#include <drivers/i2c.h>
+#include <drivers/i2c_emul.h>
+
+/* Host file access, this file is only built for native_posix */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cmdline.h"
+#include "soc.h"
+
+#include "lis2dh_replay.h"
+
+LOG_MODULE_REGISTER(lis2dh_replay);
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define REG_WHO_AM_I 0x0F
+#define REG_CTRL1 0x20
+#define REG_CTRL4 0x23
+#define REG_STATUS 0x27
+#define REG_OUT_X_L 0x28
+#define REG_OUT_Z_H 0x2D
+#define REG_COUNT 0x40
+#define REG_AUTOINCREMENT BIT(7)
+
+#define WHO_AM_I_VALUE 0x33
+#define CTRL1_LPEN BIT(3)
+#define CTRL4_HR BIT(3)
+#define CTRL4_FS_SHIFT 4
+#define CTRL4_FS_MASK 0x03
+#define STATUS_ZYXDA BIT(3)
+
+#define FULL_SCALE_2G_MG 2000
+#define RAW_FULL_SCALE 32768
+#define RESOLUTION_LOW_POWER 8
+#define RESOLUTION_NORMAL 10
+#define RESOLUTION_HIGH 12
+
+#define AXIS_COUNT 3
+#define TRACE_SAMPLES CONFIG_APP_REPLAY_TRACE_MAX_SAMPLES
+#define READ_CHUNK 4096
+
+/* UART rate the replay benchmark reports the output limit for, that of the
+ * DVK console
+ */
+#define BENCHMARK_BAUD_DEFAULT 115200
+
+/* Built in trace used when no file is given, gravity on Z plus a tone of
+ * 1/16 of the replay rate on X
+ */
+#define BUILT_IN_GRAVITY_MG 1000
+#define BUILT_IN_TONE_STEPS 16
+
+struct lis2dh_replay_cfg {
+	uint16_t addr;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const int16_t built_in_tone[BUILT_IN_TONE_STEPS] = {
+	0, 191, 354, 462, 500, 462, 354, 191,
+	0, -191, -354, -462, -500, -462, -354, -191,
+};
+
+static int16_t replay_trace[TRACE_SAMPLES][AXIS_COUNT];
+
+/* Set from the command line */
+static char *replay_path;
+static uint32_t replay_rate_hz = CONFIG_APP_REPLAY_RATE_HZ;
+static uint32_t replay_benchmark_samples;
+static uint32_t replay_benchmark_baud = BENCHMARK_BAUD_DEFAULT;
+
+static struct i2c_emul replay_emul;
+static uint8_t replay_regs[REG_COUNT];
+static uint8_t replay_reg_addr;
+static bool replay_started;
+static int64_t replay_start_ticks;
+static uint32_t replay_last_index;
+static struct lis2dh_replay_stats replay_stats;
+static struct k_spinlock replay_stats_lock;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void replay_options(void);
+static void replay_built_in(void);
+static int replay_load(const char *path);
+static void replay_parse_csv(const char *data, size_t len, bool flush);
+static void replay_parse_binary(const uint8_t *data, size_t len);
+static int16_t replay_quantise(int16_t mg);
+static void replay_latch(void);
+static int replay_transfer(struct i2c_emul *emul, struct i2c_msg *msgs,
+			   int num_msgs, int addr);
+static int replay_init(const struct emul *emul, const struct device *parent);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void replay_options(void)
+{
+	static struct args_struct_t replay_args[] = {
+		{ .option = "replay-trace",
+		  .name = "path",
+		  .type = 's',
+		  .dest = (void *)&replay_path,
+		  .descript = "CSV (milli-g, X/Y/Z in the last three columns) "
+			      "or binary (int16 X/Y/Z milli-g) trace to replay "
+			      "as the LIS2DH, a built in tone is used if not set" },
+		{ .option = "replay-rate",
+		  .name = "hz",
+		  .type = 'u',
+		  .dest = (void *)&replay_rate_hz,
+		  .descript = "Rate the trace was recorded at" },
+		{ .option = "replay-samples",
+		  .name = "count",
+		  .type = 'u',
+		  .dest = (void *)&replay_benchmark_samples,
+		  .descript = "Report the replay benchmark and exit after this "
+			      "many samples have been read" },
+		{ .option = "replay-baud",
+		  .name = "baud",
+		  .type = 'u',
+		  .dest = (void *)&replay_benchmark_baud,
+		  .descript = "UART baud rate the replay benchmark reports the "
+			      "achievable sample rate for" },
+		ARG_TABLE_ENDMARKER
+	};
+
+	native_add_command_line_opts(replay_args);
+}
+
+static void replay_built_in(void)
+{
+	uint32_t i = 0;
+
+	while (i < BUILT_IN_TONE_STEPS) {
+		replay_trace[i][0] = built_in_tone[i];
+		replay_trace[i][1] = 0;
+		replay_trace[i][2] = BUILT_IN_GRAVITY_MG;
+		++i;
+	}
+
+	replay_stats.trace_samples = BUILT_IN_TONE_STEPS;
+}
+
+/** @brief Parses lines of CSV, taking the last three integer fields of each
+ *  line as X, Y and Z. Lines with fewer fields (e.g. headers) are skipped
+ *  and any fractional part of a value is discarded.
+ */
+static void replay_parse_csv(const char *data, size_t len, bool flush)
+{
+	static int32_t fields[AXIS_COUNT];
+	static uint8_t field_count;
+	static int32_t value;
+	static bool negative;
+	static bool in_value;
+	static bool in_fraction;
+	static bool bad_line;
+	size_t i = 0;
+	char c;
+
+	while (i < len || flush) {
+		c = (i < len) ? data[i] : '\n';
+
+		if (c >= '0' && c <= '9') {
+			if (!in_fraction) {
+				value = (value * 10) + (c - '0');
+				in_value = true;
+			}
+		} else if (c == '-' && !in_value) {
+			negative = true;
+		} else if (c == '.' && in_value) {
+			in_fraction = true;
+		} else if (c == ',' || c == ' ' || c == '\t' || c == '\r' ||
+			   c == '\n') {
+			if (in_value) {
+				/* Keep the latest three fields */
+				memmove(&fields[0], &fields[1],
+					sizeof(fields) - sizeof(fields[0]));
+				fields[AXIS_COUNT - 1] = negative ? -value :
+								    value;
+				field_count = MIN(field_count + 1, AXIS_COUNT);
+			}
+			value = 0;
+			negative = false;
+			in_value = false;
+			in_fraction = false;
+		} else {
+			bad_line = true;
+		}
+
+		if (c == '\n') {
+			if (!bad_line && field_count == AXIS_COUNT &&
+			    replay_stats.trace_samples < TRACE_SAMPLES) {
+				replay_trace[replay_stats.trace_samples][0] =
+					CLAMP(fields[0], INT16_MIN, INT16_MAX);
+				replay_trace[replay_stats.trace_samples][1] =
+					CLAMP(fields[1], INT16_MIN, INT16_MAX);
+				replay_trace[replay_stats.trace_samples][2] =
+					CLAMP(fields[2], INT16_MIN, INT16_MAX);
+				++replay_stats.trace_samples;
+			}
+			field_count = 0;
+			bad_line = false;
+		}
+
+		if (i >= len) {
+			break;
+		}
+		++i;
+	}
+}
+
+static void replay_parse_binary(const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	while ((i + (AXIS_COUNT * sizeof(int16_t))) <= len &&
+	       replay_stats.trace_samples < TRACE_SAMPLES) {
+		replay_trace[replay_stats.trace_samples][0] =
+			sys_get_le16(&data[i]);
+		replay_trace[replay_stats.trace_samples][1] =
+			sys_get_le16(&data[i + 2]);
+		replay_trace[replay_stats.trace_samples][2] =
+			sys_get_le16(&data[i + 4]);
+		++replay_stats.trace_samples;
+		i += AXIS_COUNT * sizeof(int16_t);
+	}
+}
+
+static int replay_load(const char *path)
+{
+	static uint8_t chunk[READ_CHUNK];
+	size_t path_len = strlen(path);
+	bool csv = (path_len > 4) && (strcmp(&path[path_len - 4], ".csv") == 0);
+	size_t carry = 0;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return -ENOENT;
+	}
+
+	while (1) {
+		len = read(fd, &chunk[carry], sizeof(chunk) - carry);
+		if (len <= 0) {
+			break;
+		}
+
+		if (csv) {
+			replay_parse_csv((const char *)chunk, len, false);
+		} else {
+			/* Keep any partial sample for the next chunk */
+			len += carry;
+			carry = len % (AXIS_COUNT * sizeof(int16_t));
+			replay_parse_binary(chunk, len - carry);
+			memmove(chunk, &chunk[len - carry], carry);
+		}
+	}
+
+	close(fd);
+
+	if (csv) {
+		replay_parse_csv(NULL, 0, true);
+	}
+
+	if (len < 0) {
+		return -EIO;
+	}
+
+	if (replay_stats.trace_samples >= TRACE_SAMPLES) {
+		LOG_WRN("Trace truncated to %u samples", TRACE_SAMPLES);
+	}
+
+	return (replay_stats.trace_samples > 0) ? 0 : -EINVAL;
+}
+
+/** @brief Converts milli-g to the left justified output register value for
+ *  the range and resolution configured in CTRL1 and CTRL4.
+ */
+static int16_t replay_quantise(int16_t mg)
+{
+	uint8_t fs = (replay_regs[REG_CTRL4] >> CTRL4_FS_SHIFT) & CTRL4_FS_MASK;
+	int32_t full_scale_mg = FULL_SCALE_2G_MG << fs;
+	uint8_t resolution = RESOLUTION_NORMAL;
+	int32_t raw;
+
+	if (replay_regs[REG_CTRL1] & CTRL1_LPEN) {
+		resolution = RESOLUTION_LOW_POWER;
+	} else if (replay_regs[REG_CTRL4] & CTRL4_HR) {
+		resolution = RESOLUTION_HIGH;
+	}
+
+	raw = ((int32_t)mg * RAW_FULL_SCALE) / full_scale_mg;
+	raw = CLAMP(raw, INT16_MIN, INT16_MAX);
+
+	/* Only the top bits of the register hold data */
+	return (int16_t)(raw & ~(int32_t)BIT_MASK(16 - resolution));
+}
+
+/** @brief Loads the trace sample due now into the output registers. */
+static void replay_latch(void)
+{
+	int64_t now = k_uptime_ticks();
+	uint64_t elapsed_us;
+	uint32_t index;
+	uint32_t position;
+	k_spinlock_key_t key;
+	uint8_t axis = 0;
+
+	if (!replay_started) {
+		replay_started = true;
+		replay_start_ticks = now;
+	}
+
+	elapsed_us = k_ticks_to_us_floor64(now - replay_start_ticks);
+	index = (uint32_t)((elapsed_us * replay_rate_hz) / USEC_PER_SEC);
+
+	key = k_spin_lock(&replay_stats_lock);
+	if (replay_stats.served > 0) {
+		if (index == replay_last_index) {
+			++replay_stats.repeated;
+		} else if (index > (replay_last_index + 1)) {
+			replay_stats.skipped += index - replay_last_index - 1;
+		}
+	}
+	++replay_stats.served;
+	replay_stats.elapsed_us = elapsed_us;
+	k_spin_unlock(&replay_stats_lock, key);
+
+	replay_last_index = index;
+	position = index % replay_stats.trace_samples;
+
+	while (axis < AXIS_COUNT) {
+		sys_put_le16(replay_quantise(replay_trace[position][axis]),
+			     &replay_regs[REG_OUT_X_L + (axis * sizeof(int16_t))]);
+		++axis;
+	}
+}
+
+static int replay_transfer(struct i2c_emul *emul, struct i2c_msg *msgs,
+			   int num_msgs, int addr)
+{
+	uint32_t i;
+
+	while (num_msgs > 0) {
+		if (msgs->flags & I2C_MSG_READ) {
+			/* A burst starting at or before the X output register
+			 * (the driver reads from STATUS) fetches a new sample
+			 */
+			if (replay_reg_addr <= REG_OUT_X_L &&
+			    (replay_reg_addr + msgs->len) > REG_OUT_X_L) {
+				replay_latch();
+			}
+
+			i = 0;
+			while (i < msgs->len) {
+				msgs->buf[i] = replay_regs[replay_reg_addr %
+							   REG_COUNT];
+				++replay_reg_addr;
+				++i;
+			}
+		} else if (msgs->len > 0) {
+			/* The first byte written selects the register, the
+			 * driver always sets the auto increment bit
+			 */
+			replay_reg_addr = msgs->buf[0] & ~REG_AUTOINCREMENT;
+
+			i = 1;
+			while (i < msgs->len) {
+				if (replay_reg_addr < REG_STATUS) {
+					replay_regs[replay_reg_addr] =
+						msgs->buf[i];
+				}
+				++replay_reg_addr;
+				++i;
+			}
+		}
+
+		++msgs;
+		--num_msgs;
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api replay_api = {
+	.transfer = replay_transfer,
+};
+
+static int replay_init(const struct emul *emul, const struct device *parent)
+{
+	const struct lis2dh_replay_cfg *cfg = emul->cfg;
+	int rc;
+
+	memset(replay_regs, 0, sizeof(replay_regs));
+	replay_regs[REG_WHO_AM_I] = WHO_AM_I_VALUE;
+	replay_regs[REG_STATUS] = STATUS_ZYXDA;
+
+	if (replay_rate_hz == 0) {
+		LOG_ERR("Replay rate must be at least 1 Hz");
+		return -EINVAL;
+	}
+
+	if (replay_path == NULL) {
+		replay_built_in();
+	} else {
+		rc = replay_load(replay_path);
+		if (rc != 0) {
+			LOG_ERR("Could not load trace %s (%d)", replay_path,
+				rc);
+			return rc;
+		}
+	}
+
+	replay_stats.rate_hz = replay_rate_hz;
+	replay_stats.benchmark_samples = replay_benchmark_samples;
+	replay_stats.benchmark_baud = replay_benchmark_baud;
+	LOG_INF("Replaying %u samples at %u Hz", replay_stats.trace_samples,
+		replay_rate_hz);
+
+	replay_emul.api = &replay_api;
+	replay_emul.addr = cfg->addr;
+
+	return i2c_emul_register(parent, emul->dev_label, &replay_emul);
+}
+
+NATIVE_TASK(replay_options, PRE_BOOT_1, 1);
+
+static const struct lis2dh_replay_cfg replay_cfg = {
+	.addr = DT_INST_REG_ADDR(0),
+};
+
+EMUL_DEFINE(replay_init, DT_DRV_INST(0), &replay_cfg);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void Lis2dhReplayGetStats(struct lis2dh_replay_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&replay_stats_lock);
+
+	*stats = replay_stats;
+	k_spin_unlock(&replay_stats_lock, key);
+}
@@ -21,22 +21,21 @@
 #include <zephyr.h>
 #include <logging/log.h>
 #include <drivers/sensor.h>
+#include <sys/atomic.h>
 
 #include "application.h"
-
-LOG_MODULE_REGISTER(logger);
-
-#if !defined(CONFIG_APP_AXIS_X_ENABLED) && !defined(CONFIG_APP_AXIS_Y_ENABLED) && !defined(CONFIG_APP_AXIS_Z_ENABLED)
-#error "At least one axis must be enabled in the project configuration"
-#endif
-
-#if defined(CONFIG_APP_AXIS_X_ENABLED) && defined(CONFIG_APP_AXIS_Y_ENABLED) && defined(CONFIG_APP_AXIS_Z_ENABLED)
-#define AXIS_COUNT 3
-#elif (defined(CONFIG_APP_AXIS_X_ENABLED) && defined(CONFIG_APP_AXIS_Y_ENABLED) && !defined(CONFIG_APP_AXIS_Z_ENABLED)) || (defined(CONFIG_APP_AXIS_X_ENABLED) && !defined(CONFIG_APP_AXIS_Y_ENABLED) && defined(CONFIG_APP_AXIS_Z_ENABLED)) || (!defined(CONFIG_APP_AXIS_X_ENABLED) && defined(CONFIG_APP_AXIS_Y_ENABLED) && defined(CONFIG_APP_AXIS_Z_ENABLED))
-#define AXIS_COUNT 2
+#include "output.h"
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+#include "lis2dh_fifo.h"
 #else
-#define AXIS_COUNT 1
+#include "sampler.h"
+#include "accel_convert.h"
 #endif
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+#include "flash_capture.h"
+#endif
+
+LOG_MODULE_REGISTER(logger);
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
@@ -46,16 +45,93 @@ LOG_MODULE_REGISTER(logger);
 #define ACCEL_ARRAY_Z 2
 #define ACCEL_ARRAY_SIZE 3
 
-const static int64_t sampling_freq = CONFIG_APP_SAMPLING_FREQUENCY_HZ;
-static int64_t time_between_samples_us = (1000000 / (sampling_freq - 1));
+/* Polled samples are converted to milli-g for the flash capture and, when
+ * calibrated, for the output. Otherwise the driver readings go to the output
+ * unchanged
+ */
+#if defined(CONFIG_APP_FLASH_CAPTURE) || defined(CONFIG_ACCEL_CALIBRATION)
+#define SAMPLE_HANDLER convert_sample
+#else
+#define SAMPLE_HANDLER OutputSample
+#endif
+
+static atomic_t sample_rate_hz = ATOMIC_INIT(CONFIG_APP_SAMPLING_FREQUENCY_HZ);
+
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+static struct accel_convert accel_convert;
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+static void acquire_fifo(void);
+#elif defined(CONFIG_APP_FLASH_CAPTURE) || defined(CONFIG_ACCEL_CALIBRATION)
+static void convert_sample(const struct sensor_value *accel,
+			   uint32_t timestamp_us);
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+static void acquire_fifo(void)
+{
+	int16_t samples[LIS2DH_FIFO_DEPTH][ACCEL_ARRAY_SIZE];
+	uint32_t timestamps_us[LIS2DH_FIFO_DEPTH];
+	int count;
+	int i;
+
+	if (Lis2dhFifoInit((uint16_t)atomic_get(&sample_rate_hz)) != 0) {
+		printf("Sensor FIFO setup error\n");
+		return;
+	}
+
+	while (1) {
+		/* Sleep until the FIFO watermark is reached, then drain the
+		 * FIFO in a single burst
+		 */
+		count = Lis2dhFifoRead(samples, timestamps_us, K_FOREVER);
+
+		if (count < 0) {
+			printf("Sensor FIFO read error\n");
+			return;
+		}
+
+		i = 0;
+		while (i < count) {
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+			FlashCaptureAdd(samples[i]);
+#endif
+			OutputSampleMg(samples[i], timestamps_us[i]);
+			++i;
+		}
+	}
+}
+#elif defined(CONFIG_APP_FLASH_CAPTURE) || defined(CONFIG_ACCEL_CALIBRATION)
+static void convert_sample(const struct sensor_value *accel,
+			   uint32_t timestamp_us)
+{
+	int16_t mg[1][ACCEL_ARRAY_SIZE];
+
+	AccelConvertValues(&accel_convert, accel, mg, 1);
+
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+	FlashCaptureAdd(mg[0]);
+#endif
+#if defined(CONFIG_ACCEL_CALIBRATION)
+	OutputSampleMg(mg[0], timestamp_us);
+#else
+	OutputSample(accel, timestamp_us);
+#endif
+}
+#endif
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
 void ApplicationStart(void)
 {
-	struct sensor_value accel[ACCEL_ARRAY_SIZE];
-
 	/* Find LIS3DH sensor */
 	const struct device *sensor =
 		device_get_binding(DT_LABEL(DT_INST(0, st_lis2dh)));
@@ -66,42 +142,68 @@ void ApplicationStart(void)
 		return;
 	}
 
-	while (1) {
-		/* Create and use a timer for outputting readings at a fixed frequency */
-		struct k_timer next_val_timer;
-		k_timer_init(&next_val_timer, NULL, NULL);
-		k_timer_start(&next_val_timer, K_USEC(time_between_samples_us), K_NO_WAIT);
-
-		/* Fetch the current data value from the sensor */
-		if (sensor_sample_fetch(sensor) < 0) {
-			printf("IIS2DLPC Sensor sample update error\n");
-			return;
-		}
-
-		sensor_channel_get(sensor, SENSOR_CHAN_ACCEL_XYZ, accel);
+	if (OutputInit() != 0) {
+		return;
+	}
 
-		/* Output channels which are selected by the user */
-		printf("%.3f"
-#if AXIS_COUNT > 1
-		       ",%.3f"
-#if AXIS_COUNT > 2
-		       ",%.3f"
-#endif
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+	if (FlashCaptureInit() != 0) {
+		printf("Flash capture setup error\n");
+		return;
+	}
 #endif
-		       "\r\n"
 
-#if defined(CONFIG_APP_AXIS_X_ENABLED)
-		       , sensor_value_to_double(&accel[ACCEL_ARRAY_X])
-#endif
-#if defined(CONFIG_APP_AXIS_Y_ENABLED)
-		       , sensor_value_to_double(&accel[ACCEL_ARRAY_Y])
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+	acquire_fifo();
+#else
+	struct accel_calibration calibration;
+
+	AccelCalibrationGetConfig(&calibration);
+	if (AccelConvertInit(&accel_convert, &calibration) != 0) {
+		printf("Invalid accelerometer calibration\n");
+		return;
+	}
+
+	/* Sensor reads and output now happen on the sampler thread */
+	if (SamplerStart(sensor, (uint32_t)atomic_get(&sample_rate_hz),
+			 SAMPLE_HANDLER) != 0) {
+		printf("Sampler start error\n");
+	}
 #endif
-#if defined(CONFIG_APP_AXIS_Z_ENABLED)
-		       , sensor_value_to_double(&accel[ACCEL_ARRAY_Z])
+}
+
+int ApplicationSetRate(uint32_t rate_hz)
+{
+	int rc;
+
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+	/* The FIFO has been reconfigured when this returns, so every sample
+	 * added to the output after it is at the new rate
+	 */
+	rc = (rate_hz > UINT16_MAX) ? -EINVAL :
+				      Lis2dhFifoSetRate((uint16_t)rate_hz);
+#else
+	/* The sampler thread is woken at the new rate and would preempt this
+	 * one, it must not add a sample until the output has marked where the
+	 * new rate starts
+	 */
+	k_sched_lock();
+	rc = SamplerSetRate(rate_hz);
 #endif
-		      );
 
-		/* Wait for next sample time to arrive */
-		while (k_timer_status_get(&next_val_timer) <= 0);
+	if (rc == 0) {
+		atomic_set(&sample_rate_hz, rate_hz);
+		OutputSetRate((uint16_t)rate_hz);
 	}
+
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+	k_sched_unlock();
+#endif
+
+	return rc;
+}
+
+uint32_t ApplicationGetRate(void)
+{
+	return (uint32_t)atomic_get(&sample_rate_hz);
 }
@@ -0,0 +1,923 @@
+/**
+ * @file output.c
+ * @brief Sample output formatting for vibration demo
+ *
+ * Copyright (c) 2021 Edge Impulse
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <stdbool.h>
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <errno.h>
+#include <zephyr.h>
+#include <logging/log.h>
+#include <drivers/sensor.h>
+#include <drivers/uart.h>
+
+#include "output.h"
+#include "sample_ring.h"
+#include "sample_format.h"
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+#include "frame.h"
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+#include "decimator.h"
+#endif
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_FEATURES)
+#include "vib_features.h"
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+#include "goertzel.h"
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+#include "inference.h"
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+#include "event_capture.h"
+#endif
+
+LOG_MODULE_REGISTER(output);
+
+#if !defined(CONFIG_APP_AXIS_X_ENABLED) && !defined(CONFIG_APP_AXIS_Y_ENABLED) && !defined(CONFIG_APP_AXIS_Z_ENABLED)
+#error "At least one axis must be enabled in the project configuration"
+#endif
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define ACCEL_ARRAY_X SAMPLE_AXIS_X
+#define ACCEL_ARRAY_Y SAMPLE_AXIS_Y
+#define ACCEL_ARRAY_Z SAMPLE_AXIS_Z
+#define ACCEL_ARRAY_SIZE SAMPLE_AXIS_COUNT
+
+#define OUTPUT_STACK_SIZE 2048
+#define OUTPUT_PRIORITY 7
+
+/* A suspend request is acknowledged by the output thread once it has sent
+ * any partly built frame, so the UART is free from then on. Sending the
+ * longest frame at the slowest supported baud rate takes well under this.
+ */
+#define OUTPUT_RUNNING 0
+#define OUTPUT_SUSPEND_REQUESTED 1
+#define OUTPUT_SUSPENDED 2
+#define OUTPUT_SUSPEND_TIMEOUT_MS 1000
+
+/* Start up settings from the project configuration */
+#define DEFAULT_AXIS_MASK                                                      \
+	((IS_ENABLED(CONFIG_APP_AXIS_X_ENABLED) ? OUTPUT_AXIS_X : 0) |         \
+	 (IS_ENABLED(CONFIG_APP_AXIS_Y_ENABLED) ? OUTPUT_AXIS_Y : 0) |         \
+	 (IS_ENABLED(CONFIG_APP_AXIS_Z_ENABLED) ? OUTPUT_AXIS_Z : 0))
+
+#if defined(CONFIG_APP_OUTPUT_FORMAT_COMPRESSED)
+#define DEFAULT_FORMAT OUTPUT_FORMAT_COMPRESSED
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_BINARY)
+#define DEFAULT_FORMAT OUTPUT_FORMAT_BINARY
+#else
+#define DEFAULT_FORMAT OUTPUT_FORMAT_CSV
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+#define DEFAULT_DECIMATION CONFIG_APP_OUTPUT_DECIMATION_RATIO
+BUILD_ASSERT(DEFAULT_DECIMATION <= DECIMATOR_RATIO_MAX,
+	     "Start up decimation ratio is above the maximum ratio");
+#else
+#define DEFAULT_DECIMATION 1
+#endif
+
+/* The runtime settings are packed into one word so that they can be
+ * changed atomically from the shell and picked up by the output thread
+ * between samples
+ */
+#define SETTINGS_RATE_MASK 0xFFFF
+#define SETTINGS_AXES_SHIFT 16
+#define SETTINGS_AXES_MASK (0xFF << SETTINGS_AXES_SHIFT)
+#define SETTINGS_FORMAT_SHIFT 24
+#define SETTINGS_FORMAT_MASK (0x0F << SETTINGS_FORMAT_SHIFT)
+/* Decimation ratio minus 1, so ratios 1 to 16 */
+#define SETTINGS_DECIMATION_SHIFT 28
+#define SETTINGS_DECIMATION_MASK (0x0FUL << SETTINGS_DECIMATION_SHIFT)
+#define SETTINGS(rate, axes, format, decimation)                               \
+	((rate) | ((axes) << SETTINGS_AXES_SHIFT) |                            \
+	 ((format) << SETTINGS_FORMAT_SHIFT) |                                 \
+	 (((decimation)-1UL) << SETTINGS_DECIMATION_SHIFT))
+#define SETTINGS_RATE(settings) ((settings)&SETTINGS_RATE_MASK)
+#define SETTINGS_AXES(settings)                                                \
+	(((settings)&SETTINGS_AXES_MASK) >> SETTINGS_AXES_SHIFT)
+#define SETTINGS_FORMAT(settings)                                              \
+	(((settings)&SETTINGS_FORMAT_MASK) >> SETTINGS_FORMAT_SHIFT)
+#define SETTINGS_DECIMATION(settings)                                          \
+	((((settings)&SETTINGS_DECIMATION_MASK) >> SETTINGS_DECIMATION_SHIFT) + \
+	 1)
+
+#define FRAME_TIMESTAMP_FLAG                                                   \
+	(IS_ENABLED(CONFIG_APP_OUTPUT_TIMESTAMPS) ? FRAME_FLAG_TIMESTAMPS : 0)
+
+/* 8 data bits plus start and stop bits */
+#define UART_BITS_PER_BYTE 10
+#define UART_BAUD DT_PROP(DT_CHOSEN(zephyr_console), current_speed)
+
+/* Optional timestamp (up to 10 digits) and comma separated values for every
+ * axis followed by "\r\n"
+ */
+#define CSV_TIMESTAMP_MAX_LENGTH 11
+#define CSV_LINE_MAX_LENGTH                                                    \
+	(CSV_TIMESTAMP_MAX_LENGTH +                                            \
+	 (ACCEL_ARRAY_SIZE * (SAMPLE_FORMAT_VALUE_MAX_LENGTH + 1)) + 2)
+
+/* Longest value the LIS2DH produces ("-156.906" at +/-16 g), for estimating
+ * the CSV bandwidth
+ */
+#define CSV_SENSOR_VALUE_MAX_LENGTH 8
+
+/* Window number, axis, 5 features and the spectrum bands, each up to 10
+ * characters with a separator, followed by "\r\n"
+ */
+#define FEATURE_LINE_MAX_LENGTH                                                \
+	(((7 + CONFIG_APP_FEATURE_SPECTRUM_BANDS) * 11) + 2)
+#define FEATURE_AXIS_NAMES "XYZ"
+
+/* Block number, axis and the bin magnitudes, each up to 10 characters with
+ * a separator, followed by "\r\n"
+ */
+#define GOERTZEL_LINE_MAX_LENGTH (((2 + GOERTZEL_BINS_MAX) * 11) + 2)
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static const struct device *uart_dev;
+static struct frame_encoder encoder;
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static struct decimator decimator;
+/* Filter group delay, subtracted from the timestamps of decimated samples */
+static uint32_t decimation_delay_us;
+#endif
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_FEATURES)
+static uint32_t feature_window;
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+static uint32_t goertzel_block;
+#endif
+
+static atomic_t output_suspended;
+static bool output_running;
+/* Output thread owned, see struct output_stats */
+static uint32_t output_underruns;
+static uint32_t output_bytes;
+static atomic_t output_settings =
+	ATOMIC_INIT(SETTINGS(CONFIG_APP_SAMPLING_FREQUENCY_HZ, DEFAULT_AXIS_MASK,
+			     DEFAULT_FORMAT, DEFAULT_DECIMATION));
+
+/* Samples already in the ring when the rate changes were taken at the old
+ * rate, the count of samples added to the ring at the change marks the
+ * first sample at the new rate
+ */
+static atomic_t output_rate_boundary;
+
+SAMPLE_RING_DEFINE(output_ring, struct accel_sample,
+		   CONFIG_APP_OUTPUT_RING_SAMPLES);
+K_SEM_DEFINE(output_ring_sem, 0, 1);
+K_SEM_DEFINE(output_suspend_sem, 0, 1);
+K_SEM_DEFINE(output_print_sem, 1, 1);
+
+/* The inference and event formats output from their own threads */
+#if !defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE) && !defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+K_THREAD_STACK_DEFINE(output_stack_area, OUTPUT_STACK_SIZE);
+static struct k_thread output_thread_data;
+
+/* Output thread owned, the settings in use and the indexes of the axes they
+ * select so that per sample loops only visit the enabled axes
+ */
+static uint32_t active_settings;
+static uint8_t active_axes[ACCEL_ARRAY_SIZE];
+static uint8_t active_axis_count;
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+#if !defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE) && !defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+static void output_thread(void *unused1, void *unused2, void *unused3);
+static bool output_suspend_check(void);
+static void output_write(const struct accel_sample *sample);
+static bool output_settings_due(uint32_t settings);
+static void output_apply_settings(uint32_t settings);
+#endif
+static void output_settings_update(uint32_t mask, uint32_t value);
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static void output_flush(void);
+static void uart_write(const uint8_t *data, size_t length);
+static void frame_write(const struct sensor_value *accel,
+			uint32_t timestamp_us);
+static void frame_add(const int16_t *mg, uint32_t timestamp_us);
+static void csv_write(const struct sensor_value *accel,
+		      uint32_t timestamp_us);
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static void decimated_write(const struct accel_sample *sample);
+#endif
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_FEATURES)
+static void features_write(uint8_t axis, const struct axis_features *features);
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+static void goertzel_write(uint8_t axis, const uint16_t *magnitudes,
+			   uint32_t alarms);
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+#if !defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE) && !defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+static void output_thread(void *unused1, void *unused2, void *unused3)
+{
+	struct accel_sample sample;
+	uint32_t settings;
+
+	while (1) {
+		k_sem_take(&output_ring_sem, K_FOREVER);
+
+		/* A suspend request wakes the thread whether or not there
+		 * are samples, so it is acknowledged promptly
+		 */
+		output_suspend_check();
+
+		/* The semaphore only counts to one, so samples added whilst
+		 * the ring was being drained leave it given with the ring
+		 * already empty, which is normal
+		 */
+		if (!SampleRingGet(&output_ring, &sample)) {
+			continue;
+		}
+
+		/* Drain everything available, the producer keeps adding
+		 * samples whilst the UART is busy
+		 */
+		do {
+			/* Settings changes take effect between samples */
+			settings = (uint32_t)atomic_get(&output_settings);
+			if (settings != active_settings &&
+			    output_settings_due(settings)) {
+				output_apply_settings(settings);
+			}
+
+			if (!output_suspend_check()) {
+				output_write(&sample);
+			}
+		} while (SampleRingGet(&output_ring, &sample));
+
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+		/* The frame is finished when the sensor supplies the rest of
+		 * its samples, meanwhile the UART is idle
+		 */
+		if (encoder.samples > 0) {
+			++output_underruns;
+		}
+#endif
+	}
+}
+
+/** @brief Acknowledges a suspend request, after sending any partly built
+ *  frame so that the host sees whole frames. Called on the output thread
+ *  between samples, returns true whilst output is suspended.
+ */
+static bool output_suspend_check(void)
+{
+	atomic_val_t state = atomic_get(&output_suspended);
+
+	if (state == OUTPUT_SUSPEND_REQUESTED) {
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+		output_flush();
+#endif
+		if (atomic_cas(&output_suspended, OUTPUT_SUSPEND_REQUESTED,
+			       OUTPUT_SUSPENDED)) {
+			k_sem_give(&output_suspend_sem);
+		}
+	}
+
+	return (state != OUTPUT_RUNNING);
+}
+
+static void output_write(const struct accel_sample *sample)
+{
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+	/* Without decimation samples are written exactly as read, CSV values
+	 * keep the driver's resolution rather than being rounded to milli-g
+	 */
+	if (decimator.ratio > 1) {
+		decimated_write(sample);
+		return;
+	}
+#endif
+
+	if (SETTINGS_FORMAT(active_settings) == OUTPUT_FORMAT_CSV) {
+		csv_write(sample->axis, sample->timestamp_us);
+	} else {
+		frame_write(sample->axis, sample->timestamp_us);
+	}
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_FEATURES)
+	struct axis_features features;
+	int16_t mg[ACCEL_ARRAY_SIZE];
+	uint8_t i = 0;
+
+	mg[ACCEL_ARRAY_X] = SensorValueToMg(&sample->axis[ACCEL_ARRAY_X]);
+	mg[ACCEL_ARRAY_Y] = SensorValueToMg(&sample->axis[ACCEL_ARRAY_Y]);
+	mg[ACCEL_ARRAY_Z] = SensorValueToMg(&sample->axis[ACCEL_ARRAY_Z]);
+
+	if (!FeaturesAdd(mg)) {
+		return;
+	}
+
+	/* Only the features of each completed window are output */
+	while (i < active_axis_count) {
+		FeaturesCompute(active_axes[i], &features);
+		features_write(active_axes[i], &features);
+		++i;
+	}
+	++feature_window;
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+	uint16_t magnitudes[GOERTZEL_BINS_MAX];
+	int16_t mg[ACCEL_ARRAY_SIZE];
+	uint32_t alarms;
+	uint8_t i = 0;
+
+	/* Only the enabled axes are converted and filtered */
+	while (i < active_axis_count) {
+		mg[active_axes[i]] =
+			SensorValueToMg(&sample->axis[active_axes[i]]);
+		++i;
+	}
+
+	if (!GoertzelAdd(mg, active_axes, active_axis_count)) {
+		return;
+	}
+
+	for (i = 0; i < active_axis_count; ++i) {
+		alarms = GoertzelCompute(active_axes[i], magnitudes);
+		goertzel_write(active_axes[i], magnitudes, alarms);
+	}
+	++goertzel_block;
+#endif
+}
+
+/** @brief Checks whether new settings can be applied to the sample just
+ *  taken from the ring. Settings with a new rate wait until the samples
+ *  taken at the old rate have been output, other changes take effect
+ *  straight away.
+ */
+static bool output_settings_due(uint32_t settings)
+{
+	uint32_t boundary;
+
+	if (SETTINGS_RATE(settings) == SETTINGS_RATE(active_settings)) {
+		return true;
+	}
+
+	/* The sample just taken is one before the count taken */
+	boundary = (uint32_t)atomic_get(&output_rate_boundary);
+
+	return ((int32_t)(SampleRingTaken(&output_ring) - 1 - boundary) >= 0);
+}
+
+/** @brief Switches to new runtime settings, called on the output thread. */
+static void output_apply_settings(uint32_t settings)
+{
+	uint8_t axis_mask = SETTINGS_AXES(settings);
+	uint8_t i = 0;
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+	uint8_t ratio = SETTINGS_DECIMATION(settings);
+	uint8_t flags = FRAME_TIMESTAMP_FLAG;
+
+	if (SETTINGS_FORMAT(settings) == OUTPUT_FORMAT_COMPRESSED) {
+		flags |= FRAME_FLAG_COMPRESSED;
+	}
+
+	/* Send any partly built frame with the settings it was started with,
+	 * the frame numbering carries on so the host does not see a gap. A
+	 * suspended output has already sent it and must not use the UART
+	 */
+	if (atomic_get(&output_suspended) != OUTPUT_SUSPENDED) {
+		output_flush();
+	}
+	FrameEncoderConfigure(&encoder, SETTINGS_RATE(settings) / ratio,
+			      axis_mask | flags);
+
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+	/* A new rate or axes restarts the filter, so that no output mixes
+	 * samples from before and after the change
+	 */
+	if (ratio != decimator.ratio) {
+		DecimatorInit(&decimator, ratio);
+	} else if ((settings ^ active_settings) &
+		   (SETTINGS_RATE_MASK | SETTINGS_AXES_MASK)) {
+		DecimatorReset(&decimator);
+	}
+
+	decimation_delay_us = (DecimatorGetDelayX2(&decimator) * USEC_PER_SEC) /
+			      (2 * SETTINGS_RATE(settings));
+#endif
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+	/* The bins are retuned for a new rate, and a block is restarted when
+	 * the axes change so every axis in it covers the same samples
+	 */
+	if (SETTINGS_RATE(settings) != SETTINGS_RATE(active_settings)) {
+		if (GoertzelSetRate(SETTINGS_RATE(settings)) !=
+		    GoertzelGetBins(NULL)) {
+			LOG_WRN("Some Goertzel bins cannot be measured at %u Hz",
+				SETTINGS_RATE(settings));
+		}
+	} else {
+		GoertzelReset();
+	}
+#endif
+
+	active_axis_count = 0;
+	while (i < ACCEL_ARRAY_SIZE) {
+		if (axis_mask & BIT(i)) {
+			active_axes[active_axis_count] = i;
+			++active_axis_count;
+		}
+		++i;
+	}
+
+	active_settings = settings;
+}
+#endif
+
+static void output_settings_update(uint32_t mask, uint32_t value)
+{
+	atomic_val_t old;
+
+	do {
+		old = atomic_get(&output_settings);
+	} while (!atomic_cas(&output_settings, old, (old & ~mask) | value));
+}
+
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static void output_flush(void)
+{
+	size_t length;
+	const uint8_t *frame = FrameEncoderFinish(&encoder, &length);
+
+	uart_write(frame, length);
+}
+
+static void uart_write(const uint8_t *data, size_t length)
+{
+	/* Frames are written directly to the UART as the console would
+	 * insert carriage returns before any 0x0a bytes
+	 */
+	output_bytes += length;
+	while (length > 0) {
+		uart_poll_out(uart_dev, *data);
+		++data;
+		--length;
+	}
+}
+
+static void frame_write(const struct sensor_value *accel,
+			uint32_t timestamp_us)
+{
+	/* Axes not in the mask are ignored by the encoder, so are left
+	 * unconverted
+	 */
+	int16_t mg[ACCEL_ARRAY_SIZE];
+	uint8_t i = 0;
+
+	while (i < active_axis_count) {
+		mg[active_axes[i]] = SensorValueToMg(&accel[active_axes[i]]);
+		++i;
+	}
+
+	frame_add(mg, timestamp_us);
+}
+
+static void frame_add(const int16_t *mg, uint32_t timestamp_us)
+{
+	if (FrameEncoderAdd(&encoder, mg, timestamp_us)) {
+		output_flush();
+	}
+}
+
+static void csv_write(const struct sensor_value *accel, uint32_t timestamp_us)
+{
+	char line[CSV_LINE_MAX_LENGTH + 1];
+	size_t length = 0;
+	uint8_t i = 0;
+
+	if (IS_ENABLED(CONFIG_APP_OUTPUT_TIMESTAMPS)) {
+		length = snprintf(line, sizeof(line), "%u", timestamp_us);
+	}
+
+	/* Output channels which are selected by the user, formatted exactly
+	 * as printf("%.3f") would but without floating point printf
+	 */
+	while (i < active_axis_count) {
+		if (length > 0) {
+			line[length++] = ',';
+		}
+		length += FormatSensorValue(&line[length],
+					    &accel[active_axes[i]]);
+		++i;
+	}
+
+	line[length++] = '\r';
+	line[length++] = '\n';
+	line[length] = '\0';
+
+	fputs(line, stdout);
+	output_bytes += length;
+}
+
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static void decimated_write(const struct accel_sample *sample)
+{
+	struct sensor_value accel[ACCEL_ARRAY_SIZE];
+	int16_t mg[ACCEL_ARRAY_SIZE];
+	int16_t filtered[ACCEL_ARRAY_SIZE];
+	uint32_t timestamp_us;
+	uint8_t i = 0;
+
+	while (i < active_axis_count) {
+		mg[active_axes[i]] =
+			SensorValueToMg(&sample->axis[active_axes[i]]);
+		++i;
+	}
+
+	if (!DecimatorAdd(&decimator, mg, active_axes, active_axis_count,
+			  filtered)) {
+		return;
+	}
+
+	/* Each output is centred on an input sample the group delay earlier
+	 * than the newest one
+	 */
+	timestamp_us = sample->timestamp_us - decimation_delay_us;
+
+	if (SETTINGS_FORMAT(active_settings) != OUTPUT_FORMAT_CSV) {
+		frame_add(filtered, timestamp_us);
+		return;
+	}
+
+	for (i = 0; i < active_axis_count; ++i) {
+		MgToSensorValue(filtered[active_axes[i]],
+				&accel[active_axes[i]]);
+	}
+	csv_write(accel, timestamp_us);
+}
+#endif
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_FEATURES)
+static void features_write(uint8_t axis, const struct axis_features *features)
+{
+	static char line[FEATURE_LINE_MAX_LENGTH + 1];
+	size_t length;
+	uint8_t i = 0;
+
+	length = snprintf(line, sizeof(line), "%u,%c,%u,%u,%u,%u.%02u,%u.%02u",
+			  feature_window, FEATURE_AXIS_NAMES[axis],
+			  features->rms_mg, features->peak_mg,
+			  features->peak_to_peak_mg, features->crest_x100 / 100,
+			  features->crest_x100 % 100,
+			  features->kurtosis_x100 / 100,
+			  features->kurtosis_x100 % 100);
+
+	while (i < CONFIG_APP_FEATURE_SPECTRUM_BANDS) {
+		length += snprintf(&line[length], sizeof(line) - length, ",%u",
+				   features->bands[i]);
+		++i;
+	}
+
+	line[length++] = '\r';
+	line[length++] = '\n';
+	line[length] = '\0';
+
+	fputs(line, stdout);
+}
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+static void goertzel_write(uint8_t axis, const uint16_t *magnitudes,
+			   uint32_t alarms)
+{
+	static char line[GOERTZEL_LINE_MAX_LENGTH + 1];
+	struct goertzel_bin bins[GOERTZEL_BINS_MAX];
+	uint8_t bin_count = GoertzelGetBins(NULL);
+	size_t length;
+	uint8_t i = 0;
+
+	length = snprintf(line, sizeof(line), "%u,%c", goertzel_block,
+			  FEATURE_AXIS_NAMES[axis]);
+
+	while (i < bin_count) {
+		length += snprintf(&line[length], sizeof(line) - length, ",%u",
+				   magnitudes[i]);
+		++i;
+	}
+
+	line[length++] = '\r';
+	line[length++] = '\n';
+	line[length] = '\0';
+
+	fputs(line, stdout);
+
+	if (alarms == 0) {
+		return;
+	}
+
+	/* A separate line for each bin over its threshold */
+	GoertzelGetBins(bins);
+	for (i = 0; i < bin_count; ++i) {
+		if (alarms & BIT(i)) {
+			printf("alarm,%u,%c,%u.%u,%u,%u\r\n", goertzel_block,
+			       FEATURE_AXIS_NAMES[axis],
+			       bins[i].frequency_dhz / 10,
+			       bins[i].frequency_dhz % 10, magnitudes[i],
+			       bins[i].threshold_mg);
+		}
+	}
+}
+#endif
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int OutputInit(void)
+{
+	int rc = 0;
+
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+	/* Samples go straight from acquisition into the inference windows,
+	 * the inference thread takes the place of the output thread
+	 */
+	rc = InferenceInit();
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+	/* As above, the event thread outputs captured events */
+	rc = EventCaptureInit();
+#else
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+	uart_dev = device_get_binding(DT_LABEL(DT_CHOSEN(zephyr_console)));
+
+	if (uart_dev == NULL) {
+		LOG_ERR("Could not get %s device",
+			DT_LABEL(DT_CHOSEN(zephyr_console)));
+		return -ENODEV;
+	}
+
+	FrameEncoderInit(&encoder, CONFIG_APP_SAMPLING_FREQUENCY_HZ,
+			 DEFAULT_AXIS_MASK);
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_FEATURES)
+	rc = FeaturesInit();
+
+	if (rc != 0) {
+		LOG_ERR("Could not initialise feature extraction (%d)", rc);
+		return rc;
+	}
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+	/* Returns the number of bins which can be measured at the rate */
+	rc = GoertzelInit(CONFIG_APP_SAMPLING_FREQUENCY_HZ);
+
+	if (rc < 0) {
+		LOG_ERR("Invalid Goertzel bin configuration (%d)", rc);
+		return rc;
+	} else if (rc != GoertzelGetBins(NULL)) {
+		LOG_WRN("Some Goertzel bins cannot be measured at %u Hz",
+			CONFIG_APP_SAMPLING_FREQUENCY_HZ);
+	}
+	rc = 0;
+#endif
+
+	output_apply_settings((uint32_t)atomic_get(&output_settings));
+
+	k_thread_create(&output_thread_data, output_stack_area,
+			K_THREAD_STACK_SIZEOF(output_stack_area),
+			output_thread, NULL, NULL, NULL, OUTPUT_PRIORITY, 0,
+			K_NO_WAIT);
+	k_thread_name_set(&output_thread_data, "output");
+	output_running = true;
+#endif
+
+	return rc;
+}
+
+void OutputSample(const struct sensor_value *accel, uint32_t timestamp_us)
+{
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+	int16_t mg[ACCEL_ARRAY_SIZE];
+
+	ARG_UNUSED(timestamp_us);
+
+	mg[ACCEL_ARRAY_X] = SensorValueToMg(&accel[ACCEL_ARRAY_X]);
+	mg[ACCEL_ARRAY_Y] = SensorValueToMg(&accel[ACCEL_ARRAY_Y]);
+	mg[ACCEL_ARRAY_Z] = SensorValueToMg(&accel[ACCEL_ARRAY_Z]);
+
+	InferenceAdd(mg);
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+	int16_t mg[ACCEL_ARRAY_SIZE];
+
+	mg[ACCEL_ARRAY_X] = SensorValueToMg(&accel[ACCEL_ARRAY_X]);
+	mg[ACCEL_ARRAY_Y] = SensorValueToMg(&accel[ACCEL_ARRAY_Y]);
+	mg[ACCEL_ARRAY_Z] = SensorValueToMg(&accel[ACCEL_ARRAY_Z]);
+
+	EventCaptureAdd(mg, timestamp_us);
+#else
+	struct accel_sample sample;
+
+	sample.axis[ACCEL_ARRAY_X] = accel[ACCEL_ARRAY_X];
+	sample.axis[ACCEL_ARRAY_Y] = accel[ACCEL_ARRAY_Y];
+	sample.axis[ACCEL_ARRAY_Z] = accel[ACCEL_ARRAY_Z];
+	sample.timestamp_us = timestamp_us;
+
+	/* A full ring is counted as an overrun and the sample is dropped */
+	if (SampleRingPut(&output_ring, &sample)) {
+		k_sem_give(&output_ring_sem);
+	}
+#endif
+}
+
+void OutputSampleMg(const int16_t *mg, uint32_t timestamp_us)
+{
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+	ARG_UNUSED(timestamp_us);
+
+	InferenceAdd(mg);
+#elif defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+	EventCaptureAdd(mg, timestamp_us);
+#else
+	struct sensor_value accel[ACCEL_ARRAY_SIZE];
+
+	MgToSensorValue(mg[ACCEL_ARRAY_X], &accel[ACCEL_ARRAY_X]);
+	MgToSensorValue(mg[ACCEL_ARRAY_Y], &accel[ACCEL_ARRAY_Y]);
+	MgToSensorValue(mg[ACCEL_ARRAY_Z], &accel[ACCEL_ARRAY_Z]);
+
+	OutputSample(accel, timestamp_us);
+#endif
+}
+
+int OutputSuspend(bool suspend)
+{
+	if (!suspend) {
+		/* The print lock is only held after a successful suspend
+		 * without an output thread
+		 */
+		if (atomic_set(&output_suspended, OUTPUT_RUNNING) ==
+			    OUTPUT_SUSPENDED &&
+		    !output_running) {
+			k_sem_give(&output_print_sem);
+		}
+		return 0;
+	}
+
+	k_sem_reset(&output_suspend_sem);
+	atomic_set(&output_suspended, OUTPUT_SUSPEND_REQUESTED);
+
+	/* Without an output thread, the inference and event threads (or
+	 * nothing, before start up) write to the UART and hold the print lock
+	 * whilst they do
+	 */
+	if (!output_running) {
+		if (k_sem_take(&output_print_sem,
+			       K_MSEC(OUTPUT_SUSPEND_TIMEOUT_MS)) != 0) {
+			return -EAGAIN;
+		}
+		atomic_set(&output_suspended, OUTPUT_SUSPENDED);
+		return 0;
+	}
+
+	k_sem_give(&output_ring_sem);
+
+	if (k_sem_take(&output_suspend_sem,
+		       K_MSEC(OUTPUT_SUSPEND_TIMEOUT_MS)) != 0) {
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+void OutputLock(void)
+{
+	k_sem_take(&output_print_sem, K_FOREVER);
+}
+
+void OutputUnlock(void)
+{
+	k_sem_give(&output_print_sem);
+}
+
+int OutputSetAxisMask(uint8_t axis_mask)
+{
+	if (axis_mask == 0 || (axis_mask & ~OUTPUT_AXIS_ALL) != 0) {
+		return -EINVAL;
+	}
+
+	output_settings_update(SETTINGS_AXES_MASK,
+			     axis_mask << SETTINGS_AXES_SHIFT);
+
+	return 0;
+}
+
+uint8_t OutputGetAxisMask(void)
+{
+	return SETTINGS_AXES((uint32_t)atomic_get(&output_settings));
+}
+
+int OutputSetFormat(enum output_format format)
+{
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+	if (format >= OUTPUT_FORMAT_COUNT) {
+		return -EINVAL;
+	}
+
+	output_settings_update(SETTINGS_FORMAT_MASK,
+			     (uint32_t)format << SETTINGS_FORMAT_SHIFT);
+
+	return 0;
+#else
+	ARG_UNUSED(format);
+
+	return -ENOTSUP;
+#endif
+}
+
+enum output_format OutputGetFormat(void)
+{
+	return SETTINGS_FORMAT((uint32_t)atomic_get(&output_settings));
+}
+
+int OutputSetDecimation(uint8_t ratio)
+{
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+	if (ratio == 0 || ratio > DECIMATOR_RATIO_MAX) {
+		return -EINVAL;
+	}
+
+	output_settings_update(SETTINGS_DECIMATION_MASK,
+			     (ratio - 1UL) << SETTINGS_DECIMATION_SHIFT);
+
+	return 0;
+#else
+	ARG_UNUSED(ratio);
+
+	return -ENOTSUP;
+#endif
+}
+
+uint8_t OutputGetDecimation(void)
+{
+	return SETTINGS_DECIMATION((uint32_t)atomic_get(&output_settings));
+}
+
+void OutputSetRate(uint16_t rate_hz)
+{
+	/* Marked before the settings change, so the output thread never sees
+	 * the new rate with an old boundary
+	 */
+	atomic_set(&output_rate_boundary, SampleRingAdded(&output_ring));
+	output_settings_update(SETTINGS_RATE_MASK, rate_hz);
+}
+
+uint32_t OutputGetMaxRate(void)
+{
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+	uint32_t settings = (uint32_t)atomic_get(&output_settings);
+	uint32_t axes = __builtin_popcount(SETTINGS_AXES(settings));
+	uint32_t bytes_per_second = UART_BAUD / UART_BITS_PER_BYTE;
+	uint32_t ratio = SETTINGS_DECIMATION(settings);
+	uint32_t sample_bytes;
+	uint32_t frame_bytes;
+
+	if (SETTINGS_FORMAT(settings) == OUTPUT_FORMAT_CSV) {
+		/* Comma separated values followed by "\r\n" */
+		sample_bytes = (axes * (CSV_SENSOR_VALUE_MAX_LENGTH + 1)) + 1;
+		if (IS_ENABLED(CONFIG_APP_OUTPUT_TIMESTAMPS)) {
+			sample_bytes += CSV_TIMESTAMP_MAX_LENGTH;
+		}
+
+		return (bytes_per_second / sample_bytes) * ratio;
+	}
+
+	sample_bytes = axes * sizeof(int16_t);
+	if (IS_ENABLED(CONFIG_APP_OUTPUT_TIMESTAMPS)) {
+		sample_bytes += sizeof(uint32_t);
+	}
+
+	frame_bytes = FRAME_HEADER_SIZE + FRAME_CRC_SIZE +
+		      (sample_bytes * CONFIG_APP_BINARY_FRAME_SAMPLES);
+	if (SETTINGS_FORMAT(settings) == OUTPUT_FORMAT_COMPRESSED) {
+		frame_bytes += FRAME_LENGTH_SIZE;
+	}
+
+	return (uint32_t)(((uint64_t)bytes_per_second *
+			   CONFIG_APP_BINARY_FRAME_SAMPLES * ratio) /
+			  frame_bytes);
+#else
+	return 0;
+#endif
+}
+
+void OutputGetStats(struct output_stats *stats)
+{
+	stats->size = SampleRingSize(&output_ring);
+	stats->used = SampleRingUsed(&output_ring);
+	stats->high_water = output_ring.high_water;
+	stats->overruns = output_ring.overruns;
+	stats->underruns = output_underruns;
+	stats->bytes = output_bytes;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file replay_bench.c
+ * @brief Trace replay benchmark for vibration demo on native_posix
+ *
+ * Runs the application against the LIS2DH replay emulator for the number of
+ * samples given with --replay-samples, then reports how many samples per
+ * second of host wall clock time were processed, the trace samples skipped
+ * and output overruns, the host CPU time used per sample and the output
+ * bytes per sample, and exits. Simulated time always advances at the sample
+ * rate and the board configuration does not hold it to real time, so host
+ * time shows how fast the sample path runs. Host times are only comparable
+ * between runs on the same host, they are intended for catching
+ * regressions rather than predicting DVK load. The output bytes per sample
+ * do carry over to the DVK, and give the sample rate the output format can
+ * sustain at the UART baud rate given with --replay-baud.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <init.h>
+#include <stdio.h>
+
+/* Host CPU and wall clock time, this file is only built for native_posix */
+#include <sys/resource.h>
+#include <time.h>
+
+#include "posix_board_if.h"
+
+#include "lis2dh_replay.h"
+#include "output.h"
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+#include "sampler.h"
+#endif
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define REPLAY_BENCH_STACK_SIZE 1024
+#define REPLAY_BENCH_PRIORITY 14
+#define REPLAY_BENCH_POLL_MS 100
+#define MILLI_UNITS 1000
+
+/* 8 data bits plus start and stop bits */
+#define UART_BITS_PER_BYTE 10
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+K_THREAD_STACK_DEFINE(replay_bench_stack_area, REPLAY_BENCH_STACK_SIZE);
+static struct k_thread replay_bench_thread_data;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static uint64_t replay_bench_cpu_us(void);
+static uint64_t replay_bench_wall_us(void);
+static void replay_bench_report(const struct lis2dh_replay_stats *start,
+				const struct lis2dh_replay_stats *end,
+				const struct output_stats *start_output,
+				uint64_t cpu_us, uint64_t wall_us);
+static void replay_bench_thread(void *unused1, void *unused2, void *unused3);
+static int replay_bench_init(const struct device *dev);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Gets the user and system CPU time used by the host process. */
+static uint64_t replay_bench_cpu_us(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	return ((uint64_t)usage.ru_utime.tv_sec * USEC_PER_SEC) +
+	       usage.ru_utime.tv_usec +
+	       ((uint64_t)usage.ru_stime.tv_sec * USEC_PER_SEC) +
+	       usage.ru_stime.tv_usec;
+}
+
+/** @brief Gets the host monotonic clock, which unlike simulated time shows
+ *  how long the samples took to process.
+ */
+static uint64_t replay_bench_wall_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * USEC_PER_SEC) +
+	       (now.tv_nsec / NSEC_PER_USEC);
+}
+
+/** @brief Reports the host throughput and the output bytes per sample, and
+ *  from those the sample rate the output could sustain at the UART rate.
+ */
+static void replay_bench_report(const struct lis2dh_replay_stats *start,
+				const struct lis2dh_replay_stats *end,
+				const struct output_stats *start_output,
+				uint64_t cpu_us, uint64_t wall_us)
+{
+	struct output_stats output;
+	uint32_t samples = end->served - start->served;
+	uint32_t late = 0;
+	uint32_t bytes;
+	uint64_t throughput = 0;
+	uint64_t cpu_ns = 0;
+	uint64_t milli_bytes = 0;
+	uint64_t uart_limit = 0;
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+	struct sampler_stats sampler;
+
+	SamplerGetStats(&sampler);
+	late = sampler.late;
+#endif
+
+	OutputGetStats(&output);
+	bytes = output.bytes - start_output->bytes;
+
+	if (wall_us > 0) {
+		throughput = ((uint64_t)samples * USEC_PER_SEC) / wall_us;
+	}
+
+	if (samples > 0) {
+		cpu_ns = (cpu_us * NSEC_PER_USEC) / samples;
+		milli_bytes = ((uint64_t)bytes * MILLI_UNITS) / samples;
+	}
+
+	if (bytes > 0) {
+		uart_limit = ((uint64_t)samples * end->benchmark_baud) /
+			     ((uint64_t)bytes * UART_BITS_PER_BYTE);
+	}
+
+	printf("replay: samples=%u trace_rate=%u Hz wall=%u.%03u s "
+	       "throughput=%u samples/s\n",
+	       samples, end->rate_hz, (uint32_t)(wall_us / USEC_PER_SEC),
+	       (uint32_t)((wall_us % USEC_PER_SEC) / MILLI_UNITS),
+	       (uint32_t)throughput);
+	printf("replay: skipped=%u overruns=%u repeated=%u late=%u\n",
+	       end->skipped - start->skipped,
+	       output.overruns - start_output->overruns,
+	       end->repeated - start->repeated, late);
+	printf("replay: bytes=%u bytes/sample=%u.%03u uart_limit=%u samples/s "
+	       "at %u baud\n",
+	       bytes, (uint32_t)(milli_bytes / MILLI_UNITS),
+	       (uint32_t)(milli_bytes % MILLI_UNITS), (uint32_t)uart_limit,
+	       end->benchmark_baud);
+	printf("replay: cpu=%u.%03u us/sample\n",
+	       (uint32_t)(cpu_ns / NSEC_PER_USEC),
+	       (uint32_t)(cpu_ns % NSEC_PER_USEC));
+}
+
+static void replay_bench_thread(void *unused1, void *unused2, void *unused3)
+{
+	struct lis2dh_replay_stats start;
+	struct lis2dh_replay_stats stats;
+	struct output_stats output;
+	uint64_t cpu_start_us;
+	uint64_t wall_start_us;
+
+	/* Measure from the first sample read, so start up is excluded */
+	do {
+		k_sleep(K_MSEC(REPLAY_BENCH_POLL_MS));
+		Lis2dhReplayGetStats(&start);
+	} while (start.served == 0);
+
+	OutputGetStats(&output);
+	cpu_start_us = replay_bench_cpu_us();
+	wall_start_us = replay_bench_wall_us();
+
+	do {
+		k_sleep(K_MSEC(REPLAY_BENCH_POLL_MS));
+		Lis2dhReplayGetStats(&stats);
+	} while ((stats.served - start.served) < stats.benchmark_samples);
+
+	replay_bench_report(&start, &stats, &output,
+			    replay_bench_cpu_us() - cpu_start_us,
+			    replay_bench_wall_us() - wall_start_us);
+	posix_exit(0);
+}
+
+static int replay_bench_init(const struct device *dev)
+{
+	struct lis2dh_replay_stats stats;
+
+	ARG_UNUSED(dev);
+
+	/* Without --replay-samples the application runs until stopped */
+	Lis2dhReplayGetStats(&stats);
+	if (stats.benchmark_samples == 0) {
+		return 0;
+	}
+
+	k_thread_create(&replay_bench_thread_data, replay_bench_stack_area,
+			K_THREAD_STACK_SIZEOF(replay_bench_stack_area),
+			replay_bench_thread, NULL, NULL, NULL,
+			REPLAY_BENCH_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&replay_bench_thread_data, "replay_bench");
+
+	return 0;
+}
+
+SYS_INIT(replay_bench_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
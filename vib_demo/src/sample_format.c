@@ -0,0 +1,159 @@
+/**
+ * @file sample_format.c
+ * @brief Integer only sample conversion and formatting for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <drivers/sensor.h>
+
+#include "sample_format.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define MICRO_UNITS 1000000LL
+#define MILLI_UNITS 1000LL
+#define MILLI_HALF 500
+#define DECIMAL_PLACES 3
+#define DECIMAL_BASE 10
+
+/* IEEE 754 double layout */
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_MASK 0x7FF
+#define DOUBLE_EXPONENT_BIAS 1075
+
+/* A tie of N/2000 compared against mantissa * 2^exponent is rearranged to
+ * mantissa * 125 against N * 2^(-exponent - 4) so it fits in 64 bits
+ */
+#define TIE_SCALE 125
+#define TIE_SHIFT_OFFSET 4
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int double_compare_tie(const struct sensor_value *val,
+			      uint64_t tie_2000ths);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Compares the magnitude of sensor_value_to_double() of a reading
+ *  against a tie point of N/2000, which lies exactly half way between two
+ *  3 decimal place values.
+ *
+ *  Most tie points are not exactly representable as a double, so printf
+ *  rounds up or down depending on the rounding error in
+ *  sensor_value_to_double(). This only happens for 1 in 1000 readings so the
+ *  double is calculated (in software if there is no FPU) and its bits
+ *  compared exactly.
+ *
+ *  @retval Positive if the double is above the tie, negative if below and 0
+ *          if it is exactly equal
+ */
+static int double_compare_tie(const struct sensor_value *val,
+			      uint64_t tie_2000ths)
+{
+	union {
+		double d;
+		uint64_t u;
+	} conv;
+	uint64_t mantissa;
+	uint64_t tie;
+	int exponent;
+
+	conv.d = sensor_value_to_double(val);
+	mantissa = (conv.u & (BIT64(DOUBLE_MANTISSA_BITS) - 1)) |
+		   BIT64(DOUBLE_MANTISSA_BITS);
+	exponent = (int)((conv.u >> DOUBLE_MANTISSA_BITS) &
+			 DOUBLE_EXPONENT_MASK) -
+		   DOUBLE_EXPONENT_BIAS;
+
+	mantissa *= TIE_SCALE;
+	tie = tie_2000ths << (-exponent - TIE_SHIFT_OFFSET);
+
+	return (mantissa > tie) - (mantissa < tie);
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int16_t SensorValueToMg(const struct sensor_value *val)
+{
+	/* Sensor driver readings are in m/s^2, convert to 0.001 g units,
+	 * rounding to nearest so that values which originated as milli-g
+	 * convert back exactly
+	 */
+	int64_t scaled = (((int64_t)val->val1 * MICRO_UNITS) + val->val2) *
+			 MILLI_UNITS;
+	int64_t mg = (scaled + ((scaled < 0) ? -(SENSOR_G / 2) :
+					       (SENSOR_G / 2))) /
+		     SENSOR_G;
+
+	if (mg > INT16_MAX) {
+		mg = INT16_MAX;
+	} else if (mg < INT16_MIN) {
+		mg = INT16_MIN;
+	}
+
+	return (int16_t)mg;
+}
+
+void MgToSensorValue(int16_t mg, struct sensor_value *val)
+{
+	int64_t micro_ms2 = ((int64_t)mg * SENSOR_G) / MILLI_UNITS;
+
+	val->val1 = (int32_t)(micro_ms2 / MICRO_UNITS);
+	val->val2 = (int32_t)(micro_ms2 % MICRO_UNITS);
+}
+
+size_t FormatSensorValue(char *buffer, const struct sensor_value *val)
+{
+	char digits[SAMPLE_FORMAT_VALUE_MAX_LENGTH];
+	int64_t micro = ((int64_t)val->val1 * MICRO_UNITS) + val->val2;
+	uint64_t magnitude = (micro < 0) ? -micro : micro;
+	uint64_t thousandths = magnitude / MILLI_UNITS;
+	uint32_t remainder = magnitude % MILLI_UNITS;
+	size_t length = 0;
+	uint8_t count = 0;
+	int tie;
+
+	if (remainder > MILLI_HALF) {
+		++thousandths;
+	} else if (remainder == MILLI_HALF) {
+		/* Exact ties round to even, as printf does */
+		tie = double_compare_tie(val, (thousandths * 2) + 1);
+
+		if (tie > 0 || (tie == 0 && (thousandths & 1))) {
+			++thousandths;
+		}
+	}
+
+	/* printf keeps the sign of negative values which round to zero */
+	if (micro < 0) {
+		buffer[length++] = '-';
+	}
+
+	/* Generate digits least significant first, always including at least
+	 * one digit before the decimal point
+	 */
+	do {
+		digits[count++] = '0' + (thousandths % DECIMAL_BASE);
+		thousandths /= DECIMAL_BASE;
+	} while (thousandths > 0 || count <= DECIMAL_PLACES);
+
+	while (count > 0) {
+		if (count == DECIMAL_PLACES) {
+			buffer[length++] = '.';
+		}
+		buffer[length++] = digits[--count];
+	}
+
+	return length;
+}
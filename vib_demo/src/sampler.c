@@ -0,0 +1,201 @@
+/**
+ * @file sampler.c
+ * @brief Periodic sensor sampler thread for vibration demo
+ *
+ * Sample deadlines are calculated from the start time and sample number
+ * rather than by adding a (rounded) period to the previous deadline, so the
+ * long-run sample rate is exact even when the period is not a whole number
+ * of kernel ticks, and time spent reading the sensor or writing the output
+ * does not accumulate as drift. The thread sleeps until each deadline.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <logging/log.h>
+#include <sys/atomic.h>
+#include <drivers/sensor.h>
+
+#include "sampler.h"
+
+LOG_MODULE_REGISTER(sampler);
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define SAMPLER_STACK_SIZE 2048
+#define SAMPLER_PRIORITY 2
+#define ACCEL_ARRAY_SIZE 3
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const struct device *sampler_sensor;
+static atomic_t sampler_rate_hz;
+static sampler_handler_t sampler_handler;
+static struct sampler_stats sampler_stats;
+static struct k_spinlock sampler_stats_lock;
+
+K_THREAD_STACK_DEFINE(sampler_stack_area, SAMPLER_STACK_SIZE);
+static struct k_thread sampler_thread_data;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void sampler_thread(void *unused1, void *unused2, void *unused3);
+static void sampler_record(uint32_t latency_us, uint32_t period_us);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void sampler_record(uint32_t latency_us, uint32_t period_us)
+{
+	uint32_t bin = latency_us / CONFIG_APP_SAMPLER_HISTOGRAM_BIN_US;
+	k_spinlock_key_t key = k_spin_lock(&sampler_stats_lock);
+
+	if (bin >= CONFIG_APP_SAMPLER_HISTOGRAM_BINS) {
+		bin = CONFIG_APP_SAMPLER_HISTOGRAM_BINS - 1;
+	}
+
+	++sampler_stats.samples;
+	++sampler_stats.histogram[bin];
+
+	if (latency_us > sampler_stats.max_latency_us) {
+		sampler_stats.max_latency_us = latency_us;
+	}
+
+	if (latency_us > period_us) {
+		++sampler_stats.late;
+	}
+
+	k_spin_unlock(&sampler_stats_lock, key);
+}
+
+static void sampler_thread(void *unused1, void *unused2, void *unused3)
+{
+	struct sensor_value accel[ACCEL_ARRAY_SIZE];
+	uint32_t rate_hz = (uint32_t)atomic_get(&sampler_rate_hz);
+	uint32_t period_us = USEC_PER_SEC / rate_hz;
+	int64_t start = k_uptime_ticks();
+	int64_t sample = 0;
+	int64_t deadline;
+	int64_t now;
+
+	while (1) {
+		/* Deadline for this sample relative to the start, calculated
+		 * exactly so rounding errors do not accumulate
+		 */
+		deadline = start + ((sample * CONFIG_SYS_CLOCK_TICKS_PER_SEC) /
+				    rate_hz);
+		k_sleep(K_TIMEOUT_ABS_TICKS(deadline));
+
+		/* A rate change wakes the thread early, restart the schedule
+		 * from now at the new rate
+		 */
+		if ((uint32_t)atomic_get(&sampler_rate_hz) != rate_hz) {
+			rate_hz = (uint32_t)atomic_get(&sampler_rate_hz);
+			period_us = USEC_PER_SEC / rate_hz;
+			start = k_uptime_ticks();
+			sample = 0;
+			continue;
+		}
+
+		/* Any other early wake up keeps to the schedule, so that the
+		 * latency is never negative
+		 */
+		now = k_uptime_ticks();
+		if (now < deadline) {
+			continue;
+		}
+
+		sampler_record(k_ticks_to_us_floor32(now - deadline),
+			       period_us);
+
+		/* Fetch the current data value from the sensor */
+		if (sensor_sample_fetch(sampler_sensor) < 0) {
+			printf("IIS2DLPC Sensor sample update error\n");
+			return;
+		}
+
+		sensor_channel_get(sampler_sensor, SENSOR_CHAN_ACCEL_XYZ,
+				   accel);
+
+		/* The rate changed whilst the sensor was being read, so the
+		 * output has already marked the new rate. This sample is on
+		 * the old schedule and is dropped, the next pass restarts
+		 */
+		if ((uint32_t)atomic_get(&sampler_rate_hz) != rate_hz) {
+			continue;
+		}
+
+		/* Timestamped with the actual fetch time, so wake up jitter
+		 * is visible to the host rather than assumed away
+		 */
+		sampler_handler(accel, (uint32_t)k_ticks_to_us_floor64(now));
+
+		++sample;
+	}
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int SamplerStart(const struct device *sensor, uint32_t rate_hz,
+		 sampler_handler_t handler)
+{
+	if (sensor == NULL || handler == NULL || rate_hz == 0 ||
+	    rate_hz > SAMPLER_RATE_MAX_HZ) {
+		return -EINVAL;
+	}
+
+	sampler_sensor = sensor;
+	atomic_set(&sampler_rate_hz, rate_hz);
+	sampler_handler = handler;
+	SamplerResetStats();
+
+	k_thread_create(&sampler_thread_data, sampler_stack_area,
+			K_THREAD_STACK_SIZEOF(sampler_stack_area),
+			sampler_thread, NULL, NULL, NULL, SAMPLER_PRIORITY, 0,
+			K_NO_WAIT);
+	k_thread_name_set(&sampler_thread_data, "sampler");
+
+	return 0;
+}
+
+int SamplerSetRate(uint32_t rate_hz)
+{
+	if (rate_hz == 0 || rate_hz > SAMPLER_RATE_MAX_HZ) {
+		return -EINVAL;
+	}
+
+	/* The thread is only woken to restart its schedule at a new rate */
+	if ((uint32_t)atomic_set(&sampler_rate_hz, rate_hz) != rate_hz) {
+		k_wakeup(&sampler_thread_data);
+	}
+
+	return 0;
+}
+
+void SamplerGetStats(struct sampler_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&sampler_stats_lock);
+
+	*stats = sampler_stats;
+	k_spin_unlock(&sampler_stats_lock, key);
+}
+
+void SamplerResetStats(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&sampler_stats_lock);
+
+	memset(&sampler_stats, 0, sizeof(sampler_stats));
+	k_spin_unlock(&sampler_stats_lock, key);
+}
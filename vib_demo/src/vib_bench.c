@@ -0,0 +1,520 @@
+/**
+ * @file vib_bench.c
+ * @brief Shell benchmarks for vibration demo processing stages
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <shell/shell.h>
+#include <drivers/sensor.h>
+
+#include "cycles.h"
+#include "sample_format.h"
+#include "accel_convert.h"
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+#include "frame.h"
+#endif
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+#include <arm_math.h>
+#include "application.h"
+#include "decimator.h"
+#include "output.h"
+#endif
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define BENCH_SAMPLES 1024
+#define BENCH_SAMPLE_OFFSET (BENCH_SAMPLES / 2)
+
+/* 2 milli-g (one LSB at +/-4 g in high resolution mode) in micro m/s^2 */
+#define BENCH_STEP_MICRO_MS2 19613
+#define MICRO_UNITS 1000000
+
+/* Raw conversion benchmark, LIS2DH high resolution output at +/-4 g */
+#define BENCH_RAW_SAMPLES 256
+#define BENCH_RAW_SHIFT 4
+#define BENCH_RAW_SENSITIVITY_MG 2
+
+/* Synthetic trace for the compression benchmark, gravity on Z plus a
+ * random walk of up to +/-BENCH_WALK_STEP milli-g per sample on each axis
+ */
+#define BENCH_AXES 3
+#define BENCH_GRAVITY_MG 1000
+#define BENCH_WALK_STEP 4
+#define BENCH_LCG_MULTIPLIER 1664525
+#define BENCH_LCG_INCREMENT 1013904223
+#define BENCH_LCG_SHIFT 16
+
+/* Decimator frequency response, tones at these fractions of the output
+ * rate (in thousandths) are measured after the filter has settled
+ */
+#define BENCH_TONE_MG 16000
+#define BENCH_TONE_OUTPUTS 256
+#define BENCH_RESPONSE_POINTS 12
+#define PERMILLE 1000
+#define Q16_BITS 16
+#define Q31_BITS 31
+
+/* 10 * log10(2) = 3.0103 dB per doubling of power, in thousandths */
+#define DB_PER_OCTAVE_X1000 3010
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct sensor_value bench_values[BENCH_SAMPLES];
+static uint8_t bench_raw[BENCH_RAW_SAMPLES * ACCEL_CONVERT_RAW_SAMPLE_SIZE];
+static int16_t bench_mg[BENCH_RAW_SAMPLES][ACCEL_CONVERT_AXIS_COUNT];
+static int16_t bench_reference_mg[BENCH_RAW_SAMPLES][ACCEL_CONVERT_AXIS_COUNT];
+static struct accel_convert bench_convert;
+
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static int16_t bench_trace[BENCH_SAMPLES][BENCH_AXES];
+static struct frame_encoder bench_encoder;
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static struct decimator bench_decimator;
+static const uint8_t bench_axes[BENCH_AXES] = { 0, 1, 2 };
+static const uint16_t bench_response_permille[BENCH_RESPONSE_POINTS] = {
+	50, 100, 200, 300, 400, 450, 500, 550, 750, 1000, 2000, 3500
+};
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void bench_generate_values(void);
+static int cmd_bench_format(const struct shell *shell, size_t argc,
+			    char **argv);
+static int cmd_bench_convert(const struct shell *shell, size_t argc,
+			     char **argv);
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static void bench_generate_trace(void);
+static size_t bench_encode(uint8_t flags, uint32_t *cycles);
+static int cmd_bench_compress(const struct shell *shell, size_t argc,
+			      char **argv);
+#endif
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static int32_t log2_q16(uint64_t value);
+static int32_t bench_tone_db_x10(uint16_t permille, uint8_t ratio);
+static int cmd_bench_decimate(const struct shell *shell, size_t argc,
+			      char **argv);
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Fills the benchmark input with a sweep of readings covering the
+ *  range the LIS2DH driver produces at +/-4 g.
+ */
+static void bench_generate_values(void)
+{
+	uint32_t i = 0;
+
+	while (i < BENCH_SAMPLES) {
+		int32_t micro = ((int32_t)i - BENCH_SAMPLE_OFFSET) * 4 *
+				BENCH_STEP_MICRO_MS2;
+
+		bench_values[i].val1 = micro / MICRO_UNITS;
+		bench_values[i].val2 = micro % MICRO_UNITS;
+		++i;
+	}
+}
+
+static int cmd_bench_format(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	char buffer[SAMPLE_FORMAT_VALUE_MAX_LENGTH + 1];
+	volatile int16_t mg;
+	uint32_t start;
+	uint32_t mg_cycles;
+	uint32_t format_cycles;
+	uint32_t i;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	bench_generate_values();
+	CyclesInit();
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_SAMPLES; ++i) {
+		mg = SensorValueToMg(&bench_values[i]);
+	}
+	mg_cycles = CyclesGet() - start;
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_SAMPLES; ++i) {
+		FormatSensorValue(buffer, &bench_values[i]);
+	}
+	format_cycles = CyclesGet() - start;
+
+	shell_print(shell, "SensorValueToMg: %u cycles/value",
+		    mg_cycles / BENCH_SAMPLES);
+	shell_print(shell, "FormatSensorValue: %u cycles/value",
+		    format_cycles / BENCH_SAMPLES);
+
+#if defined(CONFIG_NEWLIB_LIBC_FLOAT_PRINTF)
+	/* Compare against the floating point printf path this replaced */
+	char reference[SAMPLE_FORMAT_VALUE_MAX_LENGTH + 1];
+	uint32_t printf_cycles;
+	uint32_t mismatches = 0;
+	size_t length;
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_SAMPLES; ++i) {
+		snprintf(reference, sizeof(reference), "%.3f",
+			 sensor_value_to_double(&bench_values[i]));
+	}
+	printf_cycles = CyclesGet() - start;
+
+	for (i = 0; i < BENCH_SAMPLES; ++i) {
+		length = FormatSensorValue(buffer, &bench_values[i]);
+		buffer[length] = '\0';
+		snprintf(reference, sizeof(reference), "%.3f",
+			 sensor_value_to_double(&bench_values[i]));
+
+		if (strcmp(buffer, reference) != 0) {
+			++mismatches;
+		}
+	}
+
+	shell_print(shell, "printf(\"%%.3f\"): %u cycles/value",
+		    printf_cycles / BENCH_SAMPLES);
+	shell_print(shell, "Output mismatches: %u", mismatches);
+#endif
+
+	return 0;
+}
+
+static int cmd_bench_convert(const struct shell *shell, size_t argc,
+			     char **argv)
+{
+	struct accel_calibration calibration;
+	volatile int16_t mg;
+	uint32_t random = 0;
+	uint32_t mismatches = 0;
+	uint32_t start;
+	uint32_t reference_cycles;
+	uint32_t raw_cycles;
+	uint32_t values_cycles;
+	uint32_t mg_cycles;
+	uint32_t samples = BENCH_SAMPLES / ACCEL_CONVERT_AXIS_COUNT;
+	uint32_t i;
+	uint8_t axis;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	AccelCalibrationGetConfig(&calibration);
+	if (AccelConvertInit(&bench_convert, &calibration) != 0 ||
+	    AccelConvertSetRawFormat(&bench_convert, BENCH_RAW_SHIFT,
+				     BENCH_RAW_SENSITIVITY_MG) != 0) {
+		shell_error(shell, "Invalid accelerometer calibration");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < sizeof(bench_raw); ++i) {
+		random = (random * BENCH_LCG_MULTIPLIER) + BENCH_LCG_INCREMENT;
+		bench_raw[i] = (uint8_t)(random >> BENCH_LCG_SHIFT);
+	}
+
+	bench_generate_values();
+	CyclesInit();
+
+	start = CyclesGet();
+	AccelConvertRawReference(&bench_convert, bench_raw, bench_reference_mg,
+				 BENCH_RAW_SAMPLES);
+	reference_cycles = CyclesGet() - start;
+
+	start = CyclesGet();
+	AccelConvertRaw(&bench_convert, bench_raw, bench_mg, BENCH_RAW_SAMPLES);
+	raw_cycles = CyclesGet() - start;
+
+	for (i = 0; i < BENCH_RAW_SAMPLES; ++i) {
+		for (axis = 0; axis < ACCEL_CONVERT_AXIS_COUNT; ++axis) {
+			if (bench_mg[i][axis] != bench_reference_mg[i][axis]) {
+				++mismatches;
+			}
+		}
+	}
+
+	/* The sensor_value sweep taken as X, Y and Z triples */
+	start = CyclesGet();
+	AccelConvertValues(&bench_convert, bench_values, bench_mg, samples);
+	values_cycles = CyclesGet() - start;
+
+	start = CyclesGet();
+	for (i = 0; i < samples * ACCEL_CONVERT_AXIS_COUNT; ++i) {
+		mg = SensorValueToMg(&bench_values[i]);
+	}
+	mg_cycles = CyclesGet() - start;
+
+	shell_print(shell, "Raw words, %u samples of 3 axes:",
+		    BENCH_RAW_SAMPLES);
+	shell_print(shell, "  AccelConvertRawReference: %u cycles/sample",
+		    reference_cycles / BENCH_RAW_SAMPLES);
+	shell_print(shell, "  AccelConvertRaw (%s): %u cycles/sample",
+		    IS_ENABLED(__ARM_FEATURE_DSP) ? "SMLAD" : "C",
+		    raw_cycles / BENCH_RAW_SAMPLES);
+	shell_print(shell, "  Mismatches: %u", mismatches);
+	shell_print(shell, "Sensor values, %u samples of 3 axes:", samples);
+	shell_print(shell, "  AccelConvertValues: %u cycles/sample",
+		    values_cycles / samples);
+	shell_print(shell, "  SensorValueToMg: %u cycles/sample",
+		    mg_cycles / samples);
+
+	return 0;
+}
+
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static void bench_generate_trace(void)
+{
+	uint32_t random = 0;
+	int16_t value[BENCH_AXES] = { 0, 0, BENCH_GRAVITY_MG };
+	uint32_t i = 0;
+	uint8_t axis;
+
+	while (i < BENCH_SAMPLES) {
+		for (axis = 0; axis < BENCH_AXES; ++axis) {
+			random = (random * BENCH_LCG_MULTIPLIER) +
+				 BENCH_LCG_INCREMENT;
+			value[axis] += (int16_t)((random >> BENCH_LCG_SHIFT) %
+						 ((BENCH_WALK_STEP * 2) + 1)) -
+				       BENCH_WALK_STEP;
+			bench_trace[i][axis] = value[axis];
+		}
+		++i;
+	}
+}
+
+/** @brief Encodes the trace into frames with all axes enabled.
+ *
+ *  @retval Total size of the frames in bytes
+ */
+static size_t bench_encode(uint8_t flags, uint32_t *cycles)
+{
+	size_t total = 0;
+	size_t length;
+	uint32_t start;
+	uint32_t i;
+
+	FrameEncoderInit(&bench_encoder, CONFIG_APP_SAMPLING_FREQUENCY_HZ,
+			 FRAME_AXIS_X | FRAME_AXIS_Y | FRAME_AXIS_Z | flags);
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_SAMPLES; ++i) {
+		if (FrameEncoderAdd(&bench_encoder, bench_trace[i], 0)) {
+			FrameEncoderFinish(&bench_encoder, &length);
+			total += length;
+		}
+	}
+	FrameEncoderFinish(&bench_encoder, &length);
+	total += length;
+	*cycles = CyclesGet() - start;
+
+	return total;
+}
+
+static int cmd_bench_compress(const struct shell *shell, size_t argc,
+			      char **argv)
+{
+	uint32_t raw_cycles;
+	uint32_t compressed_cycles;
+	size_t raw_bytes;
+	size_t compressed_bytes;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	bench_generate_trace();
+	CyclesInit();
+
+	raw_bytes = bench_encode(0, &raw_cycles);
+	compressed_bytes = bench_encode(FRAME_FLAG_COMPRESSED,
+					&compressed_cycles);
+
+	shell_print(shell, "Binary: %zu bytes, %u cycles/sample",
+		    raw_bytes, raw_cycles / BENCH_SAMPLES);
+	shell_print(shell, "Compressed: %zu bytes, %u cycles/sample",
+		    compressed_bytes, compressed_cycles / BENCH_SAMPLES);
+	shell_print(shell, "Compression ratio: %zu.%02zu",
+		    raw_bytes / compressed_bytes,
+		    ((raw_bytes % compressed_bytes) * 100) / compressed_bytes);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+/** @brief Base 2 logarithm in Q16, value must not be 0. */
+static int32_t log2_q16(uint64_t value)
+{
+	int32_t msb = 63 - __builtin_clzll(value);
+	int32_t result = msb << Q16_BITS;
+	uint64_t mantissa;
+	uint8_t bit = Q16_BITS;
+
+	/* Normalise to 1.0 to 2.0 in Q31, then each squaring gives the next
+	 * fraction bit
+	 */
+	mantissa = (msb >= Q31_BITS) ? (value >> (msb - Q31_BITS)) :
+				       (value << (Q31_BITS - msb));
+
+	while (bit > 0) {
+		--bit;
+		mantissa = (mantissa * mantissa) >> Q31_BITS;
+		if (mantissa >= BIT64(Q31_BITS + 1)) {
+			mantissa >>= 1;
+			result |= BIT(bit);
+		}
+	}
+
+	return result;
+}
+
+/** @brief Decimates a full scale tone on one axis and measures the output
+ *  power relative to the input.
+ *
+ *  @retval Gain in 0.1 dB
+ */
+static int32_t bench_tone_db_x10(uint16_t permille, uint8_t ratio)
+{
+	uint32_t step = (uint32_t)(((uint64_t)permille << Q31_BITS) /
+				   (PERMILLE * ratio));
+	uint32_t phase = 0;
+	uint32_t outputs = 0;
+	uint64_t power = 0;
+	int16_t in[BENCH_AXES] = { 0, 0, 0 };
+	int16_t out[BENCH_AXES];
+	uint8_t axis = 2;
+
+	DecimatorReset(&bench_decimator);
+
+	/* Outputs are only measured once the zeroed history has left the
+	 * filter, after taps per phase outputs
+	 */
+	while (outputs < (BENCH_TONE_OUTPUTS + DECIMATOR_TAPS_PER_PHASE)) {
+		in[axis] = (int16_t)(((int64_t)arm_sin_q31(
+					      (q31_t)(phase & INT32_MAX)) *
+				      BENCH_TONE_MG) >>
+				     Q31_BITS);
+		phase += step;
+
+		if (DecimatorAdd(&bench_decimator, in, &axis, 1, out)) {
+			if (outputs >= DECIMATOR_TAPS_PER_PHASE) {
+				power += (int32_t)out[axis] * out[axis];
+			}
+			++outputs;
+		}
+	}
+
+	/* The mean square of a sine wave is half its amplitude squared, a
+	 * silent output is reported as a single LSB
+	 */
+	power = MAX(power * 2, 1);
+
+	return (int32_t)(((int64_t)(log2_q16(power) -
+				    log2_q16((uint64_t)BENCH_TONE_MG *
+					     BENCH_TONE_MG *
+					     BENCH_TONE_OUTPUTS)) *
+			  DB_PER_OCTAVE_X1000 * 10) /
+			 ((int64_t)PERMILLE << Q16_BITS));
+}
+
+static int cmd_bench_decimate(const struct shell *shell, size_t argc,
+			      char **argv)
+{
+	uint8_t ratio = OutputGetDecimation();
+	uint32_t rate_hz = ApplicationGetRate();
+	uint32_t outputs = 0;
+	uint32_t cycles;
+	uint32_t start;
+	int16_t out[BENCH_AXES];
+	int32_t gain;
+	uint32_t frequency;
+	uint32_t i;
+
+	if (argc > 1) {
+		ratio = (uint8_t)strtoul(argv[1], NULL, 10);
+	}
+
+	if (ratio < 2 || DecimatorInit(&bench_decimator, ratio) != 0) {
+		shell_error(shell, "Ratio must be 2 to %u",
+			    CONFIG_APP_DECIMATION_RATIO_MAX);
+		return -EINVAL;
+	}
+
+	bench_generate_trace();
+	CyclesInit();
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_SAMPLES; ++i) {
+		if (DecimatorAdd(&bench_decimator, bench_trace[i], bench_axes,
+				 BENCH_AXES, out)) {
+			++outputs;
+		}
+	}
+	cycles = CyclesGet() - start;
+
+	shell_print(shell, "Decimate by %u, %u taps (%s)", ratio,
+		    bench_decimator.taps,
+		    IS_ENABLED(__ARM_FEATURE_DSP) ? "SMLAD" : "C");
+	shell_print(shell, "%u cycles per output sample of %u axes",
+		    cycles / outputs, BENCH_AXES);
+	shell_print(shell, "Frequency response at %u Hz in, %u Hz out:",
+		    rate_hz, rate_hz / ratio);
+
+	/* Tones up to half the input rate */
+	for (i = 0; i < BENCH_RESPONSE_POINTS; ++i) {
+		if (bench_response_permille[i] >= (ratio * PERMILLE / 2)) {
+			break;
+		}
+
+		gain = bench_tone_db_x10(bench_response_permille[i], ratio);
+		frequency = (rate_hz * bench_response_permille[i] * 10) /
+			    (ratio * PERMILLE);
+		shell_print(shell, "  %u.%03u fout %6u.%u Hz %s%d.%d dB",
+			    bench_response_permille[i] / PERMILLE,
+			    bench_response_permille[i] % PERMILLE,
+			    frequency / 10, frequency % 10,
+			    (gain < 0) ? "-" : " ", abs(gain) / 10,
+			    abs(gain) % 10);
+	}
+
+	return 0;
+}
+#endif
+
+/******************************************************************************/
+/* Shell Command Registration                                                 */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	bench_cmds,
+	SHELL_CMD(format, NULL, "Sample conversion and CSV formatting",
+		  cmd_bench_format),
+	SHELL_CMD(convert, NULL, "Batch milli-g conversion",
+		  cmd_bench_convert),
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+	SHELL_CMD(compress, NULL, "Compressed frame encoding",
+		  cmd_bench_compress),
+#endif
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+	SHELL_CMD_ARG(decimate, NULL,
+		      "Decimation filter cost and frequency response [ratio]",
+		      cmd_bench_decimate, 1, 1),
+#endif
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(bench, &bench_cmds, "Vibration demo benchmarks", NULL);
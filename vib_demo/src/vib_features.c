@@ -0,0 +1,214 @@
+/**
+ * @file vib_features.c
+ * @brief Windowed vibration feature extraction for vibration demo
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <arm_math.h>
+
+#include "vib_features.h"
+#include "sample_format.h"
+#include "isqrt.h"
+#include "hann_spectrum.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define WINDOW_SAMPLES CONFIG_APP_FEATURE_WINDOW_SAMPLES
+#define WINDOW_OVERLAP                                                         \
+	((WINDOW_SAMPLES * CONFIG_APP_FEATURE_WINDOW_OVERLAP_PERCENT) / 100)
+#define WINDOW_HOP (WINDOW_SAMPLES - WINDOW_OVERLAP)
+
+/* Bin 0 (DC) is not reported, bins 1 to WINDOW_SAMPLES / 2 are */
+#define SPECTRUM_BINS (WINDOW_SAMPLES / 2)
+#define BINS_PER_BAND (SPECTRUM_BINS / CONFIG_APP_FEATURE_SPECTRUM_BANDS)
+
+BUILD_ASSERT((SPECTRUM_BINS % CONFIG_APP_FEATURE_SPECTRUM_BANDS) == 0,
+	     "Spectrum bands must evenly divide half the window length");
+
+/* Samples are scaled down to at most this many bits before the fourth power
+ * sums used for kurtosis, so that the sums cannot overflow 64 bits
+ */
+#define KURTOSIS_SAMPLE_BITS 10
+
+#define RMS_FRACTION_BITS 4
+#define PERCENT 100
+#define Q15_BITS 15
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static q15_t window[SAMPLE_AXIS_COUNT][WINDOW_SAMPLES];
+static uint32_t window_fill;
+
+HANN_SPECTRUM_DEFINE(feature_spectrum, WINDOW_SAMPLES);
+
+/* Working buffers */
+static q15_t deviation[WINDOW_SAMPLES];
+static uint16_t amplitudes[SPECTRUM_BINS];
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static uint32_t ratio_x100(uint64_t numerator, uint64_t denominator);
+static uint16_t saturate_u16(uint32_t value);
+static uint16_t kurtosis_x100(const q15_t *data, q15_t peak);
+static void spectrum_bands(const q15_t *data, q15_t peak, uint16_t *bands);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Calculates numerator * 100 / denominator, dropping low bits of both
+ *  when the multiplication would overflow.
+ */
+static uint32_t ratio_x100(uint64_t numerator, uint64_t denominator)
+{
+	while (numerator > (UINT64_MAX / PERCENT)) {
+		numerator >>= 1;
+		denominator >>= 1;
+	}
+
+	if (denominator == 0) {
+		return 0;
+	}
+
+	return (uint32_t)MIN((numerator * PERCENT) / denominator, UINT32_MAX);
+}
+
+static uint16_t saturate_u16(uint32_t value)
+{
+	return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
+/** @brief Kurtosis of mean removed data, N * sum(x^4) / sum(x^2)^2 */
+static uint16_t kurtosis_x100(const q15_t *data, q15_t peak)
+{
+	uint64_t sum2 = 0;
+	uint64_t sum4 = 0;
+	uint8_t shift = 0;
+	uint32_t i = 0;
+
+	while ((peak >> shift) >= BIT(KURTOSIS_SAMPLE_BITS)) {
+		++shift;
+	}
+
+	while (i < WINDOW_SAMPLES) {
+		int32_t x = data[i] >> shift;
+		uint64_t x2 = (uint64_t)(x * x);
+
+		sum2 += x2;
+		sum4 += x2 * x2;
+		++i;
+	}
+
+	return saturate_u16(ratio_x100(sum4 * WINDOW_SAMPLES, sum2 * sum2));
+}
+
+/** @brief Hann windowed magnitude spectrum of mean removed data, grouped
+ *  into bands holding the largest bin amplitude in milli-g.
+ */
+static void spectrum_bands(const q15_t *data, q15_t peak, uint16_t *bands)
+{
+	uint32_t band = 0;
+	uint32_t bin = 0;
+	uint32_t i;
+	uint16_t largest;
+
+	HannSpectrumAmplitudes(&feature_spectrum, data, peak, amplitudes);
+
+	while (band < CONFIG_APP_FEATURE_SPECTRUM_BANDS) {
+		largest = 0;
+
+		for (i = 0; i < BINS_PER_BAND; ++i, ++bin) {
+			largest = MAX(largest, amplitudes[bin]);
+		}
+
+		bands[band] = largest;
+		++band;
+	}
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int FeaturesInit(void)
+{
+	if (HannSpectrumInit(&feature_spectrum) != 0) {
+		return -EINVAL;
+	}
+
+	window_fill = 0;
+
+	return 0;
+}
+
+bool FeaturesAdd(const int16_t *mg)
+{
+	uint8_t axis = 0;
+
+	/* Slide the previous window along by the hop, keeping the overlap */
+	if (window_fill == WINDOW_SAMPLES) {
+		while (axis < SAMPLE_AXIS_COUNT) {
+			memmove(&window[axis][0], &window[axis][WINDOW_HOP],
+				WINDOW_OVERLAP * sizeof(q15_t));
+			++axis;
+		}
+		window_fill = WINDOW_OVERLAP;
+		axis = 0;
+	}
+
+	while (axis < SAMPLE_AXIS_COUNT) {
+		window[axis][window_fill] = mg[axis];
+		++axis;
+	}
+	++window_fill;
+
+	return (window_fill == WINDOW_SAMPLES);
+}
+
+void FeaturesCompute(uint8_t axis, struct axis_features *features)
+{
+	const q15_t *data = window[axis];
+	q15_t mean;
+	q15_t max;
+	q15_t min;
+	q15_t peak;
+	q63_t sum2;
+	uint32_t index;
+	uint32_t rms_scaled;
+
+	arm_mean_q15(data, WINDOW_SAMPLES, &mean);
+	arm_max_q15(data, WINDOW_SAMPLES, &max, &index);
+	arm_min_q15(data, WINDOW_SAMPLES, &min, &index);
+	features->peak_to_peak_mg = saturate_u16((int32_t)max - min);
+
+	/* Remove gravity and the sensor offset, the mean is within the range
+	 * of the data so only saturates if the data spans the full range
+	 */
+	arm_offset_q15(data, -mean, deviation, WINDOW_SAMPLES);
+	peak = MAX(__SSAT((int32_t)max - mean, 16),
+		   __SSAT((int32_t)mean - min, 16));
+	features->peak_mg = (uint16_t)peak;
+
+	/* arm_power_q15 is the plain sum of squares of the integer values */
+	arm_power_q15(deviation, WINDOW_SAMPLES, &sum2);
+	rms_scaled = Isqrt64(((uint64_t)sum2 << (RMS_FRACTION_BITS * 2)) /
+			     WINDOW_SAMPLES);
+	features->rms_mg = saturate_u16(
+		(rms_scaled + BIT(RMS_FRACTION_BITS - 1)) >> RMS_FRACTION_BITS);
+	features->crest_x100 = saturate_u16(ratio_x100(
+		(uint64_t)peak << RMS_FRACTION_BITS, rms_scaled));
+
+	features->kurtosis_x100 = kurtosis_x100(deviation, peak);
+
+	spectrum_bands(deviation, peak, features->bands);
+}
@@ -0,0 +1,588 @@
+/**
+ * @file vib_shell.c
+ * @brief Shell commands for vibration demo statistics
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <shell/shell.h>
+
+#include "application.h"
+#include "output.h"
+
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+#include "lis2dh_fifo.h"
+#else
+#include "sampler.h"
+#endif
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+#include "flash_capture.h"
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+#include "inference.h"
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+#include "event_capture.h"
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+#include "goertzel.h"
+#endif
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define AXIS_NAMES "xyz"
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static const char *const format_names[OUTPUT_FORMAT_COUNT] = {
+	"csv", "binary", "compressed"
+};
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int cmd_vib_stats(const struct shell *shell, size_t argc, char **argv);
+static int cmd_vib_axes(const struct shell *shell, size_t argc, char **argv);
+static int cmd_vib_rate(const struct shell *shell, size_t argc, char **argv);
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static int cmd_vib_format(const struct shell *shell, size_t argc,
+			  char **argv);
+#endif
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static int cmd_vib_decimate(const struct shell *shell, size_t argc,
+			    char **argv);
+#endif
+static void print_max_rate(const struct shell *shell);
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+static int cmd_vib_jitter(const struct shell *shell, size_t argc,
+			  char **argv);
+static int cmd_vib_reset(const struct shell *shell, size_t argc, char **argv);
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+static int cmd_vib_inference(const struct shell *shell, size_t argc,
+			     char **argv);
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+static int cmd_vib_goertzel(const struct shell *shell, size_t argc,
+			    char **argv);
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+static int cmd_vib_events(const struct shell *shell, size_t argc,
+			  char **argv);
+#endif
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+static int cmd_capture_start(const struct shell *shell, size_t argc,
+			     char **argv);
+static int cmd_capture_arm(const struct shell *shell, size_t argc,
+			   char **argv);
+static int cmd_capture_stop(const struct shell *shell, size_t argc,
+			    char **argv);
+static int cmd_capture_dump(const struct shell *shell, size_t argc,
+			    char **argv);
+static int cmd_capture_status(const struct shell *shell, size_t argc,
+			      char **argv);
+static int capture_result(const struct shell *shell, int rc,
+			  const char *done);
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int cmd_vib_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	struct output_stats output;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	OutputGetStats(&output);
+
+	shell_print(shell, "Sample rate: %u Hz", ApplicationGetRate());
+	shell_print(shell, "Output buffer: %u/%u used, high water %u",
+		    output.used, output.size, output.high_water);
+	shell_print(shell, "Output overruns: %u", output.overruns);
+	shell_print(shell, "Output underruns: %u", output.underruns);
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+	shell_print(shell, "FIFO overruns: %u", Lis2dhFifoGetOverruns());
+	shell_print(shell, "Measured sample period: %u ns",
+		    Lis2dhFifoGetPeriodNs());
+#else
+	struct sampler_stats stats;
+
+	SamplerGetStats(&stats);
+	shell_print(shell, "Samples: %u", stats.samples);
+	shell_print(shell, "Late samples: %u", stats.late);
+	shell_print(shell, "Max latency: %u us", stats.max_latency_us);
+#endif
+
+	return 0;
+}
+
+static int cmd_vib_axes(const struct shell *shell, size_t argc, char **argv)
+{
+	char names[sizeof(AXIS_NAMES)];
+	const char *axis;
+	const char *name;
+	uint8_t axis_mask = 0;
+	uint8_t length = 0;
+	uint8_t i = 0;
+	int rc;
+
+	if (argc > 1) {
+		for (axis = argv[1]; *axis != '\0'; ++axis) {
+			/* Accept upper or lower case axis names */
+			name = strchr(AXIS_NAMES, *axis | 0x20);
+			if (name == NULL) {
+				shell_error(shell, "Axes must be from %s",
+					    AXIS_NAMES);
+				return -EINVAL;
+			}
+			axis_mask |= BIT(name - AXIS_NAMES);
+		}
+
+		rc = OutputSetAxisMask(axis_mask);
+		if (rc != 0) {
+			shell_error(shell, "At least one axis is needed");
+			return rc;
+		}
+	}
+
+	axis_mask = OutputGetAxisMask();
+	while (i < (sizeof(AXIS_NAMES) - 1)) {
+		if (axis_mask & BIT(i)) {
+			names[length++] = AXIS_NAMES[i];
+		}
+		++i;
+	}
+	names[length] = '\0';
+
+	shell_print(shell, "Axes: %s", names);
+	print_max_rate(shell);
+
+	return 0;
+}
+
+static int cmd_vib_rate(const struct shell *shell, size_t argc, char **argv)
+{
+	long rate_hz;
+	int rc;
+
+	if (argc > 1) {
+		rate_hz = strtol(argv[1], NULL, 10);
+		rc = (rate_hz > 0) ? ApplicationSetRate((uint32_t)rate_hz) :
+				     -EINVAL;
+
+		if (rc != 0) {
+#if defined(CONFIG_APP_ACQUISITION_FIFO)
+			shell_error(shell, "Rate must be 1, 10, 25, 50, 100, "
+					   "200, 400, 1344 or 1620 Hz");
+#else
+			shell_error(shell, "Rate must be 1 to %u Hz",
+				    SAMPLER_RATE_MAX_HZ);
+#endif
+			return rc;
+		}
+	}
+
+	shell_print(shell, "Sample rate: %u Hz", ApplicationGetRate());
+	print_max_rate(shell);
+
+	return 0;
+}
+
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+static int cmd_vib_format(const struct shell *shell, size_t argc,
+			  char **argv)
+{
+	enum output_format format = OUTPUT_FORMAT_CSV;
+	int rc;
+
+	if (argc > 1) {
+		while (format < OUTPUT_FORMAT_COUNT &&
+		       strcmp(argv[1], format_names[format]) != 0) {
+			++format;
+		}
+
+		rc = OutputSetFormat(format);
+		if (rc != 0) {
+			shell_error(shell, "Format must be csv, binary or "
+					   "compressed");
+			return rc;
+		}
+	}
+
+	shell_print(shell, "Output format: %s",
+		    format_names[OutputGetFormat()]);
+	print_max_rate(shell);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+static int cmd_vib_decimate(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	long ratio;
+	int rc;
+
+	if (argc > 1) {
+		ratio = strtol(argv[1], NULL, 10);
+		rc = (ratio > 0 && ratio <= UINT8_MAX) ?
+			     OutputSetDecimation((uint8_t)ratio) :
+			     -EINVAL;
+
+		if (rc != 0) {
+			shell_error(shell, "Ratio must be 1 to %u",
+				    CONFIG_APP_DECIMATION_RATIO_MAX);
+			return rc;
+		}
+	}
+
+	ratio = OutputGetDecimation();
+	shell_print(shell, "Decimation: %ld, output rate %u Hz", ratio,
+		    ApplicationGetRate() / (uint32_t)ratio);
+	print_max_rate(shell);
+
+	return 0;
+}
+#endif
+
+/** @brief Shows the highest rate the UART can carry with the current axes
+ *  and format, warning if the sample rate is above it.
+ */
+static void print_max_rate(const struct shell *shell)
+{
+	uint32_t max_rate_hz = OutputGetMaxRate();
+
+	if (max_rate_hz == 0) {
+		return;
+	}
+
+	shell_print(shell, "Maximum sample rate for output: %u Hz",
+		    max_rate_hz);
+
+	if (ApplicationGetRate() > max_rate_hz) {
+		shell_warn(shell, "Sample rate is above the output rate, "
+				  "samples will be dropped");
+	}
+}
+
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+static int cmd_vib_jitter(const struct shell *shell, size_t argc, char **argv)
+{
+	struct sampler_stats stats;
+	uint8_t i = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	SamplerGetStats(&stats);
+
+	while (i < (CONFIG_APP_SAMPLER_HISTOGRAM_BINS - 1)) {
+		shell_print(shell, "%6u-%6u us: %u",
+			    i * CONFIG_APP_SAMPLER_HISTOGRAM_BIN_US,
+			    ((i + 1) * CONFIG_APP_SAMPLER_HISTOGRAM_BIN_US) - 1,
+			    stats.histogram[i]);
+		++i;
+	}
+
+	shell_print(shell, "%6u+       us: %u",
+		    i * CONFIG_APP_SAMPLER_HISTOGRAM_BIN_US, stats.histogram[i]);
+
+	return 0;
+}
+
+static int cmd_vib_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	SamplerResetStats();
+	shell_print(shell, "Statistics cleared");
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+static int cmd_vib_inference(const struct shell *shell, size_t argc,
+			     char **argv)
+{
+	struct inference_stats stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	InferenceGetStats(&stats);
+
+	shell_print(shell, "Windows: %u filled, %u classified, %u dropped",
+		    stats.windows, stats.classified, stats.dropped);
+	shell_print(shell, "Window fill time: %u us", stats.fill_us);
+	shell_print(shell, "Queue latency: %u us (max %u us)", stats.queue_us,
+		    stats.max_queue_us);
+	shell_print(shell, "Inference latency: %u us (max %u us)",
+		    stats.inference_us, stats.max_inference_us);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+static int cmd_vib_goertzel(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	struct goertzel_bin bins[GOERTZEL_BINS_MAX];
+	uint8_t bin_count = GoertzelGetBins(bins);
+	uint8_t i = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(shell, "Block length: %u samples",
+		    CONFIG_APP_GOERTZEL_BLOCK_SAMPLES);
+	shell_print(shell, "%10s %10s %6s %6s %6s %8s", "Frequency",
+		    "Threshold", "X mg", "Y mg", "Z mg", "Alarms");
+
+	while (i < bin_count) {
+		shell_print(shell, "%6u.%u Hz %7u mg %6u %6u %6u %8u%s",
+			    bins[i].frequency_dhz / 10,
+			    bins[i].frequency_dhz % 10, bins[i].threshold_mg,
+			    bins[i].magnitude_mg[0], bins[i].magnitude_mg[1],
+			    bins[i].magnitude_mg[2], bins[i].alarms,
+			    bins[i].active ? "" : " (out of range)");
+		++i;
+	}
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+static int cmd_vib_events(const struct shell *shell, size_t argc,
+			  char **argv)
+{
+	struct event_capture_stats stats;
+	enum event_trigger trigger = 0;
+	long threshold;
+
+	if (argc == 2) {
+		shell_error(shell, "Give a trigger and a threshold in milli-g");
+		return -EINVAL;
+	} else if (argc > 2) {
+		while (trigger < EVENT_TRIGGER_COUNT &&
+		       strcmp(argv[1], EventCaptureTriggerName(trigger)) != 0) {
+			++trigger;
+		}
+
+		threshold = strtol(argv[2], NULL, 10);
+
+		if (trigger == EVENT_TRIGGER_COUNT) {
+			shell_error(shell, "Unknown trigger %s", argv[1]);
+			return -EINVAL;
+		} else if (threshold < 0 || threshold > INT16_MAX) {
+			shell_error(shell, "Threshold must be 0 to %d milli-g",
+				    INT16_MAX);
+			return -EINVAL;
+		}
+
+		EventCaptureSetThreshold(trigger, (uint16_t)threshold);
+	}
+
+	for (trigger = 0; trigger < EVENT_TRIGGER_COUNT; ++trigger) {
+		threshold = EventCaptureGetThreshold(trigger);
+		if (threshold > 0) {
+			shell_print(shell, "Trigger %s: %ld mg",
+				    EventCaptureTriggerName(trigger),
+				    threshold);
+		} else {
+			shell_print(shell, "Trigger %s: off",
+				    EventCaptureTriggerName(trigger));
+		}
+	}
+
+	EventCaptureGetStats(&stats);
+
+	shell_print(shell, "Events: %u captured, %u output, %u missed",
+		    stats.events, stats.emitted, stats.missed);
+	shell_print(shell, "Queue latency: %u us (max %u us)", stats.queue_us,
+		    stats.max_queue_us);
+	shell_print(shell, "Trigger to output latency: %u us (max %u us)",
+		    stats.latency_us, stats.max_latency_us);
+
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+static int capture_result(const struct shell *shell, int rc, const char *done)
+{
+	if (rc == -EBUSY) {
+		shell_error(shell, "Capture or dump already in progress");
+	} else if (rc != 0) {
+		shell_error(shell, "Capture error %d", rc);
+	} else {
+		shell_print(shell, "%s", done);
+	}
+
+	return rc;
+}
+
+static int cmd_capture_start(const struct shell *shell, size_t argc,
+			     char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	return capture_result(shell, FlashCaptureStart(), "Capture started");
+}
+
+static int cmd_capture_arm(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	long threshold = strtol(argv[1], NULL, 10);
+
+	ARG_UNUSED(argc);
+
+	if (threshold <= 0 || threshold > INT16_MAX) {
+		shell_error(shell, "Threshold must be 1 to %d milli-g",
+			    INT16_MAX);
+		return -EINVAL;
+	}
+
+	return capture_result(shell, FlashCaptureArm((uint16_t)threshold),
+			      "Capture armed");
+}
+
+static int cmd_capture_stop(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	FlashCaptureStop();
+
+	return capture_result(shell, 0, "Capture stopped");
+}
+
+static int cmd_capture_dump(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	return capture_result(shell, FlashCaptureDump(),
+			      "Dumping recording to the UART");
+}
+
+static int cmd_capture_status(const struct shell *shell, size_t argc,
+			      char **argv)
+{
+	static const char *const state_names[] = { "idle", "armed",
+						   "recording", "dumping" };
+	struct flash_capture_stats stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	FlashCaptureGetStats(&stats);
+
+	shell_print(shell, "State: %s", state_names[stats.state]);
+	shell_print(shell, "Samples: %u (%u dropped)", stats.samples,
+		    stats.dropped);
+	shell_print(shell, "Bytes written: %u", stats.bytes_written);
+	shell_print(shell, "Erase stalls: %u", stats.erase_stalls);
+	shell_print(shell, "Flash write time: %u us, erase time: %u us",
+		    stats.write_us, stats.erase_us);
+
+	/* Sustained rate over the capture, and the rate the flash accepts
+	 * data at when it is not erasing
+	 */
+	if (stats.elapsed_ms > 0) {
+		shell_print(shell, "Sustained throughput: %u bytes/s",
+			    (uint32_t)(((uint64_t)stats.bytes_written *
+					MSEC_PER_SEC) /
+				       stats.elapsed_ms));
+	}
+
+	if (stats.write_us > 0) {
+		shell_print(shell, "Flash write throughput: %u bytes/s",
+			    (uint32_t)(((uint64_t)stats.bytes_written *
+					USEC_PER_SEC) /
+				       stats.write_us));
+	}
+
+	return 0;
+}
+#endif
+
+/******************************************************************************/
+/* Shell Command Registration                                                 */
+/******************************************************************************/
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	capture_cmds,
+	SHELL_CMD(start, NULL, "Start recording now", cmd_capture_start),
+	SHELL_CMD_ARG(arm, NULL, "Record when an axis deviates by <mg>",
+		      cmd_capture_arm, 2, 0),
+	SHELL_CMD(stop, NULL, "Stop recording", cmd_capture_stop),
+	SHELL_CMD(dump, NULL, "Send the recording out of the UART",
+		  cmd_capture_dump),
+	SHELL_CMD(status, NULL, "Show capture statistics",
+		  cmd_capture_status),
+	SHELL_SUBCMD_SET_END);
+#endif
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	vib_cmds,
+	SHELL_CMD(stats, NULL, "Show acquisition statistics", cmd_vib_stats),
+	SHELL_CMD_ARG(axes, NULL, "Show or set the output axes, e.g. xz",
+		      cmd_vib_axes, 1, 1),
+	SHELL_CMD_ARG(rate, NULL, "Show or set the sample rate in Hz",
+		      cmd_vib_rate, 1, 1),
+#if defined(CONFIG_APP_OUTPUT_STREAM)
+	SHELL_CMD_ARG(format, NULL,
+		      "Show or set the output format (csv, binary, compressed)",
+		      cmd_vib_format, 1, 1),
+#endif
+#if defined(CONFIG_APP_OUTPUT_DECIMATION)
+	SHELL_CMD_ARG(decimate, NULL, "Show or set the output decimation ratio",
+		      cmd_vib_decimate, 1, 1),
+#endif
+#if !defined(CONFIG_APP_ACQUISITION_FIFO)
+	SHELL_CMD(jitter, NULL, "Show sampler wake up latency histogram",
+		  cmd_vib_jitter),
+	SHELL_CMD(reset, NULL, "Clear acquisition statistics", cmd_vib_reset),
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_INFERENCE)
+	SHELL_CMD(inference, NULL, "Show windowing and inference timing",
+		  cmd_vib_inference),
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_GOERTZEL)
+	SHELL_CMD(goertzel, NULL, "Show Goertzel bin amplitudes and alarms",
+		  cmd_vib_goertzel),
+#endif
+#if defined(CONFIG_APP_OUTPUT_FORMAT_EVENTS)
+	SHELL_CMD_ARG(events, NULL,
+		      "Show event statistics or set a trigger, e.g. jerk 200",
+		      cmd_vib_events, 1, 2),
+#endif
+#if defined(CONFIG_APP_FLASH_CAPTURE)
+	SHELL_CMD(capture, &capture_cmds, "QSPI flash burst capture", NULL),
+#endif
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(vib, &vib_cmds, "Vibration demo commands", NULL);
@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Laird Connectivity
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Host side decoder for the vibration demo binary output formats.
+#
+
+import argparse
+import struct
+import sys
+
+SYNC = b"\x5a\xa5"
+HEADER_SIZE = 8
+LENGTH_SIZE = 2
+CRC_SIZE = 2
+CRC_SEED = 0xFFFF
+AXIS_NAMES = ("x", "y", "z")
+AXIS_MASK = 0x07
+FLAG_COMPRESSED = 0x80
+FLAG_TIMESTAMPS = 0x40
+TIMESTAMP_MODULUS = 1 << 32
+VARINT_CONTINUE = 0x80
+VARINT_VALUE_MASK = 0x7F
+VARINT_VALUE_BITS = 7
+
+# Flash capture records, see include/flash_capture.h
+RECORD_SYNC = b"\x5c\xc5"
+RECORD_SIZE = 256
+RECORD_AXES = 3
+
+# UART frames are 1 start bit, 8 data bits and 1 stop bit
+UART_BITS_PER_BYTE = 10
+
+# Longest CSV value per axis with its separator, as assumed by the firmware
+# (CSV_SENSOR_VALUE_MAX_LENGTH in src/output.c), e.g. "-156.906," or
+# "-156.906\r" plus the final "\n"
+CSV_BYTES_PER_AXIS = 9
+CSV_BYTES_PER_LINE = 1
+
+
+def crc16_ccitt(seed, data):
+    """Matches Zephyr's crc16_ccitt() implementation"""
+    for byte in data:
+        e = (seed ^ byte) & 0xFF
+        f = (e ^ (e << 4)) & 0xFF
+        seed = ((seed >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xFFFF
+    return seed
+
+
+def axes_in_mask(mask):
+    return [i for i in range(len(AXIS_NAMES)) if mask & (1 << i)]
+
+
+def zigzag_encode(value):
+    return ((value << 1) ^ (value >> 31)) & 0xFFFFFFFF
+
+
+def varint_encode(value):
+    """Zigzag varint encoding, matches frame_put_varint()"""
+    zigzag = zigzag_encode(value)
+    out = bytearray()
+    while zigzag > VARINT_VALUE_MASK:
+        out.append((zigzag & VARINT_VALUE_MASK) | VARINT_CONTINUE)
+        zigzag >>= VARINT_VALUE_BITS
+    out.append(zigzag)
+    return out
+
+
+def varint_decode(data, count):
+    """Decodes count zigzag varints, None if the data does not match"""
+    values = []
+    value = 0
+    shift = 0
+    for byte in data:
+        value |= (byte & VARINT_VALUE_MASK) << shift
+        shift += VARINT_VALUE_BITS
+        if not byte & VARINT_CONTINUE:
+            values.append((value >> 1) ^ -(value & 1))
+            value = 0
+            shift = 0
+    if len(values) != count or shift != 0:
+        return None
+    return values
+
+
+def delta_decode(values, axes):
+    """Undoes the per axis delta coding of a compressed frame"""
+    samples = []
+    previous = values[:axes]
+    for i in range(0, len(values), axes):
+        if i > 0:
+            previous = [p + d for p, d in zip(previous, values[i:i + axes])]
+        samples.append(tuple(previous))
+    return samples
+
+
+def compress_samples(samples, axes, frame_samples):
+    """Encodes samples as compressed frame payloads, matches frame.c"""
+    payloads = []
+    for start in range(0, len(samples), frame_samples):
+        payload = bytearray()
+        previous = None
+        for sample in samples[start:start + frame_samples]:
+            for i in range(axes):
+                delta = sample[i] if previous is None else \
+                    sample[i] - previous[i]
+                payload += varint_encode(delta)
+            previous = sample
+        payloads.append(payload)
+    return payloads
+
+
+class FrameDecoder:
+    """Extracts frames from a byte stream, resynchronising on errors"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.expected_sequence = None
+        self.frames = 0
+        self.crc_errors = 0
+        self.lost_frames = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                # Keep a trailing byte in case it is half of a sync word
+                del self.buffer[:-1]
+                return
+            del self.buffer[:start]
+            if len(self.buffer) < HEADER_SIZE:
+                return
+            sequence, rate, mask, count = struct.unpack_from(
+                "<HHBB", self.buffer, 2)
+            axes = axes_in_mask(mask & AXIS_MASK)
+            # Timestamps are carried as an extra leading value per sample
+            width = len(axes) + (1 if mask & FLAG_TIMESTAMPS else 0)
+            if mask & FLAG_COMPRESSED:
+                header_size = HEADER_SIZE + LENGTH_SIZE
+                if len(self.buffer) < header_size:
+                    return
+                (payload_size,) = struct.unpack_from(
+                    "<H", self.buffer, HEADER_SIZE)
+            else:
+                header_size = HEADER_SIZE
+                payload_size = (2 * len(axes) +
+                                (4 if mask & FLAG_TIMESTAMPS else 0)) * count
+            length = header_size + payload_size + CRC_SIZE
+            if len(self.buffer) < length:
+                return
+            frame = bytes(self.buffer[:length])
+            (crc,) = struct.unpack_from("<H", frame, length - CRC_SIZE)
+            payload = frame[header_size:length - CRC_SIZE]
+            if mask & FLAG_COMPRESSED:
+                values = varint_decode(payload, width * count)
+            elif mask & FLAG_TIMESTAMPS:
+                values = struct.unpack("<" + ("I%dh" % len(axes)) * count,
+                                       payload)
+            else:
+                values = struct.unpack("<%dh" % (len(axes) * count), payload)
+            if not axes or count == 0 or values is None or \
+               crc16_ccitt(CRC_SEED, frame[2:length - CRC_SIZE]) != crc:
+                # Not a valid frame, skip this sync word and search again
+                self.crc_errors += 1
+                del self.buffer[:len(SYNC)]
+                continue
+            del self.buffer[:length]
+            if self.expected_sequence is not None:
+                self.lost_frames += (sequence -
+                                     self.expected_sequence) & 0xFFFF
+            self.expected_sequence = (sequence + 1) & 0xFFFF
+            self.frames += 1
+            if mask & FLAG_COMPRESSED:
+                samples = delta_decode(values, width)
+            else:
+                samples = [values[i:i + width]
+                           for i in range(0, len(values), width)]
+            if mask & FLAG_TIMESTAMPS:
+                samples = [(s[0] % TIMESTAMP_MODULUS,) + tuple(s[1:])
+                           for s in samples]
+            yield sequence, rate, axes, mask & FLAG_TIMESTAMPS, samples
+
+
+def open_input(path):
+    if path == "-":
+        return sys.stdin.buffer
+    return open(path, "rb")
+
+
+def decode_frames(args):
+    decoder = FrameDecoder()
+    header_axes = None
+    with open_input(args.input) as stream:
+        while True:
+            data = stream.read(4096)
+            if not data:
+                break
+            for sequence, rate, axes, timestamped, samples in \
+                    decoder.feed(data):
+                if (axes, timestamped) != header_axes:
+                    header_axes = (axes, timestamped)
+                    print(",".join((["timestamp_us"] if timestamped else []) +
+                                   [AXIS_NAMES[i] + "_mg" for i in axes]))
+                for sample in samples:
+                    print(",".join(str(v) for v in sample))
+    print("frames=%d crc_errors=%d lost_frames=%d" %
+          (decoder.frames, decoder.crc_errors, decoder.lost_frames),
+          file=sys.stderr)
+
+
+def decode_records(data):
+    """Extracts flash capture records from a dump, skipping any sample
+    output that was sent before the dump started"""
+    records = []
+    errors = 0
+    start = data.find(RECORD_SYNC)
+    while start >= 0 and start + RECORD_SIZE <= len(data):
+        record = data[start:start + RECORD_SIZE]
+        number, rate, mask, count = struct.unpack_from("<HHBB", record, 2)
+        (crc,) = struct.unpack_from("<H", record, RECORD_SIZE - CRC_SIZE)
+        if mask == AXIS_MASK and \
+           crc16_ccitt(CRC_SEED, record[2:RECORD_SIZE - CRC_SIZE]) == crc:
+            values = struct.unpack_from("<%dh" % (RECORD_AXES * count),
+                                        record, HEADER_SIZE)
+            records.append((number, rate, [
+                values[i:i + RECORD_AXES]
+                for i in range(0, len(values), RECORD_AXES)]))
+            start += RECORD_SIZE
+        else:
+            errors += 1
+            start += len(RECORD_SYNC)
+        start = data.find(RECORD_SYNC, start)
+    return records, errors
+
+
+def decode_capture(args):
+    with open_input(args.input) as stream:
+        records, errors = decode_records(stream.read())
+    lost = 0
+    expected = 0
+    samples = 0
+    rate = 0
+    print(",".join(name + "_mg" for name in AXIS_NAMES))
+    for number, rate, values in records:
+        lost += number - expected
+        expected = number + 1
+        samples += len(values)
+        for sample in values:
+            print(",".join(str(v) for v in sample))
+    print("records=%d samples=%d rate=%d crc_errors=%d lost_records=%d" %
+          (len(records), samples, rate, errors, lost), file=sys.stderr)
+
+
+def unwrap_timestamps(timestamps):
+    """Extends the 32-bit microsecond timestamps to a continuous timeline"""
+    out = []
+    offset = 0
+    previous = None
+    for t in timestamps:
+        if previous is not None and t < previous:
+            offset += TIMESTAMP_MODULUS
+        previous = t
+        out.append(t + offset)
+    return out
+
+
+def resample(args):
+    with open_input(args.input) as stream:
+        rows = [line.decode().strip().split(",") for line in stream
+                if line.strip()]
+    header = None
+    if rows and not rows[0][0].isdigit():
+        header = rows[0]
+        rows = rows[1:]
+    if len(rows) < 2:
+        sys.exit("Need at least two timestamped samples")
+    times = unwrap_timestamps([int(row[0]) for row in rows])
+    values = [[float(v) for v in row[1:]] for row in rows]
+
+    # Default to the average rate actually achieved
+    rate = args.rate or (len(times) - 1) * 1e6 / (times[-1] - times[0])
+    period = 1e6 / rate
+    if header:
+        print(",".join(["time_us"] + header[1:]))
+
+    # Linear interpolation onto a uniform grid starting at the first sample
+    i = 0
+    t = float(times[0])
+    while t <= times[-1]:
+        while times[i + 1] < t:
+            i += 1
+        span = times[i + 1] - times[i]
+        fraction = (t - times[i]) / span if span > 0 else 0.0
+        out = [a + (b - a) * fraction
+               for a, b in zip(values[i], values[i + 1])]
+        print(",".join(["%d" % round(t)] + ["%.1f" % v for v in out]))
+        t += period
+    print("samples=%d rate=%.3f Hz" % (len(times), rate), file=sys.stderr)
+
+
+def throughput(args):
+    bytes_per_second = args.baud / UART_BITS_PER_BYTE
+    csv_bytes = CSV_BYTES_PER_AXIS * args.axes + CSV_BYTES_PER_LINE
+    frame_bytes = HEADER_SIZE + (2 * args.axes * args.samples) + CRC_SIZE
+    binary_bytes = frame_bytes / args.samples
+    print("baud=%d axes=%d samples_per_frame=%d" %
+          (args.baud, args.axes, args.samples))
+    print("csv:    %6.2f bytes/sample, %8.1f samples/s" %
+          (csv_bytes, bytes_per_second / csv_bytes))
+    print("binary: %6.2f bytes/sample, %8.1f samples/s" %
+          (binary_bytes, bytes_per_second / binary_bytes))
+
+
+def compress(args):
+    with open(args.input, "r") as stream:
+        rows = [line.strip().split(",") for line in stream if line.strip()]
+    # Skip the header line written by the frames command
+    if rows and not rows[0][0].lstrip("-").isdigit():
+        rows = rows[1:]
+    samples = [tuple(int(v) for v in row) for row in rows]
+    if not samples:
+        sys.exit("No samples in %s" % args.input)
+    axes = len(samples[0])
+    payloads = compress_samples(samples, axes, args.samples)
+
+    decoded = []
+    for start, payload in zip(range(0, len(samples), args.samples),
+                              payloads):
+        count = len(samples[start:start + args.samples])
+        decoded += delta_decode(varint_decode(payload, axes * count), axes)
+    if decoded != samples:
+        sys.exit("Round trip mismatch")
+
+    frame_overhead = HEADER_SIZE + CRC_SIZE
+    raw_bytes = len(payloads) * frame_overhead + 2 * axes * len(samples)
+    compressed_bytes = len(payloads) * (frame_overhead + LENGTH_SIZE) + \
+        sum(len(p) for p in payloads)
+    print("samples=%d axes=%d samples_per_frame=%d" %
+          (len(samples), axes, args.samples))
+    print("binary:     %8d bytes, %6.2f bytes/sample" %
+          (raw_bytes, raw_bytes / len(samples)))
+    print("compressed: %8d bytes, %6.2f bytes/sample" %
+          (compressed_bytes, compressed_bytes / len(samples)))
+    print("ratio:      %6.2f (lossless round trip verified)" %
+          (raw_bytes / compressed_bytes))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Decode vibration demo binary output")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("frames", help="decode binary frames to CSV (milli-g)")
+    p.add_argument("input", help="capture file, or - for stdin")
+    p.set_defaults(func=decode_frames)
+
+    p = sub.add_parser("resample",
+                       help="resample timestamped CSV samples, as output by "
+                       "the frames command or the timestamped CSV output, "
+                       "to a uniform rate")
+    p.add_argument("input", help="CSV file, or - for stdin")
+    p.add_argument("--rate", type=float, default=0,
+                   help="output rate in Hz, defaults to the measured rate")
+    p.set_defaults(func=resample)
+
+    p = sub.add_parser("capture",
+                       help="decode a flash capture dump to CSV (milli-g)")
+    p.add_argument("input", help="capture file, or - for stdin")
+    p.set_defaults(func=decode_capture)
+
+    p = sub.add_parser("compress",
+                       help="compression ratio of a recorded milli-g CSV "
+                       "trace, as output by the frames command")
+    p.add_argument("input", help="CSV trace file")
+    p.add_argument("--samples", type=int, default=32,
+                   help="samples per binary frame")
+    p.set_defaults(func=compress)
+
+    p = sub.add_parser("throughput",
+                       help="estimated maximum sample rate for a given baud "
+                       "rate, with worst case CSV widths")
+    p.add_argument("--baud", type=int, default=115200)
+    p.add_argument("--axes", type=int, choices=(1, 2, 3), default=1)
+    p.add_argument("--samples", type=int, default=32,
+                   help="samples per binary frame")
+    p.set_defaults(func=throughput)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
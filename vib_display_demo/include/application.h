@@ -18,6 +18,42 @@ extern "C" {
 /******************************************************************************/
 #include <zephyr.h>
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Time between points added to the graph, each reduced from
+ * CONFIG_APP_GRAPH_SAMPLES_PER_POINT accelerometer samples
+ */
+#define APPLICATION_POINT_PERIOD_US                                            \
+	((CONFIG_APP_GRAPH_SAMPLES_PER_POINT * USEC_PER_SEC) /                 \
+	 CONFIG_APP_SAMPLE_RATE_HZ)
+
+#define SAMPLE_AXIS_X 0
+#define SAMPLE_AXIS_Y 1
+#define SAMPLE_AXIS_Z 2
+#define SAMPLE_AXIS_COUNT 3
+
+/* X, Y and Z readings in milli-g, and the time they were taken in
+ * microseconds since start up (modulo 2^32)
+ */
+struct accel_sample {
+	int16_t mg[SAMPLE_AXIS_COUNT];
+	uint32_t timestamp_us;
+};
+
+struct acquisition_stats {
+	/* Number of samples read since the statistics were reset */
+	uint32_t samples;
+	/* Number of samples the sensor overwrote before they were read */
+	uint32_t overruns;
+	/* Number of samples read more than one and a half sample periods
+	 * after the previous one
+	 */
+	uint32_t late;
+	/* Largest time between samples being read in microseconds */
+	uint32_t max_interval_us;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -26,6 +62,18 @@ extern "C" {
  */
 void ApplicationStart(void);
 
+/**
+ * @brief Gets the sample timing statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void ApplicationGetStats(struct acquisition_stats *stats);
+
+/**
+ * @brief Clears the sample timing statistics
+ */
+void ApplicationResetStats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,114 @@
+/**
+ * @file chart_envelope.h
+ * @brief Multi-resolution min/max sample history for zoomed out graph views
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __CHART_ENVELOPE_H__
+#define __CHART_ENVELOPE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+#include "chart_history.h"
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define CHART_ENVELOPE_LEVELS_MAX 6
+
+/* Each column of a level is stored as its minimum then its maximum, so a
+ * line graph of a level's points draws the envelope of the samples
+ */
+#define CHART_ENVELOPE_POINTS_PER_COLUMN 2
+
+struct chart_envelope_level {
+	/* Columns for each axis, a circular buffer of columns * 2 points */
+	int16_t *axis[CHART_HISTORY_AXIS_COUNT];
+	/* Column the next completed column is written to, which is also the
+	 * oldest column once the level is full
+	 */
+	uint16_t next;
+	/* Inputs (samples for the first level, columns of the level below
+	 * for the others) merged into the column being built
+	 */
+	uint8_t pending;
+	int16_t min[CHART_HISTORY_AXIS_COUNT];
+	int16_t max[CHART_HISTORY_AXIS_COUNT];
+};
+
+struct chart_envelope {
+	struct chart_envelope_level level[CHART_ENVELOPE_LEVELS_MAX];
+	uint8_t levels;
+	uint8_t factor;
+	uint16_t columns;
+	/* Value of points which have not been written since the envelope was
+	 * cleared
+	 */
+	int16_t empty;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up an empty envelope. Each column of the first level covers
+ *        factor samples, and each column of the following levels covers
+ *        factor columns of the level below
+ *
+ * @param envelope Envelope to set up
+ * @param buffer Storage for levels * CHART_HISTORY_AXIS_COUNT * columns *
+ *               CHART_ENVELOPE_POINTS_PER_COLUMN points
+ * @param columns Number of columns kept in each level
+ * @param levels Number of levels, up to CHART_ENVELOPE_LEVELS_MAX
+ * @param factor Number of inputs merged into each column
+ * @param empty Value held by points with no samples
+ *
+ * @retval 0 on success, -EINVAL if the number of levels or factor is out of
+ *         range
+ */
+int ChartEnvelopeInit(struct chart_envelope *envelope, int16_t *buffer,
+		      uint16_t columns, uint8_t levels, uint8_t factor,
+		      int16_t empty);
+
+/**
+ * @brief Removes all samples from the envelope
+ *
+ * @param envelope Envelope to clear
+ */
+void ChartEnvelopeClear(struct chart_envelope *envelope);
+
+/**
+ * @brief Adds a sample to the column being built in the first level. When a
+ *        column is complete it is written and merged into the next level,
+ *        so the average cost per sample is constant
+ *
+ * @param envelope Envelope to add to
+ * @param values X, Y and Z values of the sample
+ */
+void ChartEnvelopeAdd(struct chart_envelope *envelope, const int16_t *values);
+
+/**
+ * @brief Gets the number of samples each column of a level covers
+ *
+ * @param envelope Envelope to check
+ * @param level Level to check
+ *
+ * @retval Samples per column
+ */
+uint32_t ChartEnvelopeSamplesPerColumn(const struct chart_envelope *envelope,
+				       uint8_t level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CHART_ENVELOPE_H__ */
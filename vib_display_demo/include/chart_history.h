@@ -0,0 +1,114 @@
+/**
+ * @file chart_history.h
+ * @brief Circular sample history for the vibration display graph
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __CHART_HISTORY_H__
+#define __CHART_HISTORY_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define CHART_HISTORY_AXIS_COUNT 3
+
+/* Samples are stored as one array per axis so that a graph series is a
+ * single contiguous (wrapped) run of values, which the graph can draw from
+ * directly
+ */
+struct chart_history {
+	int16_t *axis[CHART_HISTORY_AXIS_COUNT];
+	uint16_t size;
+	/* Value of positions which have not been written since the history
+	 * was cleared
+	 */
+	int16_t empty;
+	/* Position the next sample is written to, which is also the oldest
+	 * sample once the history is full
+	 */
+	uint16_t next;
+	uint16_t count;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up an empty history
+ *
+ * @param history History to set up
+ * @param buffer Storage for CHART_HISTORY_AXIS_COUNT * size samples
+ * @param size Number of samples kept for each axis
+ * @param empty Value held by positions with no sample
+ */
+void ChartHistoryInit(struct chart_history *history, int16_t *buffer,
+		      uint16_t size, int16_t empty);
+
+/**
+ * @brief Removes all samples from the history, setting every position to
+ *        the empty value
+ *
+ * @param history History to clear
+ */
+void ChartHistoryClear(struct chart_history *history);
+
+/**
+ * @brief Adds a sample, replacing the oldest once the history is full. The
+ *        cost does not depend on the history size
+ *
+ * @param history History to add to
+ * @param values X, Y and Z values of the sample
+ */
+void ChartHistoryAdd(struct chart_history *history, const int16_t *values);
+
+/**
+ * @brief Gets the number of samples held
+ *
+ * @param history History to check
+ *
+ * @retval Samples held, up to the history size
+ */
+static inline uint16_t ChartHistoryCount(const struct chart_history *history)
+{
+	return history->count;
+}
+
+/**
+ * @brief Gets a held sample value
+ *
+ * @param history History to read
+ * @param axis Axis to get, 0 to CHART_HISTORY_AXIS_COUNT - 1
+ * @param index Sample to get, 0 being the oldest and
+ *              ChartHistoryCount() - 1 the newest
+ *
+ * @retval Sample value
+ */
+static inline int16_t ChartHistoryGet(const struct chart_history *history,
+				      uint8_t axis, uint16_t index)
+{
+	uint32_t position = (uint32_t)history->next + history->size -
+			    history->count + index;
+
+	if (position >= history->size) {
+		position -= history->size;
+	}
+
+	return history->axis[axis][position];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CHART_HISTORY_H__ */
@@ -24,6 +24,8 @@ extern "C" {
 #include <sys/byteorder.h>
 #include <zephyr.h>
 
+#include "application.h"
+
 #ifdef CONFIG_DISPLAY
 
 /******************************************************************************/
@@ -46,6 +48,31 @@ struct lcd_event_s {
 #define LCD_EVENT_MESSAGE_QUEUE_EVENTS 2
 #define LCD_EVENT_MESSAGE_QUEUE_ALIGNMENT 4
 
+struct lcd_stats {
+	/* Frames rendered */
+	uint32_t frames;
+	/* Frames which took longer than the frame period, the frames which
+	 * were due in that time are skipped
+	 */
+	uint32_t late_frames;
+	/* Time taken by the latest frame to add the queued samples to the
+	 * graph and run LVGL in us
+	 */
+	uint32_t frame_us;
+	/* Largest frame time in us */
+	uint32_t max_frame_us;
+	/* Samples added to the graph */
+	uint32_t samples;
+	/* Samples dropped because the queue to the render thread was full */
+	uint32_t dropped;
+	/* Time from the oldest sample of the latest frame being read to the
+	 * end of the frame in us
+	 */
+	uint32_t latency_us;
+	/* Largest sample to display time in us */
+	uint32_t max_latency_us;
+};
+
 /******************************************************************************/
 /* Global Data Definitions                                                    */
 /******************************************************************************/
@@ -55,7 +82,8 @@ extern struct k_msgq lcd_event_queue;
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
 /**
- * @brief Sets up the LCD for use
+ * @brief Sets up the LCD for use and starts the render thread, which runs
+ *        LVGL at CONFIG_APP_LCD_FRAME_RATE_HZ
  */
 void SetupLCD(void);
 
@@ -67,13 +95,35 @@ void SetupLCD(void);
 bool IsLCDPresent(void);
 
 /**
- * @brief Updates the current graph results
+ * @brief Queues a sample to be added to the graph on the next frame. This
+ *        does not block or take a lock, but must only be called from one
+ *        thread
+ *
+ * @param sample X, Y and Z readings in 0.001 g units and the time they were
+ *               read
+ */
+void UpdateLCDGraph(const struct accel_sample *sample);
+
+/**
+ * @brief Gets the render thread frame and sample latency statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void LCDGetStats(struct lcd_stats *stats);
+
+/**
+ * @brief Clears the render thread statistics
+ */
+void LCDResetStats(void);
+
+/**
+ * @brief Gets the memory used by the graph history, zoom envelope and
+ *        empty series arrays, which is set by CONFIG_APP_LCD_DATA_POINTS
+ *        and the zoom settings
  *
- * @param X co-ordinate data in 0.001 g units
- * @param Y co-ordinate data in 0.001 g units
- * @param X co-ordinate data in 0.001 g units
+ * @retval Size in bytes
  */
-void UpdateLCDGraph(int16_t x, int16_t y, int16_t z);
+size_t LCDGetBufferSize(void);
 
 #endif
 
@@ -0,0 +1,44 @@
+/**
+ * @file lcd_headless.h
+ * @brief Headless display render benchmark for vibration display demo on
+ *        native_posix
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCD_HEADLESS_H__
+#define __LCD_HEADLESS_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Draws the default display into an in-memory framebuffer, measures
+ *        each refresh and registers the scripted touch input. Must be
+ *        called before SetupLCD
+ */
+void LCDHeadlessInit(void);
+
+/**
+ * @brief Adds a built in test signal to the graph every
+ *        APPLICATION_POINT_PERIOD_US in place of the sensor, does not
+ *        return. The application exits once the number of refreshes given
+ *        with --headless-frames have been measured
+ */
+void LCDHeadlessRun(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCD_HEADLESS_H__ */
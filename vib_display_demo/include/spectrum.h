@@ -0,0 +1,109 @@
+/**
+ * @file spectrum.h
+ * @brief Sliding window FFT spectrum for the vibration display graph
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SPECTRUM_H__
+#define __SPECTRUM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+#include "application.h"
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Bin 0 (DC) is not shown, bins 1 to CONFIG_APP_LCD_SPECTRUM_SAMPLES / 2
+ * are
+ */
+#define SPECTRUM_BINS (CONFIG_APP_LCD_SPECTRUM_SAMPLES / 2)
+
+/* Bin amplitudes are limited to the accelerometer range */
+#define SPECTRUM_AMPLITUDE_MAX_MG 4000
+
+struct spectrum_stats {
+	/* Spectra calculated */
+	uint32_t spectra;
+	/* Time taken to calculate the latest spectrum of all three axes */
+	uint32_t compute_us;
+	uint32_t max_compute_us;
+	/* Window copies repeated because the sensor overwrote part of the
+	 * window while it was being copied
+	 */
+	uint32_t retries;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Sets up the FFT and starts the spectrum thread, which calculates a
+ *        spectrum each time one is requested by SpectrumUpdate
+ *
+ * @retval 0 on success, -EINVAL if the window length is not supported by
+ *         the FFT
+ */
+int SpectrumInit(void);
+
+/**
+ * @brief Adds a sample to the sliding window. This does not block or take
+ *        a lock, but must only be called from one thread
+ *
+ * @param mg X, Y and Z readings in 0.001 g units
+ */
+void SpectrumAddSample(const int16_t *mg);
+
+/**
+ * @brief Shows the latest spectrum if the spectrum thread has finished one
+ *        and requests the next. Called from the render thread each frame
+ *        while the spectrum is shown, so the spectrum is only calculated
+ *        while it is being looked at
+ *
+ * @retval true if a new spectrum is shown
+ */
+bool SpectrumUpdate(void);
+
+/**
+ * @brief Gets the bin amplitudes of the shown spectrum, which stay
+ *        unchanged until SpectrumUpdate next returns true
+ *
+ * @param axis Axis to get, 0 to SAMPLE_AXIS_COUNT - 1
+ *
+ * @retval SPECTRUM_BINS amplitudes in 0.001 g units, lowest frequency first
+ */
+int16_t *SpectrumGetAxis(uint8_t axis);
+
+/**
+ * @brief Gets the largest bin amplitude of the shown spectrum
+ *
+ * @retval Amplitude in 0.001 g units
+ */
+int16_t SpectrumGetPeak(void);
+
+/**
+ * @brief Gets the spectrum calculation statistics
+ *
+ * @param stats Set to the current statistics
+ */
+void SpectrumGetStats(struct spectrum_stats *stats);
+
+/**
+ * @brief Clears the spectrum calculation statistics
+ */
+void SpectrumResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPECTRUM_H__ */
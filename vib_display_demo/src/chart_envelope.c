@@ -0,0 +1,148 @@
+/**
+ * @file chart_envelope.c
+ * @brief Multi-resolution min/max sample history for zoomed out graph views
+ *
+ * Rather than keeping every sample and reducing them when a view is drawn,
+ * each level is built incrementally: samples are merged into the minimum
+ * and maximum of the first level's current column, and each completed
+ * column is merged into the current column of the next level. A view of
+ * any length is therefore always the same number of points.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <errno.h>
+
+#include "chart_envelope.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define ENVELOPE_MIN 0
+#define ENVELOPE_MAX 1
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int ChartEnvelopeInit(struct chart_envelope *envelope, int16_t *buffer,
+		      uint16_t columns, uint8_t levels, uint8_t factor,
+		      int16_t empty)
+{
+	uint32_t points = (uint32_t)columns * CHART_ENVELOPE_POINTS_PER_COLUMN;
+	uint8_t level = 0;
+	uint8_t axis;
+
+	if (levels == 0 || levels > CHART_ENVELOPE_LEVELS_MAX || factor < 2) {
+		return -EINVAL;
+	}
+
+	while (level < levels) {
+		for (axis = 0; axis < CHART_HISTORY_AXIS_COUNT; ++axis) {
+			envelope->level[level].axis[axis] = buffer;
+			buffer += points;
+		}
+		++level;
+	}
+
+	envelope->levels = levels;
+	envelope->factor = factor;
+	envelope->columns = columns;
+	envelope->empty = empty;
+	ChartEnvelopeClear(envelope);
+
+	return 0;
+}
+
+void ChartEnvelopeClear(struct chart_envelope *envelope)
+{
+	uint32_t points =
+		(uint32_t)envelope->columns * CHART_ENVELOPE_POINTS_PER_COLUMN;
+	uint32_t i;
+	uint8_t level = 0;
+	uint8_t axis;
+
+	while (level < envelope->levels) {
+		for (axis = 0; axis < CHART_HISTORY_AXIS_COUNT; ++axis) {
+			for (i = 0; i < points; ++i) {
+				envelope->level[level].axis[axis][i] =
+					envelope->empty;
+			}
+		}
+
+		envelope->level[level].next = 0;
+		envelope->level[level].pending = 0;
+		++level;
+	}
+}
+
+void ChartEnvelopeAdd(struct chart_envelope *envelope, const int16_t *values)
+{
+	struct chart_envelope_level *current;
+	const int16_t *min = values;
+	const int16_t *max = values;
+	uint32_t point;
+	uint8_t level = 0;
+	uint8_t axis;
+
+	while (level < envelope->levels) {
+		current = &envelope->level[level];
+
+		/* Merge the input into the column being built */
+		for (axis = 0; axis < CHART_HISTORY_AXIS_COUNT; ++axis) {
+			if (current->pending == 0 ||
+			    min[axis] < current->min[axis]) {
+				current->min[axis] = min[axis];
+			}
+
+			if (current->pending == 0 ||
+			    max[axis] > current->max[axis]) {
+				current->max[axis] = max[axis];
+			}
+		}
+
+		++current->pending;
+		if (current->pending < envelope->factor) {
+			return;
+		}
+
+		/* The column is complete, write it over the oldest and pass
+		 * it on to the next level
+		 */
+		point = (uint32_t)current->next * CHART_ENVELOPE_POINTS_PER_COLUMN;
+		for (axis = 0; axis < CHART_HISTORY_AXIS_COUNT; ++axis) {
+			current->axis[axis][point + ENVELOPE_MIN] =
+				current->min[axis];
+			current->axis[axis][point + ENVELOPE_MAX] =
+				current->max[axis];
+		}
+
+		++current->next;
+		if (current->next == envelope->columns) {
+			current->next = 0;
+		}
+
+		current->pending = 0;
+		min = current->min;
+		max = current->max;
+		++level;
+	}
+}
+
+uint32_t ChartEnvelopeSamplesPerColumn(const struct chart_envelope *envelope,
+				       uint8_t level)
+{
+	uint32_t samples = envelope->factor;
+
+	while (level > 0) {
+		samples *= envelope->factor;
+		--level;
+	}
+
+	return samples;
+}
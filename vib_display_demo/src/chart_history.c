@@ -0,0 +1,68 @@
+/**
+ * @file chart_history.c
+ * @brief Circular sample history for the vibration display graph
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+
+#include "chart_history.h"
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void ChartHistoryInit(struct chart_history *history, int16_t *buffer,
+		      uint16_t size, int16_t empty)
+{
+	uint8_t i = 0;
+
+	while (i < CHART_HISTORY_AXIS_COUNT) {
+		history->axis[i] = &buffer[i * size];
+		++i;
+	}
+
+	history->size = size;
+	history->empty = empty;
+	ChartHistoryClear(history);
+}
+
+void ChartHistoryClear(struct chart_history *history)
+{
+	uint16_t i;
+	uint8_t axis = 0;
+
+	while (axis < CHART_HISTORY_AXIS_COUNT) {
+		for (i = 0; i < history->size; ++i) {
+			history->axis[axis][i] = history->empty;
+		}
+		++axis;
+	}
+
+	history->next = 0;
+	history->count = 0;
+}
+
+void ChartHistoryAdd(struct chart_history *history, const int16_t *values)
+{
+	uint8_t i = 0;
+
+	while (i < CHART_HISTORY_AXIS_COUNT) {
+		history->axis[i][history->next] = values[i];
+		++i;
+	}
+
+	++history->next;
+	if (history->next == history->size) {
+		history->next = 0;
+	}
+
+	if (history->count < history->size) {
+		++history->count;
+	}
+}
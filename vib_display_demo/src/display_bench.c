@@ -0,0 +1,280 @@
+/**
+ * @file display_bench.c
+ * @brief Shell benchmarks for vibration display demo graph handling
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <shell/shell.h>
+
+#include "cycles.h"
+#include "chart_history.h"
+#include "chart_envelope.h"
+#include "stream_stats.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define BENCH_CHART_SAMPLES 1024
+#define BENCH_CHART_MAX_POINTS 2000
+#define BENCH_CHART_SAMPLE_MG 1000
+#define BENCH_HISTORY_POINTS (CHART_HISTORY_AXIS_COUNT * BENCH_CHART_MAX_POINTS)
+#define BENCH_ENVELOPE_POINTS                                                  \
+	(CONFIG_APP_LCD_ZOOM_LEVELS * CHART_HISTORY_AXIS_COUNT *               \
+	 CONFIG_APP_LCD_ZOOM_COLUMNS * CHART_ENVELOPE_POINTS_PER_COLUMN)
+#define BENCH_STATS_SAMPLES 1024
+#define BENCH_STATS_MAX_WINDOW 800
+#define BENCH_STATS_EWMA_SHIFT 5
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const uint16_t bench_chart_points[] = { 10,  40,   100, 250,
+					       500, 1000, BENCH_CHART_MAX_POINTS };
+
+static const uint16_t bench_stats_windows[] = { 10, 40, 120,
+						BENCH_STATS_MAX_WINDOW };
+
+static int16_t bench_buffer[MAX(BENCH_HISTORY_POINTS, BENCH_ENVELOPE_POINTS)];
+static struct stream_minmax_entry bench_minmax[2 * BENCH_STATS_MAX_WINDOW];
+/* Statistics read in the timed loops, so they are not optimised away */
+static volatile int16_t bench_result;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void bench_shift_add(uint16_t points, const int16_t *values);
+static int16_t bench_loop_mean(uint16_t size, uint16_t position,
+			       int16_t value);
+static int16_t bench_stats_sample(uint32_t i);
+static int cmd_bench_chart(const struct shell *shell, size_t argc,
+			   char **argv);
+static int cmd_bench_stats(const struct shell *shell, size_t argc,
+			   char **argv);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Adds a sample the way the graph history was kept before the
+ *  circular history, moving every buffered sample down by one position.
+ */
+static void bench_shift_add(uint16_t points, const int16_t *values)
+{
+	uint8_t i = 0;
+
+	while (i < CHART_HISTORY_AXIS_COUNT) {
+		int16_t *axis = &bench_buffer[i * points];
+
+		memmove(axis, &axis[1], (points - 1) * sizeof(axis[0]));
+		axis[points - 1] = values[i];
+		++i;
+	}
+}
+
+/** @brief Adds a sample and takes the mean the way motion detection did
+ *  before the streaming statistics, summing the whole window each time.
+ */
+static int16_t bench_loop_mean(uint16_t size, uint16_t position,
+			       int16_t value)
+{
+	int32_t sum = 0;
+	uint16_t i;
+
+	bench_buffer[position] = value;
+	for (i = 0; i < size; ++i) {
+		sum += bench_buffer[i];
+	}
+
+	return (int16_t)(sum / size);
+}
+
+/** @brief Sawtooth with a period which is not a multiple of any window, so
+ *  the minimum and maximum queues see both rising and falling runs.
+ */
+static int16_t bench_stats_sample(uint32_t i)
+{
+	return (int16_t)(((i * 37) % 997) - 500);
+}
+
+static int cmd_bench_chart(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	struct chart_history history;
+	struct chart_envelope envelope;
+	int16_t values[CHART_HISTORY_AXIS_COUNT] = { 0, 0,
+						     BENCH_CHART_SAMPLE_MG };
+	uint32_t start;
+	uint32_t shift_cycles;
+	uint32_t ring_cycles;
+	uint32_t i;
+	uint8_t depth = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	CyclesInit();
+
+	shell_print(shell, "Graph history update, cycles/sample:");
+	shell_print(shell, "  points  shift   ring");
+
+	while (depth < ARRAY_SIZE(bench_chart_points)) {
+		uint16_t points = bench_chart_points[depth];
+
+		memset(bench_buffer, 0, sizeof(bench_buffer));
+
+		start = CyclesGet();
+		for (i = 0; i < BENCH_CHART_SAMPLES; ++i) {
+			values[0] = (int16_t)i;
+			bench_shift_add(points, values);
+		}
+		shift_cycles = CyclesGet() - start;
+
+		/* Start from a full history so that every add wraps around
+		 * the oldest sample, as it does when the graph is running
+		 */
+		ChartHistoryInit(&history, bench_buffer, points, 0);
+		for (i = 0; i < points; ++i) {
+			ChartHistoryAdd(&history, values);
+		}
+
+		start = CyclesGet();
+		for (i = 0; i < BENCH_CHART_SAMPLES; ++i) {
+			values[0] = (int16_t)i;
+			ChartHistoryAdd(&history, values);
+		}
+		ring_cycles = CyclesGet() - start;
+
+		shell_print(shell, "  %6u %6u %6u", points,
+			    shift_cycles / BENCH_CHART_SAMPLES,
+			    ring_cycles / BENCH_CHART_SAMPLES);
+		++depth;
+	}
+
+	/* The zoomed out views are built as samples arrive, so their cost
+	 * is per sample whatever period they cover
+	 */
+	(void)ChartEnvelopeInit(&envelope, bench_buffer,
+				CONFIG_APP_LCD_ZOOM_COLUMNS,
+				CONFIG_APP_LCD_ZOOM_LEVELS,
+				CONFIG_APP_LCD_ZOOM_FACTOR, 0);
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_CHART_SAMPLES; ++i) {
+		values[0] = (int16_t)i;
+		ChartEnvelopeAdd(&envelope, values);
+	}
+	ring_cycles = CyclesGet() - start;
+
+	shell_print(shell, "Zoom envelope, %u levels: %u cycles/sample",
+		    CONFIG_APP_LCD_ZOOM_LEVELS, ring_cycles / BENCH_CHART_SAMPLES);
+
+	return 0;
+}
+
+static int cmd_bench_stats(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	struct stream_window window;
+	struct stream_variance variance;
+	struct stream_ewma ewma;
+	struct stream_minmax minmax;
+	uint32_t start;
+	uint32_t loop_cycles;
+	uint32_t window_cycles;
+	uint32_t minmax_cycles;
+	uint32_t variance_cycles;
+	uint32_t ewma_cycles;
+	uint32_t i;
+	uint8_t size = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	CyclesInit();
+
+	shell_print(shell, "Streaming statistics update, cycles/sample:");
+	shell_print(shell, "  window   loop   mean minmax");
+
+	while (size < ARRAY_SIZE(bench_stats_windows)) {
+		uint16_t samples = bench_stats_windows[size];
+
+		memset(bench_buffer, 0, samples * sizeof(bench_buffer[0]));
+
+		start = CyclesGet();
+		for (i = 0; i < BENCH_STATS_SAMPLES; ++i) {
+			bench_result = bench_loop_mean(samples, i % samples,
+						       bench_stats_sample(i));
+		}
+		loop_cycles = CyclesGet() - start;
+
+		StreamWindowInit(&window, bench_buffer, samples);
+
+		start = CyclesGet();
+		for (i = 0; i < BENCH_STATS_SAMPLES; ++i) {
+			StreamWindowAdd(&window, bench_stats_sample(i));
+			bench_result = StreamWindowMean(&window);
+		}
+		window_cycles = CyclesGet() - start;
+
+		StreamMinMaxInit(&minmax, bench_minmax, samples);
+
+		start = CyclesGet();
+		for (i = 0; i < BENCH_STATS_SAMPLES; ++i) {
+			StreamMinMaxAdd(&minmax, bench_stats_sample(i));
+			bench_result = StreamMinMaxMax(&minmax);
+		}
+		minmax_cycles = CyclesGet() - start;
+
+		shell_print(shell, "  %6u %6u %6u %6u", samples,
+			    loop_cycles / BENCH_STATS_SAMPLES,
+			    window_cycles / BENCH_STATS_SAMPLES,
+			    minmax_cycles / BENCH_STATS_SAMPLES);
+		++size;
+	}
+
+	/* Neither has a window, so the cost is the same for any period */
+	StreamVarianceReset(&variance);
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_STATS_SAMPLES; ++i) {
+		StreamVarianceAdd(&variance, bench_stats_sample(i));
+	}
+	variance_cycles = CyclesGet() - start;
+
+	StreamEwmaInit(&ewma, BENCH_STATS_EWMA_SHIFT);
+
+	start = CyclesGet();
+	for (i = 0; i < BENCH_STATS_SAMPLES; ++i) {
+		StreamEwmaAdd(&ewma, bench_stats_sample(i));
+		bench_result = StreamEwmaGet(&ewma);
+	}
+	ewma_cycles = CyclesGet() - start;
+
+	shell_print(shell, "Welford variance: %u cycles/sample",
+		    variance_cycles / BENCH_STATS_SAMPLES);
+	shell_print(shell, "EWMA: %u cycles/sample",
+		    ewma_cycles / BENCH_STATS_SAMPLES);
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Shell Command Registration                                                 */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	bench_cmds,
+	SHELL_CMD(chart, NULL, "Graph history update against depth",
+		  cmd_bench_chart),
+	SHELL_CMD(stats, NULL, "Streaming statistics update against window",
+		  cmd_bench_stats),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(bench, &bench_cmds, "Vibration display demo benchmarks",
+		   NULL);
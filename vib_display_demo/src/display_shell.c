@@ -0,0 +1,96 @@
+/**
+ * @file display_shell.c
+ * @brief Shell commands for vibration display demo statistics
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+
+#include "application.h"
+#include "lcd.h"
+#ifdef CONFIG_APP_LCD_SPECTRUM
+#include "spectrum.h"
+#endif
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int cmd_vib_stats(const struct shell *shell, size_t argc, char **argv);
+static int cmd_vib_reset(const struct shell *shell, size_t argc, char **argv);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int cmd_vib_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	struct acquisition_stats acquisition;
+	struct lcd_stats lcd;
+#ifdef CONFIG_APP_LCD_SPECTRUM
+	struct spectrum_stats spectrum;
+#endif
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	ApplicationGetStats(&acquisition);
+	LCDGetStats(&lcd);
+
+	shell_print(shell, "Samples: %u at %u Hz", acquisition.samples,
+		    CONFIG_APP_SAMPLE_RATE_HZ);
+	shell_print(shell, "Overrun samples: %u", acquisition.overruns);
+	shell_print(shell, "Late samples: %u", acquisition.late);
+	shell_print(shell, "Max sample interval: %u us",
+		    acquisition.max_interval_us);
+	shell_print(shell, "Frames: %u (%u late), target %u fps", lcd.frames,
+		    lcd.late_frames, CONFIG_APP_LCD_FRAME_RATE_HZ);
+	shell_print(shell, "Frame time: %u us (max %u us)", lcd.frame_us,
+		    lcd.max_frame_us);
+	shell_print(shell, "Samples drawn: %u, dropped: %u", lcd.samples,
+		    lcd.dropped);
+	shell_print(shell, "Sample to display: %u us (max %u us)",
+		    lcd.latency_us, lcd.max_latency_us);
+#ifdef CONFIG_APP_LCD_SPECTRUM
+	SpectrumGetStats(&spectrum);
+	shell_print(shell, "Spectra: %u, window copy retries: %u",
+		    spectrum.spectra, spectrum.retries);
+	shell_print(shell, "Spectrum time: %u us (max %u us)",
+		    spectrum.compute_us, spectrum.max_compute_us);
+#endif
+
+	return 0;
+}
+
+static int cmd_vib_reset(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	ApplicationResetStats();
+	LCDResetStats();
+#ifdef CONFIG_APP_LCD_SPECTRUM
+	SpectrumResetStats();
+#endif
+	shell_print(shell, "Statistics cleared");
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Shell Command Registration                                                 */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	vib_cmds,
+	SHELL_CMD(stats, NULL, "Show sampling and rendering statistics",
+		  cmd_vib_stats),
+	SHELL_CMD(reset, NULL, "Clear sampling and rendering statistics",
+		  cmd_vib_reset),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(vib, &vib_cmds, "Vibration display demo commands", NULL);
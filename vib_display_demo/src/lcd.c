@@ -10,10 +10,21 @@
 /******************************************************************************/
 /* Includes                                                                   */
 /******************************************************************************/
+#include <string.h>
 #include <logging/log.h>
 #include <drivers/display.h>
 
 #include "lcd.h"
+#include "application.h"
+#include "chart_history.h"
+#include "chart_envelope.h"
+#include "sample_ring.h"
+#ifdef CONFIG_LVGL_ASYNC_FLUSH
+#include "lvgl_async_flush.h"
+#endif
+#ifdef CONFIG_APP_LCD_SPECTRUM
+#include "spectrum.h"
+#endif
 
 #ifdef CONFIG_DISPLAY
 
@@ -22,7 +33,10 @@ LOG_MODULE_REGISTER(lcd);
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
-#define DISPLAY_INPUT_PERIOD_MS 25
+#define RENDER_STACK_SIZE 4096
+#define RENDER_PRIORITY 10
+/* Over a second of graph points at the default sample rate and reduction */
+#define RENDER_QUEUE_SAMPLES 64
 #define CHART_WIDTH 220
 #define CHART_HEIGHT 120
 #define CHART_Y_PRIMARY_MIN -4000
@@ -34,6 +48,41 @@ LOG_MODULE_REGISTER(lcd);
 #define CONTAINER_PADDING 5
 #define STARTSTOP_BUTTON_START_TEXT "Start"
 #define STARTSTOP_BUTTON_STOP_TEXT "Stop"
+#define MODE_BUTTON_SPECTRUM_TEXT "FFT"
+#define MODE_BUTTON_TIME_TEXT "Time"
+#define CHART_X_TICK_TEXT "old\nnew"
+#define CHART_Y_TICK_TEXT "4\n2\n0\n-2\n-4"
+#define CHART_AXIS_X 0
+#define CHART_AXIS_Y 1
+#define CHART_AXIS_Z 2
+#define CHART_ZOOM_POINTS                                                      \
+	(CONFIG_APP_LCD_ZOOM_COLUMNS * CHART_ENVELOPE_POINTS_PER_COLUMN)
+#ifdef CONFIG_APP_LCD_SPECTRUM
+#define CHART_SPECTRUM_POINTS SPECTRUM_BINS
+#else
+#define CHART_SPECTRUM_POINTS 0
+#endif
+#define CHART_EMPTY_POINTS                                                     \
+	MAX(MAX(CONFIG_APP_LCD_DATA_POINTS, CHART_ZOOM_POINTS),                \
+	    CHART_SPECTRUM_POINTS)
+#define ZOOM_TEXT_MAX_LENGTH 24
+#define SPAN_DECIMAL_LIMIT_MS 10000
+#define SPAN_SECONDS_LIMIT_MS 120000
+#define SPAN_MINUTES_LIMIT_MS 7200000
+#define MS_PER_MINUTE 60000
+#define MS_PER_HOUR 3600000
+#define MS_PER_DECISECOND 100
+#define SPECTRUM_TICK_TEXT_MAX_LENGTH 16
+/* A smaller spectrum scale is only used once the peak is this far inside
+ * it, so the scale does not flick between two ranges
+ */
+#define SPECTRUM_SCALE_DOWN_PERCENT 80
+#define PERCENT 100
+
+struct spectrum_scale {
+	int16_t max_mg;
+	const char *tick_text;
+};
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
@@ -53,25 +102,84 @@ static lv_obj_t *ui_check_y;
 static lv_obj_t *ui_check_z;
 static lv_obj_t *ui_button_startstop;
 static lv_obj_t *ui_button_clear;
+static lv_obj_t *ui_button_zoom;
 static lv_obj_t *ui_text_startstop;
 static lv_obj_t *ui_text_clear;
+static lv_obj_t *ui_text_zoom;
+#ifdef CONFIG_APP_LCD_SPECTRUM
+static lv_obj_t *ui_button_mode;
+static lv_obj_t *ui_text_mode;
+#endif
 
-static int16_t chart_data_buffer_x[CONFIG_APP_LCD_DATA_POINTS];
-static int16_t chart_data_buffer_y[CONFIG_APP_LCD_DATA_POINTS];
-static int16_t chart_data_buffer_z[CONFIG_APP_LCD_DATA_POINTS];
-static uint8_t chart_readings = 0;
+/* The graph series draw directly from the history, or from a level of the
+ * envelope when zoomed out. Series of unticked axes draw from an array of
+ * empty points instead
+ */
+static int16_t chart_history_buffer[CHART_HISTORY_AXIS_COUNT *
+				   CONFIG_APP_LCD_DATA_POINTS];
+static struct chart_history chart_history;
+static int16_t chart_envelope_buffer[CONFIG_APP_LCD_ZOOM_LEVELS *
+				    CHART_HISTORY_AXIS_COUNT *
+				    CHART_ZOOM_POINTS];
+static struct chart_envelope chart_envelope;
+static lv_coord_t chart_empty_points[CHART_EMPTY_POINTS];
+
+/* 0 shows the history, 1 onwards the envelope levels */
+static uint8_t chart_zoom;
+
+/* The same chart and series show the spectrum, drawing from its bins */
+static bool chart_spectrum;
+
+#ifdef CONFIG_APP_LCD_SPECTRUM
+/* Amplitude ranges of the spectrum, labelled in g as the history is */
+static const struct spectrum_scale spectrum_scales[] = {
+	{ 100, "0.1\n0.05\n0" }, { 200, "0.2\n0.1\n0" },
+	{ 500, "0.5\n0.25\n0" }, { 1000, "1\n0.5\n0" },
+	{ 2000, "2\n1\n0" },     { SPECTRUM_AMPLITUDE_MAX_MG, "4\n2\n0" },
+};
+static uint8_t spectrum_scale;
+
+/* Set from the sample rate, the chart keeps a pointer to the tick text */
+static char spectrum_tick_text[SPECTRUM_TICK_TEXT_MAX_LENGTH];
+static char spectrum_range_text[ZOOM_TEXT_MAX_LENGTH];
+#endif
+
+BUILD_ASSERT(sizeof(lv_coord_t) == sizeof(int16_t),
+	     "Graph points must be the same size as history samples");
+
+/* Points from the sensor handler, which only the render thread adds to the
+ * graph as LVGL is not thread safe
+ */
+SAMPLE_RING_DEFINE(render_queue, struct accel_sample, RENDER_QUEUE_SAMPLES);
+
+static struct lcd_stats render_stats;
+static uint32_t render_dropped_base;
+static struct k_spinlock render_stats_lock;
+
+K_THREAD_STACK_DEFINE(render_stack_area, RENDER_STACK_SIZE);
+static struct k_thread render_thread_data;
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
+static void chart_bind_series(lv_chart_series_t *series, uint8_t axis,
+			      bool visible);
+static void chart_bind_all_series(void);
+static void chart_set_start_points(void);
+static void chart_add_sample(const struct accel_sample *sample);
+static uint16_t chart_point_count(void);
+static void chart_set_zoom(uint8_t zoom);
+static void zoom_text(char *text, size_t size, uint32_t span_ms);
+#ifdef CONFIG_APP_LCD_SPECTRUM
+static void chart_set_spectrum(bool spectrum);
+static void chart_set_spectrum_scale(int16_t peak, bool force);
+#endif
 static void checkbox_event_handler(lv_obj_t *obj, lv_event_t event);
 static void button_event_handler(lv_obj_t *obj, lv_event_t event);
-static void lcd_display_update_handler(struct k_work *work);
-static void lcd_display_update_timer_handler(struct k_timer *dummy);
-
-K_WORK_DEFINE(lcd_display_update, lcd_display_update_handler);
-K_TIMER_DEFINE(lcd_display_update_timer, lcd_display_update_timer_handler,
-	       NULL);
+static int64_t render_deadline(int64_t start, int64_t frame);
+static void render_record(uint32_t frame_us, uint32_t samples,
+			  uint32_t latency_us, bool late);
+static void render_thread(void *unused1, void *unused2, void *unused3);
 
 K_MSGQ_DEFINE(lcd_event_queue, sizeof(struct lcd_event_s),
 	      LCD_EVENT_MESSAGE_QUEUE_EVENTS,
@@ -80,43 +188,232 @@ K_MSGQ_DEFINE(lcd_event_queue, sizeof(struct lcd_event_s),
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
+static void chart_bind_series(lv_chart_series_t *series, uint8_t axis,
+			      bool visible)
+{
+	int16_t *points;
+
+	if (!visible) {
+		points = (int16_t *)chart_empty_points;
+#ifdef CONFIG_APP_LCD_SPECTRUM
+	} else if (chart_spectrum) {
+		points = SpectrumGetAxis(axis);
+#endif
+	} else if (chart_zoom == 0) {
+		points = chart_history.axis[axis];
+	} else {
+		points = chart_envelope.level[chart_zoom - 1].axis[axis];
+	}
+
+	lv_chart_set_ext_array(ui_chart, series, (lv_coord_t *)points,
+			       chart_point_count());
+}
+
+static void chart_bind_all_series(void)
+{
+	chart_bind_series(chart_series_x, CHART_AXIS_X,
+			  lv_checkbox_is_checked(ui_check_x));
+	chart_bind_series(chart_series_y, CHART_AXIS_Y,
+			  lv_checkbox_is_checked(ui_check_y));
+	chart_bind_series(chart_series_z, CHART_AXIS_Z,
+			  lv_checkbox_is_checked(ui_check_z));
+}
+
+static void chart_set_start_points(void)
+{
+	uint16_t start;
+
+	/* The chart draws each series from its start point, wrapping around,
+	 * so starting at the next position to be written draws the oldest
+	 * sample first. Before the history is full the positions from there
+	 * to the end of the array are empty and are not drawn. The spectrum
+	 * is drawn in order
+	 */
+	if (chart_spectrum) {
+		start = 0;
+	} else if (chart_zoom == 0) {
+		start = chart_history.next;
+	} else {
+		start = chart_envelope.level[chart_zoom - 1].next *
+			CHART_ENVELOPE_POINTS_PER_COLUMN;
+	}
+
+	lv_chart_set_x_start_point(ui_chart, chart_series_x, start);
+	lv_chart_set_x_start_point(ui_chart, chart_series_y, start);
+	lv_chart_set_x_start_point(ui_chart, chart_series_z, start);
+}
+
+static uint16_t chart_point_count(void)
+{
+#ifdef CONFIG_APP_LCD_SPECTRUM
+	if (chart_spectrum) {
+		return SPECTRUM_BINS;
+	}
+#endif
+
+	return (chart_zoom == 0) ? CONFIG_APP_LCD_DATA_POINTS :
+				   CHART_ZOOM_POINTS;
+}
+
+static void chart_set_zoom(uint8_t zoom)
+{
+	char text[ZOOM_TEXT_MAX_LENGTH];
+	uint32_t span_ms;
+
+	chart_zoom = zoom;
+
+	/* The series are bound to external arrays, so this only changes the
+	 * number of points drawn
+	 */
+	lv_chart_set_point_count(ui_chart, chart_point_count());
+	chart_bind_all_series();
+	chart_set_start_points();
+
+	if (zoom == 0) {
+		span_ms = ((uint64_t)CONFIG_APP_LCD_DATA_POINTS *
+			   APPLICATION_POINT_PERIOD_US) /
+			  USEC_PER_MSEC;
+	} else {
+		span_ms = ((uint64_t)CONFIG_APP_LCD_ZOOM_COLUMNS *
+			   ChartEnvelopeSamplesPerColumn(&chart_envelope,
+							 zoom - 1) *
+			   APPLICATION_POINT_PERIOD_US) /
+			  USEC_PER_MSEC;
+	}
+
+	zoom_text(text, sizeof(text), span_ms);
+	lv_label_set_text(ui_text_zoom, text);
+
+	lv_chart_refresh(ui_chart);
+}
+
+static void zoom_text(char *text, size_t size, uint32_t span_ms)
+{
+	if (span_ms < SPAN_DECIMAL_LIMIT_MS) {
+		snprintf(text, size, "%u.%u s", span_ms / MSEC_PER_SEC,
+			 (span_ms % MSEC_PER_SEC) / MS_PER_DECISECOND);
+	} else if (span_ms < SPAN_SECONDS_LIMIT_MS) {
+		snprintf(text, size, "%u s", span_ms / MSEC_PER_SEC);
+	} else if (span_ms < SPAN_MINUTES_LIMIT_MS) {
+		snprintf(text, size, "%u min", span_ms / MS_PER_MINUTE);
+	} else {
+		snprintf(text, size, "%u h", span_ms / MS_PER_HOUR);
+	}
+}
+
+#ifdef CONFIG_APP_LCD_SPECTRUM
+static void chart_set_spectrum(bool spectrum)
+{
+	chart_spectrum = spectrum;
+
+	if (!spectrum) {
+		/* Back to the history at the zoom level shown before */
+		lv_chart_set_y_range(ui_chart, LV_CHART_AXIS_PRIMARY_Y,
+				     CHART_Y_PRIMARY_MIN, CHART_Y_PRIMARY_MAX);
+		lv_chart_set_x_tick_texts(ui_chart, CHART_X_TICK_TEXT, 1,
+					  LV_CHART_AXIS_DRAW_LAST_TICK);
+		lv_chart_set_y_tick_texts(ui_chart, CHART_Y_TICK_TEXT, 1,
+					  LV_CHART_AXIS_DRAW_LAST_TICK);
+		lv_btn_set_state(ui_button_zoom, LV_BTN_STATE_RELEASED);
+		lv_label_set_text(ui_text_mode, MODE_BUTTON_SPECTRUM_TEXT);
+		chart_set_zoom(chart_zoom);
+		return;
+	}
+
+	/* No objects are created, the series are pointed at the spectrum
+	 * bins and the axes relabelled. Zooming only applies to the history
+	 */
+	lv_chart_set_x_tick_texts(ui_chart, spectrum_tick_text, 1,
+				  LV_CHART_AXIS_DRAW_LAST_TICK);
+	chart_set_spectrum_scale(SpectrumGetPeak(), true);
+	lv_btn_set_state(ui_button_zoom, LV_BTN_STATE_DISABLED);
+	lv_label_set_text(ui_text_zoom, spectrum_range_text);
+	lv_label_set_text(ui_text_mode, MODE_BUTTON_TIME_TEXT);
+
+	lv_chart_set_point_count(ui_chart, chart_point_count());
+	chart_bind_all_series();
+	chart_set_start_points();
+
+	lv_chart_refresh(ui_chart);
+}
+
+static void chart_set_spectrum_scale(int16_t peak, bool force)
+{
+	uint8_t scale = spectrum_scale;
+
+	while ((scale < (ARRAY_SIZE(spectrum_scales) - 1)) &&
+	       (peak > spectrum_scales[scale].max_mg)) {
+		++scale;
+	}
+
+	while ((scale > 0) &&
+	       (peak < ((spectrum_scales[scale - 1].max_mg *
+			 SPECTRUM_SCALE_DOWN_PERCENT) /
+			PERCENT))) {
+		--scale;
+	}
+
+	if (force || (scale != spectrum_scale)) {
+		spectrum_scale = scale;
+		lv_chart_set_y_range(ui_chart, LV_CHART_AXIS_PRIMARY_Y, 0,
+				     spectrum_scales[scale].max_mg);
+		lv_chart_set_y_tick_texts(ui_chart,
+					  spectrum_scales[scale].tick_text, 1,
+					  LV_CHART_AXIS_DRAW_LAST_TICK);
+	}
+}
+#endif
+
+static void chart_add_sample(const struct accel_sample *sample)
+{
+	int16_t values[CHART_HISTORY_AXIS_COUNT];
+	uint8_t axis = 0;
+
+	/* Limit values to min and max graph values, this happens if there is a
+	 * large amount of movement
+	 */
+	while (axis < CHART_HISTORY_AXIS_COUNT) {
+		if (sample->mg[axis] > CHART_Y_PRIMARY_MAX) {
+			values[axis] = CHART_Y_PRIMARY_MAX;
+		} else if (sample->mg[axis] < CHART_Y_PRIMARY_MIN) {
+			values[axis] = CHART_Y_PRIMARY_MIN;
+		} else {
+			values[axis] = sample->mg[axis];
+		}
+		++axis;
+	}
+
+	/* Replace the oldest buffered data with the newest, the graph draws
+	 * from the history so only the start points need to move
+	 */
+	ChartHistoryAdd(&chart_history, values);
+	ChartEnvelopeAdd(&chart_envelope, values);
+}
+
 static void checkbox_event_handler(lv_obj_t *obj, lv_event_t event)
 {
 	/* Only process events where a checkbox has been ticked or unticked */
 	if (event == LV_EVENT_VALUE_CHANGED) {
 		lv_chart_series_t *series = NULL;
-		int16_t *chart_data = NULL;
+		uint8_t axis = 0;
 
 		if (obj == ui_check_x) {
 			series = chart_series_x;
-			chart_data = chart_data_buffer_x;
+			axis = CHART_AXIS_X;
 		} else if (obj == ui_check_y) {
 			series = chart_series_y;
-			chart_data = chart_data_buffer_y;
+			axis = CHART_AXIS_Y;
 		} else if (obj == ui_check_z) {
 			series = chart_series_z;
-			chart_data = chart_data_buffer_z;
+			axis = CHART_AXIS_Z;
 		}
 
 		if (series != NULL) {
-			if (lv_checkbox_is_checked(obj)) {
-				/* Checkbox was ticked, add the data to the
-				 * graph
-				 */
-				uint8_t i = CONFIG_APP_LCD_DATA_POINTS -
-					    chart_readings;
-				while (i < CONFIG_APP_LCD_DATA_POINTS) {
-					lv_chart_set_next(ui_chart, series,
-							  chart_data[i]);
-					++i;
-				}
-			} else {
-				/* Checkbox was unticked, clear the series
-				 * data
-				 */
-				lv_chart_clear_series(ui_chart, series);
-			}
-
+			/* Show or hide the series by switching the array it
+			 * draws from, no data is copied
+			 */
+			chart_bind_series(series, axis,
+					  lv_checkbox_is_checked(obj));
 			lv_chart_refresh(ui_chart);
 		}
 	}
@@ -156,36 +453,131 @@ static void button_event_handler(lv_obj_t *obj, lv_event_t event)
 				k_msgq_purge(&lcd_event_queue);
 				LOG_DBG("lcd_event_queue was cleared");
 			}
+		} else if (obj == ui_button_zoom && !chart_spectrum) {
+			/* Step through the zoom levels, back to the full
+			 * resolution history after the longest
+			 */
+			chart_set_zoom((chart_zoom + 1) %
+				       (CONFIG_APP_LCD_ZOOM_LEVELS + 1));
 		} else if (obj == ui_button_clear) {
 			/* Clear all the buffered data and remove the data from the
 			 * graph
 			 */
-			memset(chart_data_buffer_x, 0,
-			       CONFIG_APP_LCD_DATA_POINTS);
-			memset(chart_data_buffer_y, 0,
-			       CONFIG_APP_LCD_DATA_POINTS);
-			memset(chart_data_buffer_z, 0,
-			       CONFIG_APP_LCD_DATA_POINTS);
-			chart_readings = 0;
-
-			lv_chart_clear_series(ui_chart, chart_series_x);
-			lv_chart_clear_series(ui_chart, chart_series_y);
-			lv_chart_clear_series(ui_chart, chart_series_z);
+			ChartHistoryClear(&chart_history);
+			ChartEnvelopeClear(&chart_envelope);
+			chart_set_start_points();
 
 			lv_chart_refresh(ui_chart);
+#ifdef CONFIG_APP_LCD_SPECTRUM
+		} else if (obj == ui_button_mode) {
+			/* Switch between the history and the spectrum */
+			chart_set_spectrum(!chart_spectrum);
+#endif
 		}
 	}
 }
 
-static void lcd_display_update_handler(struct k_work *work)
+static int64_t render_deadline(int64_t start, int64_t frame)
 {
-	/* Triggers every 50ms for input handling */
-	lv_task_handler();
+	/* Calculated from the start so the frame rate is exact even when the
+	 * period is not a whole number of ticks
+	 */
+	return start + ((frame * CONFIG_SYS_CLOCK_TICKS_PER_SEC) /
+			CONFIG_APP_LCD_FRAME_RATE_HZ);
 }
 
-static void lcd_display_update_timer_handler(struct k_timer *dummy)
+static void render_record(uint32_t frame_us, uint32_t samples,
+			  uint32_t latency_us, bool late)
 {
-	k_work_submit(&lcd_display_update);
+	k_spinlock_key_t key = k_spin_lock(&render_stats_lock);
+
+	++render_stats.frames;
+	render_stats.frame_us = frame_us;
+
+	if (frame_us > render_stats.max_frame_us) {
+		render_stats.max_frame_us = frame_us;
+	}
+
+	if (late) {
+		++render_stats.late_frames;
+	}
+
+	if (samples > 0) {
+		render_stats.samples += samples;
+		render_stats.latency_us = latency_us;
+
+		if (latency_us > render_stats.max_latency_us) {
+			render_stats.max_latency_us = latency_us;
+		}
+	}
+
+	k_spin_unlock(&render_stats_lock, key);
+}
+
+static void render_thread(void *unused1, void *unused2, void *unused3)
+{
+	struct accel_sample sample;
+	int64_t start = k_uptime_ticks();
+	int64_t frame = 0;
+	int64_t now;
+	uint32_t frame_start;
+	uint32_t oldest_us = 0;
+	uint32_t samples;
+	uint32_t latency_us;
+	bool late;
+
+	while (1) {
+		k_sleep(K_TIMEOUT_ABS_TICKS(render_deadline(start, frame)));
+		frame_start = k_cycle_get_32();
+
+		/* Add the samples read since the last frame to the graph */
+		samples = 0;
+		while (SampleRingGet(&render_queue, &sample)) {
+			if (samples == 0) {
+				oldest_us = sample.timestamp_us;
+			}
+
+			chart_add_sample(&sample);
+			++samples;
+		}
+
+		if (samples > 0 && !chart_spectrum) {
+			chart_set_start_points();
+			lv_chart_refresh(ui_chart);
+		}
+
+#ifdef CONFIG_APP_LCD_SPECTRUM
+		/* Show the spectrum calculated since the last frame and ask
+		 * for the next, it is only calculated while it is shown
+		 */
+		if (chart_spectrum && SpectrumUpdate()) {
+			chart_bind_all_series();
+			chart_set_spectrum_scale(SpectrumGetPeak(), false);
+			lv_chart_refresh(ui_chart);
+		}
+#endif
+
+		/* Redraws the display and handles touch input */
+		lv_task_handler();
+
+		now = k_uptime_ticks();
+		latency_us = (uint32_t)k_ticks_to_us_floor64(now) - oldest_us;
+
+		/* If the frame overran, skip the frames which were due rather
+		 * than rendering them back to back
+		 */
+		++frame;
+		late = (render_deadline(start, frame) < now);
+		if (late) {
+			frame = (((now - start) * CONFIG_APP_LCD_FRAME_RATE_HZ) /
+				 CONFIG_SYS_CLOCK_TICKS_PER_SEC) +
+				1;
+		}
+
+		render_record(k_cyc_to_us_floor32(k_cycle_get_32() -
+						  frame_start),
+			      samples, latency_us, late);
+	}
 }
 
 /******************************************************************************/
@@ -194,6 +586,7 @@ static void lcd_display_update_timer_handler(struct k_timer *dummy)
 void SetupLCD(void)
 {
 	const struct device *display_dev;
+	uint16_t i;
 
 	display_dev = device_get_binding(CONFIG_LVGL_DISPLAY_DEV_NAME);
 
@@ -205,10 +598,24 @@ void SetupLCD(void)
 	}
 	lcd_present = true;
 
+#ifdef CONFIG_LVGL_ASYNC_FLUSH
+	/* Draw buffers are sent with asynchronous SPI transfers, so the render
+	 * thread draws into one while the other is sent. The blocking display
+	 * driver write is kept if this fails.
+	 */
+	(void)LvglAsyncFlushInit();
+#endif
+
 	/* Reset buffered data */
-	memset(chart_data_buffer_x, 0, CONFIG_APP_LCD_DATA_POINTS);
-	memset(chart_data_buffer_y, 0, CONFIG_APP_LCD_DATA_POINTS);
-	memset(chart_data_buffer_z, 0, CONFIG_APP_LCD_DATA_POINTS);
+	ChartHistoryInit(&chart_history, chart_history_buffer,
+			 CONFIG_APP_LCD_DATA_POINTS, LV_CHART_POINT_DEF);
+	(void)ChartEnvelopeInit(&chart_envelope, chart_envelope_buffer,
+				CONFIG_APP_LCD_ZOOM_COLUMNS,
+				CONFIG_APP_LCD_ZOOM_LEVELS,
+				CONFIG_APP_LCD_ZOOM_FACTOR, LV_CHART_POINT_DEF);
+	for (i = 0; i < CHART_EMPTY_POINTS; ++i) {
+		chart_empty_points[i] = LV_CHART_POINT_DEF;
+	}
 
 	/* Create all the UI objects and set the style information. Containers
 	 * are used to group objects and position them correctly. The main UI
@@ -266,9 +673,9 @@ void SetupLCD(void)
 
 	lv_chart_set_point_count(ui_chart, CONFIG_APP_LCD_DATA_POINTS);
 
-	lv_chart_set_x_tick_texts(ui_chart, "old\nnew", 1,
+	lv_chart_set_x_tick_texts(ui_chart, CHART_X_TICK_TEXT, 1,
 				  LV_CHART_AXIS_DRAW_LAST_TICK);
-	lv_chart_set_y_tick_texts(ui_chart, "4\n2\n0\n-2\n-4", 1,
+	lv_chart_set_y_tick_texts(ui_chart, CHART_Y_TICK_TEXT, 1,
 				  LV_CHART_AXIS_DRAW_LAST_TICK);
 
 	lv_obj_set_style_local_pad_top(ui_chart, LV_OBJ_PART_MAIN,
@@ -285,6 +692,13 @@ void SetupLCD(void)
 	chart_series_y = lv_chart_add_series(ui_chart, LV_COLOR_YELLOW);
 	chart_series_z = lv_chart_add_series(ui_chart, LV_COLOR_GREEN);
 
+	/* Point the series at the history, which frees the point arrays the
+	 * chart allocated for them
+	 */
+	chart_bind_series(chart_series_x, CHART_AXIS_X, true);
+	chart_bind_series(chart_series_y, CHART_AXIS_Y, true);
+	chart_bind_series(chart_series_z, CHART_AXIS_Z, true);
+
 	ui_check_x = lv_checkbox_create(ui_container_selections, NULL);
 	lv_checkbox_set_checked(ui_check_x, true);
 	lv_checkbox_set_text(ui_check_x, "X");
@@ -343,12 +757,42 @@ void SetupLCD(void)
 	ui_text_clear = lv_label_create(ui_button_clear, NULL);
 	lv_label_set_text(ui_text_clear, "Clear");
 
+	ui_button_zoom = lv_btn_create(ui_container_buttons, NULL);
+	lv_obj_align(ui_button_zoom, NULL, LV_ALIGN_CENTER, 0, 0);
+	lv_btn_set_fit(ui_button_zoom, LV_FIT_TIGHT);
+	lv_obj_set_event_cb(ui_button_zoom, button_event_handler);
+	ui_text_zoom = lv_label_create(ui_button_zoom, NULL);
+
+#ifdef CONFIG_APP_LCD_SPECTRUM
+	/* The spectrum covers 0 Hz to half the sample rate */
+	snprintf(spectrum_tick_text, sizeof(spectrum_tick_text), "0\n%u\n%u",
+		 CONFIG_APP_SAMPLE_RATE_HZ / 4, CONFIG_APP_SAMPLE_RATE_HZ / 2);
+	snprintf(spectrum_range_text, sizeof(spectrum_range_text), "0-%u Hz",
+		 CONFIG_APP_SAMPLE_RATE_HZ / 2);
+
+	if (SpectrumInit() == 0) {
+		ui_button_mode = lv_btn_create(ui_container_buttons, NULL);
+		lv_obj_align(ui_button_mode, NULL, LV_ALIGN_CENTER, 0, 0);
+		lv_btn_set_fit(ui_button_mode, LV_FIT_TIGHT);
+		lv_obj_set_event_cb(ui_button_mode, button_event_handler);
+		ui_text_mode = lv_label_create(ui_button_mode, NULL);
+		lv_label_set_text(ui_text_mode, MODE_BUTTON_SPECTRUM_TEXT);
+	} else {
+		LOG_ERR("Spectrum FFT could not be set up");
+	}
+#endif
+
+	/* Show the full resolution history and the time it covers */
+	chart_set_zoom(0);
+
 	display_blanking_off(display_dev);
 	lv_task_handler();
 
-	k_timer_start(&lcd_display_update_timer,
-		      K_MSEC(DISPLAY_INPUT_PERIOD_MS),
-		      K_MSEC(DISPLAY_INPUT_PERIOD_MS));
+	/* From here on LVGL is only used by the render thread */
+	k_thread_create(&render_thread_data, render_stack_area,
+			K_THREAD_STACK_SIZEOF(render_stack_area), render_thread,
+			NULL, NULL, NULL, RENDER_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&render_thread_data, "render");
 }
 
 bool IsLCDPresent(void)
@@ -356,66 +800,34 @@ bool IsLCDPresent(void)
 	return lcd_present;
 }
 
-void UpdateLCDGraph(int16_t x, int16_t y, int16_t z)
+void UpdateLCDGraph(const struct accel_sample *sample)
 {
-	/* Move all the buffered data up by a position */
-	memmove(chart_data_buffer_x, &chart_data_buffer_x[1],
-		sizeof(chart_data_buffer_x) - sizeof(chart_data_buffer_x[0]));
-	memmove(chart_data_buffer_y, &chart_data_buffer_y[1],
-		sizeof(chart_data_buffer_y) - sizeof(chart_data_buffer_y[0]));
-	memmove(chart_data_buffer_z, &chart_data_buffer_z[1],
-		sizeof(chart_data_buffer_z) - sizeof(chart_data_buffer_z[0]));
-
-	/* Limit values to min and max graph values, this happens if there is a
-	 * large amount of movement
-	 */
-	if (x > CHART_Y_PRIMARY_MAX) {
-		x = CHART_Y_PRIMARY_MAX;
-	} else if (x < CHART_Y_PRIMARY_MIN) {
-		x = CHART_Y_PRIMARY_MIN;
-	}
-
-	if (y > CHART_Y_PRIMARY_MAX) {
-		y = CHART_Y_PRIMARY_MAX;
-	} else if (y < CHART_Y_PRIMARY_MIN) {
-		y = CHART_Y_PRIMARY_MIN;
-	}
-
-	if (z > CHART_Y_PRIMARY_MAX) {
-		z = CHART_Y_PRIMARY_MAX;
-	} else if (z < CHART_Y_PRIMARY_MIN) {
-		z = CHART_Y_PRIMARY_MIN;
-	}
+	/* Dropped samples are counted by the queue */
+	(void)SampleRingPut(&render_queue, sample);
+}
 
-	/* Append the newest data to the end of the array */
-	chart_data_buffer_x[CONFIG_APP_LCD_DATA_POINTS - 1] = x;
-	chart_data_buffer_y[CONFIG_APP_LCD_DATA_POINTS - 1] = y;
-	chart_data_buffer_z[CONFIG_APP_LCD_DATA_POINTS - 1] = z;
+void LCDGetStats(struct lcd_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&render_stats_lock);
 
-	if (chart_readings < CONFIG_APP_LCD_DATA_POINTS) {
-		++chart_readings;
-	}
+	*stats = render_stats;
+	stats->dropped = render_queue.overruns - render_dropped_base;
+	k_spin_unlock(&render_stats_lock, key);
+}
 
-	/* Only add the data to the graph if the respective checkbox is
-	 * ticked
-	 */
-	if (lv_checkbox_is_checked(ui_check_x)) {
-		lv_chart_set_next(
-			ui_chart, chart_series_x,
-			chart_data_buffer_x[CONFIG_APP_LCD_DATA_POINTS - 1]);
-	}
+void LCDResetStats(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&render_stats_lock);
 
-	if (lv_checkbox_is_checked(ui_check_y)) {
-		lv_chart_set_next(
-			ui_chart, chart_series_y,
-			chart_data_buffer_y[CONFIG_APP_LCD_DATA_POINTS - 1]);
-	}
+	memset(&render_stats, 0, sizeof(render_stats));
+	render_dropped_base = render_queue.overruns;
+	k_spin_unlock(&render_stats_lock, key);
+}
 
-	if (lv_checkbox_is_checked(ui_check_z)) {
-		lv_chart_set_next(
-			ui_chart, chart_series_z,
-			chart_data_buffer_z[CONFIG_APP_LCD_DATA_POINTS - 1]);
-	}
+size_t LCDGetBufferSize(void)
+{
+	return sizeof(chart_history_buffer) + sizeof(chart_envelope_buffer) +
+	       sizeof(chart_empty_points);
 }
 
 #endif
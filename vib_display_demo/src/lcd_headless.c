@@ -0,0 +1,449 @@
+/**
+ * @file lcd_headless.c
+ * @brief Headless display render benchmark for vibration display demo on
+ *        native_posix
+ *
+ * Runs the unmodified graph and render thread against an in-memory
+ * framebuffer, with a built in test signal in place of the sensor and a
+ * touch script in place of the touch controller. Each display refresh is
+ * measured in host CPU time, which covers the render thread adding samples
+ * to the graph as well as LVGL drawing it, and the number of pixels it
+ * redrew. Simulated time and the test signal are the same on every run,
+ * so framebuffer dumps can be compared against golden images.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <stdio.h>
+#include <lvgl.h>
+
+/* Host CPU time, heap and file access, this file is only built for
+ * native_posix
+ */
+#include <time.h>
+#include <malloc.h>
+
+#include "cmdline.h"
+#include "soc.h"
+#include "posix_board_if.h"
+
+#include "lcd_headless.h"
+#include "lcd.h"
+#include "application.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define HEADLESS_FRAMEBUFFER_PIXELS                                            \
+	(CONFIG_LVGL_HOR_RES_MAX * CONFIG_LVGL_VER_RES_MAX)
+#define HEADLESS_PATH_MAX 256
+#define HEADLESS_LINE_MAX 80
+#define HEADLESS_TOUCH_MAX 64
+
+/* Touches are held for several LVGL input reads so that they are seen as a
+ * click
+ */
+#define HEADLESS_TOUCH_PRESS_MS 100
+
+/* Gravity on Z, a tone on X and the same tone at a quarter of the rate on
+ * Y
+ */
+#define HEADLESS_GRAVITY_MG 1000
+#define HEADLESS_TONE_STEPS 16
+#define HEADLESS_SLOW_TONE_DIVIDER 4
+
+#define RGB888_BYTES 3
+
+/* LVGL sizes its draw buffer from CONFIG_LVGL_BITS_PER_PIXEL, and the
+ * framebuffer and dump read it back as lv_color_t
+ */
+BUILD_ASSERT((sizeof(lv_color_t) * 8) == CONFIG_LVGL_BITS_PER_PIXEL,
+	     "Headless framebuffer format must match lv_color_t");
+
+struct headless_touch {
+	uint32_t time_ms;
+	lv_coord_t x;
+	lv_coord_t y;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static const int16_t headless_tone[HEADLESS_TONE_STEPS] = {
+	0, 191, 354, 462, 500, 462, 354, 191,
+	0, -191, -354, -462, -500, -462, -354, -191,
+};
+
+/* Set from the command line */
+static uint32_t headless_frames;
+static char *headless_dump_path;
+static uint32_t headless_dump_every;
+static char *headless_touch_path;
+
+static lv_color_t headless_framebuffer[HEADLESS_FRAMEBUFFER_PIXELS];
+static uint8_t headless_row[CONFIG_LVGL_HOR_RES_MAX * RGB888_BYTES];
+static lv_coord_t headless_width;
+static lv_coord_t headless_height;
+
+static struct headless_touch headless_touches[HEADLESS_TOUCH_MAX];
+static uint32_t headless_touch_count;
+static uint32_t headless_touch_next;
+
+/* Refresh measurements, only updated by the thread running LVGL */
+static bool headless_started;
+static int64_t headless_start_ms;
+static uint32_t headless_refreshes;
+static uint64_t headless_last_ns;
+static uint64_t headless_total_ns;
+static uint64_t headless_max_ns;
+static uint64_t headless_total_px;
+static uint32_t headless_max_px;
+static uint32_t headless_max_heap;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void headless_options(void);
+static uint64_t headless_cpu_ns(void);
+static uint32_t headless_heap_used(void);
+static void headless_load_touches(const char *path);
+static void headless_flush(lv_disp_drv_t *driver, const lv_area_t *area,
+			   lv_color_t *color_p);
+static void headless_monitor(lv_disp_drv_t *driver, uint32_t time,
+			     uint32_t px);
+static bool headless_touch_read(lv_indev_drv_t *driver,
+				lv_indev_data_t *data);
+static void headless_dump(uint32_t refresh);
+static void headless_report(void);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void headless_options(void)
+{
+	static struct args_struct_t headless_args[] = {
+		{ .option = "headless-frames",
+		  .name = "count",
+		  .type = 'u',
+		  .dest = (void *)&headless_frames,
+		  .descript = "Report the render benchmark and exit after this "
+			      "many display refreshes have been measured" },
+		{ .option = "headless-dump",
+		  .name = "prefix",
+		  .type = 's',
+		  .dest = (void *)&headless_dump_path,
+		  .descript = "Write the display to <prefix>.ppm on exit" },
+		{ .option = "headless-dump-every",
+		  .name = "count",
+		  .type = 'u',
+		  .dest = (void *)&headless_dump_every,
+		  .descript = "Also write the display to <prefix>_<refresh>.ppm "
+			      "every count refreshes" },
+		{ .option = "headless-touch",
+		  .name = "path",
+		  .type = 's',
+		  .dest = (void *)&headless_touch_path,
+		  .descript = "Touch script, lines of <ms> <x> <y> giving "
+			      "the time and position of each touch" },
+		ARG_TABLE_ENDMARKER
+	};
+
+	native_add_command_line_opts(headless_args);
+}
+
+/** @brief Gets the host CPU time used by the process. Only one thread runs at
+ *  a time on native_posix, and the render thread does almost all the work.
+ */
+static uint64_t headless_cpu_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+	return ((uint64_t)now.tv_sec * NSEC_PER_SEC) + now.tv_nsec;
+}
+
+/** @brief Gets the host heap in use, which LVGL allocates its objects from
+ *  with CONFIG_LVGL_MEM_POOL_HEAP_LIB_C.
+ */
+static uint32_t headless_heap_used(void)
+{
+#if (__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+
+	return (uint32_t)info.uordblks;
+}
+
+static void headless_load_touches(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[HEADLESS_LINE_MAX];
+	unsigned int time_ms;
+	int x;
+	int y;
+
+	if (file == NULL) {
+		printf("Could not open touch script %s\n", path);
+		return;
+	}
+
+	while (headless_touch_count < HEADLESS_TOUCH_MAX &&
+	       fgets(line, sizeof(line), file) != NULL) {
+		/* Blank lines and comments do not match */
+		if (sscanf(line, "%u %d %d", &time_ms, &x, &y) == 3) {
+			headless_touches[headless_touch_count].time_ms =
+				time_ms;
+			headless_touches[headless_touch_count].x = x;
+			headless_touches[headless_touch_count].y = y;
+			++headless_touch_count;
+		}
+	}
+
+	fclose(file);
+}
+
+static void headless_flush(lv_disp_drv_t *driver, const lv_area_t *area,
+			   lv_color_t *color_p)
+{
+	lv_coord_t width = lv_area_get_width(area);
+	lv_coord_t y = area->y1;
+
+	while (y <= area->y2) {
+		memcpy(&headless_framebuffer[(y * headless_width) + area->x1],
+		       color_p, width * sizeof(lv_color_t));
+		color_p += width;
+		++y;
+	}
+
+	lv_disp_flush_ready(driver);
+}
+
+/** @brief Called by LVGL when a refresh of the display has completed. */
+static void headless_monitor(lv_disp_drv_t *driver, uint32_t time,
+			     uint32_t px)
+{
+	uint64_t now_ns = headless_cpu_ns();
+	uint64_t refresh_ns = now_ns - headless_last_ns;
+	uint32_t heap = headless_heap_used();
+
+	ARG_UNUSED(driver);
+	ARG_UNUSED(time);
+
+	/* The first refresh draws the whole screen during SetupLCD, measuring
+	 * starts after it
+	 */
+	headless_last_ns = now_ns;
+	if (!headless_started) {
+		headless_started = true;
+		headless_start_ms = k_uptime_get();
+		return;
+	}
+
+	++headless_refreshes;
+	headless_total_ns += refresh_ns;
+	headless_total_px += px;
+
+	if (refresh_ns > headless_max_ns) {
+		headless_max_ns = refresh_ns;
+	}
+
+	if (px > headless_max_px) {
+		headless_max_px = px;
+	}
+
+	if (heap > headless_max_heap) {
+		headless_max_heap = heap;
+	}
+
+	if (headless_dump_every > 0 &&
+	    (headless_refreshes % headless_dump_every) == 0) {
+		headless_dump(headless_refreshes);
+	}
+
+	if (headless_refreshes == headless_frames) {
+		headless_dump(0);
+		headless_report();
+		posix_exit(0);
+	}
+}
+
+/** @brief Reports each touch from the script as pressed for
+ *  HEADLESS_TOUCH_PRESS_MS from its time, then released.
+ */
+static bool headless_touch_read(lv_indev_drv_t *driver,
+				lv_indev_data_t *data)
+{
+	int64_t now_ms = k_uptime_get() - headless_start_ms;
+	const struct headless_touch *touch;
+
+	ARG_UNUSED(driver);
+
+	data->state = LV_INDEV_STATE_REL;
+
+	/* Timed from the end of start up */
+	if (!headless_started) {
+		return false;
+	}
+
+	while (headless_touch_next < headless_touch_count &&
+	       headless_touches[headless_touch_next].time_ms <= now_ms) {
+		++headless_touch_next;
+	}
+
+	if (headless_touch_next > 0) {
+		touch = &headless_touches[headless_touch_next - 1];
+		data->point.x = touch->x;
+		data->point.y = touch->y;
+
+		if (now_ms < (touch->time_ms + HEADLESS_TOUCH_PRESS_MS)) {
+			data->state = LV_INDEV_STATE_PR;
+		}
+	}
+
+	return false;
+}
+
+/** @brief Writes the framebuffer as a binary PPM, <prefix>.ppm for refresh 0
+ *  or <prefix>_<refresh>.ppm otherwise.
+ */
+static void headless_dump(uint32_t refresh)
+{
+	char path[HEADLESS_PATH_MAX];
+	const lv_color_t *pixel = headless_framebuffer;
+	uint32_t colour;
+	FILE *file;
+	lv_coord_t x;
+	lv_coord_t y = 0;
+
+	if (headless_dump_path == NULL) {
+		return;
+	}
+
+	if (refresh == 0) {
+		snprintf(path, sizeof(path), "%s.ppm", headless_dump_path);
+	} else {
+		snprintf(path, sizeof(path), "%s_%06u.ppm", headless_dump_path,
+			 refresh);
+	}
+
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Could not write %s\n", path);
+		return;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", headless_width, headless_height);
+
+	while (y < headless_height) {
+		for (x = 0; x < headless_width; ++x) {
+			colour = lv_color_to32(*pixel);
+			headless_row[(x * RGB888_BYTES) + 0] = colour >> 16;
+			headless_row[(x * RGB888_BYTES) + 1] = colour >> 8;
+			headless_row[(x * RGB888_BYTES) + 2] = colour;
+			++pixel;
+		}
+
+		fwrite(headless_row, RGB888_BYTES, headless_width, file);
+		++y;
+	}
+
+	fclose(file);
+}
+
+static void headless_report(void)
+{
+	struct lcd_stats lcd;
+	uint64_t mean_ns = headless_total_ns / headless_refreshes;
+
+	LCDGetStats(&lcd);
+
+	printf("headless: points=%u refreshes=%u frames=%u samples=%u "
+	       "dropped=%u\n",
+	       CONFIG_APP_LCD_DATA_POINTS, headless_refreshes, lcd.frames,
+	       lcd.samples, lcd.dropped);
+	printf("headless: cpu=%u.%03u us/refresh max=%u us\n",
+	       (uint32_t)(mean_ns / NSEC_PER_USEC),
+	       (uint32_t)(mean_ns % NSEC_PER_USEC),
+	       (uint32_t)(headless_max_ns / NSEC_PER_USEC));
+	printf("headless: pixels=%u/refresh max=%u\n",
+	       (uint32_t)(headless_total_px / headless_refreshes),
+	       headless_max_px);
+	printf("headless: heap=%u bytes max=%u graph=%u bytes\n",
+	       headless_heap_used(), headless_max_heap,
+	       (uint32_t)LCDGetBufferSize());
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void LCDHeadlessInit(void)
+{
+	lv_disp_t *disp = lv_disp_get_default();
+	lv_disp_drv_t driver;
+	lv_indev_drv_t touch_driver;
+
+	headless_width = lv_disp_get_hor_res(disp);
+	headless_height = lv_disp_get_ver_res(disp);
+	if (((uint32_t)headless_width * headless_height) >
+	    HEADLESS_FRAMEBUFFER_PIXELS) {
+		printf("Display is larger than CONFIG_LVGL_HOR_RES_MAX x "
+		       "CONFIG_LVGL_VER_RES_MAX\n");
+		posix_exit(1);
+	}
+
+	if (headless_touch_path != NULL) {
+		headless_load_touches(headless_touch_path);
+	}
+
+	/* The dummy display reports ARGB_8888, for which LVGL is set up to
+	 * write 32-bit pixels into the draw buffer. Drawing in lv_color_t
+	 * instead keeps the draw buffer in the framebuffer format.
+	 */
+	driver = disp->driver;
+	driver.set_px_cb = NULL;
+	driver.rounder_cb = NULL;
+	driver.flush_cb = headless_flush;
+	driver.monitor_cb = headless_monitor;
+	lv_disp_drv_update(disp, &driver);
+
+	lv_indev_drv_init(&touch_driver);
+	touch_driver.type = LV_INDEV_TYPE_POINTER;
+	touch_driver.read_cb = headless_touch_read;
+	lv_indev_drv_register(&touch_driver);
+}
+
+void LCDHeadlessRun(void)
+{
+	struct accel_sample sample;
+	int64_t start = k_uptime_ticks();
+	int64_t now;
+	uint32_t i = 0;
+
+	while (1) {
+		k_sleep(K_TIMEOUT_ABS_TICKS(
+			start + (((int64_t)i * APPLICATION_POINT_PERIOD_US *
+				  CONFIG_SYS_CLOCK_TICKS_PER_SEC) /
+				 USEC_PER_SEC)));
+		now = k_uptime_ticks();
+
+		sample.mg[0] = headless_tone[i % HEADLESS_TONE_STEPS];
+		sample.mg[1] = headless_tone[(i / HEADLESS_SLOW_TONE_DIVIDER) %
+					     HEADLESS_TONE_STEPS];
+		sample.mg[2] = HEADLESS_GRAVITY_MG;
+		sample.timestamp_us = (uint32_t)k_ticks_to_us_floor64(now);
+		UpdateLCDGraph(&sample);
+		++i;
+	}
+}
+
+NATIVE_TASK(headless_options, PRE_BOOT_1, 1);
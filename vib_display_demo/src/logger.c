@@ -2,6 +2,13 @@
  * @file logger.c
  * @brief Logging application file for vibration display demo application
  *
+ * The accelerometer runs at CONFIG_APP_SAMPLE_RATE_HZ and its data ready
+ * interrupt wakes the sensor driver's thread, which reads each sample and
+ * passes it to the handler here. Motion detection runs on every sample, so
+ * the LEDs catch transients which are too short to show on the graph, and
+ * the graph is fed a reduced stream of one point per
+ * CONFIG_APP_GRAPH_SAMPLES_PER_POINT samples.
+ *
  * Copyright (c) 2021 Laird Connectivity
  *
  * SPDX-License-Identifier: Apache-2.0
@@ -21,10 +28,16 @@
 #include <logging/log.h>
 #include <drivers/sensor.h>
 #include <drivers/gpio.h>
+#include <sys/atomic.h>
 #include <lcz_led.h>
 
 #include "application.h"
 #include "lcd.h"
+#include "accel_convert.h"
+#include "stream_stats.h"
+#ifdef CONFIG_APP_LCD_SPECTRUM
+#include "spectrum.h"
+#endif
 #include "../../../ble_gateway_firmware/app/common/include/led_configuration.h"
 
 LOG_MODULE_REGISTER(logger);
@@ -32,44 +45,132 @@ LOG_MODULE_REGISTER(logger);
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
-#define ACCEL_CHECK_TIMER_MS 30
-#define ACCEL_VAL1_CONVERSION_FACTOR 100
-#define ACCEL_VAL2_CONVERSION_FACTOR 10000
 #define ACCEL_ARRAY_X 0
 #define ACCEL_ARRAY_Y 1
 #define ACCEL_ARRAY_Z 2
 #define ACCEL_ARRAY_SIZE 3
-#define RECENT_ARRAY_SIZE 10
-#define RECENT_MOTION_MINIMUM 250
 #define NEGATIVE_TO_POSITIVE_MULTIPLY -1
 
+/* Motion is a reading further from the mean of the readings over this
+ * window than the threshold for its axis
+ */
+#define MOTION_WINDOW_SAMPLES                                                  \
+	MAX(1, (CONFIG_APP_SAMPLE_RATE_HZ * CONFIG_APP_MOTION_WINDOW_MS) /     \
+		       MSEC_PER_SEC)
+#define MOTION_HOLD_SAMPLES                                                    \
+	MAX(1, (CONFIG_APP_SAMPLE_RATE_HZ * CONFIG_APP_MOTION_HOLD_MS) /       \
+		       MSEC_PER_SEC)
+
+/* A sample read more than one and a half periods after the previous one is
+ * counted as late
+ */
+#define SAMPLE_PERIOD_US (USEC_PER_SEC / CONFIG_APP_SAMPLE_RATE_HZ)
+#define SAMPLE_LATE_US (SAMPLE_PERIOD_US + (SAMPLE_PERIOD_US / 2))
+
+/* The minimum and maximum of each block are drawn as two points, so a
+ * block covers two points' worth of samples
+ */
+#if defined(CONFIG_APP_GRAPH_REDUCTION_MINMAX)
+#define GRAPH_BLOCK_SAMPLES (2 * CONFIG_APP_GRAPH_SAMPLES_PER_POINT)
+#else
+#define GRAPH_BLOCK_SAMPLES CONFIG_APP_GRAPH_SAMPLES_PER_POINT
+#endif
+
+struct motion_axis {
+	struct stream_window window;
+	/* Samples the LED stays on for after motion was last detected */
+	uint16_t hold;
+	bool led_on;
+};
+
+struct graph_block {
+	int32_t sum[ACCEL_ARRAY_SIZE];
+	int16_t min[ACCEL_ARRAY_SIZE];
+	int16_t max[ACCEL_ARRAY_SIZE];
+	uint16_t count;
+};
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
 static void configure_leds(void);
-static void vib_log_update_handler(struct k_work *work);
-static void vib_log_update_handler(struct k_work *work);
-static void vib_log_update_timer_handler(struct k_timer *dummy);
+static void sensor_start(const struct device *sensor);
+static void sensor_stop(const struct device *sensor);
+static void sensor_record(int64_t now, bool overrun);
+static void sensor_trigger_handler(const struct device *sensor,
+				   struct sensor_trigger *trigger);
+static void motion_check(const int16_t *mg);
+static void motion_set_led(uint8_t axis, bool on);
+static void graph_add(const int16_t *mg, uint32_t timestamp_us);
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
-int16_t recent_x_values[RECENT_ARRAY_SIZE];
-int16_t recent_y_values[RECENT_ARRAY_SIZE];
-int16_t recent_z_values[RECENT_ARRAY_SIZE];
-uint8_t recent_pos = 0;
+static const uint8_t motion_leds[ACCEL_ARRAY_SIZE] = { BLUE_LED1, BLUE_LED2,
+						       BLUE_LED3 };
+
+static const int16_t motion_thresholds[ACCEL_ARRAY_SIZE] = {
+	CONFIG_APP_MOTION_THRESHOLD_X_MG, CONFIG_APP_MOTION_THRESHOLD_Y_MG,
+	CONFIG_APP_MOTION_THRESHOLD_Z_MG
+};
+
+/* Only used by the sensor driver thread while sampling is running */
+static struct motion_axis motion[ACCEL_ARRAY_SIZE];
+static int16_t motion_samples[ACCEL_ARRAY_SIZE][MOTION_WINDOW_SAMPLES];
+static struct graph_block graph_block;
+
+static struct accel_convert accel_convert;
+
+static struct sensor_trigger sensor_drdy_trigger = {
+	.type = SENSOR_TRIG_DATA_READY,
+	.chan = SENSOR_CHAN_ACCEL_XYZ,
+};
 
-K_WORK_DEFINE(vib_log_update, vib_log_update_handler);
-K_TIMER_DEFINE(vib_log_update_timer, vib_log_update_timer_handler, NULL);
+static atomic_t sensor_running;
+static struct acquisition_stats sensor_stats;
+static int64_t sensor_previous_ticks;
+static bool sensor_previous_valid;
+static struct k_spinlock sensor_stats_lock;
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
 void ApplicationStart(void)
 {
+	struct accel_calibration calibration;
+	struct sensor_value rate = { .val1 = CONFIG_APP_SAMPLE_RATE_HZ };
+	const struct device *sensor =
+		device_get_binding(DT_LABEL(DT_INST(0, st_lis2dh)));
+	uint8_t i = 0;
+
+	if (sensor == NULL) {
+		printf("Could not get %s device\n",
+		       DT_LABEL(DT_INST(0, st_lis2dh)));
+		return;
+	}
+
 	/* Setup LEDs for motion output */
 	configure_leds();
 
+	while (i < ACCEL_ARRAY_SIZE) {
+		StreamWindowInit(&motion[i].window, motion_samples[i],
+				 MOTION_WINDOW_SAMPLES);
+		++i;
+	}
+
+	AccelCalibrationGetConfig(&calibration);
+	if (AccelConvertInit(&accel_convert, &calibration) != 0) {
+		printf("Invalid accelerometer calibration\n");
+		return;
+	}
+
+	if (sensor_attr_set(sensor, SENSOR_CHAN_ACCEL_XYZ,
+			    SENSOR_ATTR_SAMPLING_FREQUENCY, &rate) != 0) {
+		printf("Could not set %u Hz sample rate\n",
+		       CONFIG_APP_SAMPLE_RATE_HZ);
+		return;
+	}
+
 	/* Use GUI to control application */
 	struct lcd_event_s data;
 	while (1) {
@@ -78,142 +179,260 @@ void ApplicationStart(void)
 		if (data.state == STATE_BUTTON_CLICKED) {
 			/* A button has been clicked */
 			if (data.object_id == OBJECT_ID_START_BUTTON) {
-				/* Start button was clicked, start the timer
-				 * for data collection and begin outputting
-				 * data to the graph and UART
+				/* Start button was clicked, enable the data
+				 * ready interrupt so samples are passed to
+				 * the graph
 				 */
-				k_timer_start(&vib_log_update_timer,
-					      K_MSEC(ACCEL_CHECK_TIMER_MS),
-					      K_MSEC(ACCEL_CHECK_TIMER_MS));
+				sensor_start(sensor);
 			} else if (data.object_id == OBJECT_ID_STOP_BUTTON) {
-				/* Stop button was clicked, stop the timer for
-				 * data collection and return to idle mode
+				/* Stop button was clicked, disable the data
+				 * ready interrupt
 				 */
-				k_timer_stop(&vib_log_update_timer);
-
-				/* Turn off LEDs */
-				lcz_led_turn_off(BLUE_LED1);
-				lcz_led_turn_off(BLUE_LED2);
-				lcz_led_turn_off(BLUE_LED3);
+				sensor_stop(sensor);
 			}
 		}
 	}
 }
 
-static void vib_log_update_handler(struct k_work *work)
+void ApplicationGetStats(struct acquisition_stats *stats)
 {
-	int rc;
-	struct sensor_value accel[ACCEL_ARRAY_SIZE];
+	k_spinlock_key_t key = k_spin_lock(&sensor_stats_lock);
 
-	const struct device *sensor =
-		device_get_binding(DT_LABEL(DT_INST(0, st_lis2dh)));
+	*stats = sensor_stats;
+	k_spin_unlock(&sensor_stats_lock, key);
+}
 
-	if (sensor == NULL) {
-		printf("Could not get %s device\n",
-		       DT_LABEL(DT_INST(0, st_lis2dh)));
+void ApplicationResetStats(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&sensor_stats_lock);
+
+	memset(&sensor_stats, 0, sizeof(sensor_stats));
+	k_spin_unlock(&sensor_stats_lock, key);
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void sensor_start(const struct device *sensor)
+{
+	k_spinlock_key_t key;
+	uint8_t i = 0;
+
+	if (atomic_set(&sensor_running, true)) {
 		return;
 	}
 
+	/* The driver thread is idle while the interrupt is disabled */
+	while (i < ACCEL_ARRAY_SIZE) {
+		StreamWindowReset(&motion[i].window);
+		motion[i].hold = 0;
+		motion[i].led_on = false;
+		++i;
+	}
+	graph_block.count = 0;
+
+	key = k_spin_lock(&sensor_stats_lock);
+	sensor_previous_valid = false;
+	k_spin_unlock(&sensor_stats_lock, key);
+
+	/* Read any sample left from before, so the data ready line is low and
+	 * the next sample raises an edge
+	 */
+	(void)sensor_sample_fetch(sensor);
+
+	if (sensor_trigger_set(sensor, &sensor_drdy_trigger,
+			       sensor_trigger_handler) != 0) {
+		printf("Could not enable the data ready interrupt\n");
+		atomic_set(&sensor_running, false);
+	}
+}
+
+static void sensor_stop(const struct device *sensor)
+{
+	uint8_t i = 0;
+
+	if (!atomic_set(&sensor_running, false)) {
+		return;
+	}
+
+	(void)sensor_trigger_set(sensor, &sensor_drdy_trigger, NULL);
+
+	/* Turn off LEDs, the handler does the same if it was interrupted
+	 * part way through a sample
+	 */
+	while (i < ACCEL_ARRAY_SIZE) {
+		lcz_led_turn_off(motion_leds[i]);
+		++i;
+	}
+}
+
+static void sensor_record(int64_t now, bool overrun)
+{
+	k_spinlock_key_t key = k_spin_lock(&sensor_stats_lock);
+	uint32_t interval_us;
+
+	++sensor_stats.samples;
+
+	if (overrun) {
+		++sensor_stats.overruns;
+	}
+
+	if (sensor_previous_valid) {
+		interval_us =
+			k_ticks_to_us_floor32((uint32_t)(now -
+							 sensor_previous_ticks));
+
+		if (interval_us > sensor_stats.max_interval_us) {
+			sensor_stats.max_interval_us = interval_us;
+		}
+
+		if (interval_us > SAMPLE_LATE_US) {
+			++sensor_stats.late;
+		}
+	}
+
+	sensor_previous_ticks = now;
+	sensor_previous_valid = true;
+	k_spin_unlock(&sensor_stats_lock, key);
+}
+
+/** @brief Called on the sensor driver thread for each data ready interrupt.
+ */
+static void sensor_trigger_handler(const struct device *sensor,
+				   struct sensor_trigger *trigger)
+{
+	struct sensor_value accel[ACCEL_ARRAY_SIZE];
+	int16_t mg[ACCEL_ARRAY_SIZE];
+	int64_t now = k_uptime_ticks();
+	uint8_t i = 0;
+	int rc;
+
+	ARG_UNUSED(trigger);
+
+	/* -EBADMSG is a valid sample, but the sensor overwrote the one before
+	 * it as it was not read in time
+	 */
 	rc = sensor_sample_fetch(sensor);
+	sensor_record(now, (rc == -EBADMSG));
 
 	if (rc == 0 || rc == -EBADMSG) {
 		rc = sensor_channel_get(sensor, SENSOR_CHAN_ACCEL_XYZ, accel);
 
 		if (rc == 0) {
-			/* Readings returned by the sensor driver are in 10ths
-			 * of a g, convert to 0.001 units
+			/* Readings returned by the sensor driver are in m/s^2,
+			 * convert to calibrated 0.001 g units
 			 */
-			int16_t x = (accel[ACCEL_ARRAY_X].val1 *
-				     ACCEL_VAL1_CONVERSION_FACTOR) +
-				    (accel[ACCEL_ARRAY_X].val2 /
-				     ACCEL_VAL2_CONVERSION_FACTOR);
-			int16_t y = (accel[ACCEL_ARRAY_Y].val1 *
-				     ACCEL_VAL1_CONVERSION_FACTOR) +
-				    (accel[ACCEL_ARRAY_Y].val2 /
-				     ACCEL_VAL2_CONVERSION_FACTOR);
-			int16_t z = (accel[ACCEL_ARRAY_Z].val1 *
-				     ACCEL_VAL1_CONVERSION_FACTOR) +
-				    (accel[ACCEL_ARRAY_Z].val2 /
-				     ACCEL_VAL2_CONVERSION_FACTOR);
-
-			UpdateLCDGraph(x, y, z);
-
-			/* Record recent positions for motion alert */
-			recent_x_values[recent_pos] = x;
-			recent_y_values[recent_pos] = y;
-			recent_z_values[recent_pos] = z;
-			++recent_pos;
-
-			if (recent_pos >= RECENT_ARRAY_SIZE) {
-				recent_pos = 0;
-			}
-
-			/* X-axis motion checking */
-			uint8_t i = 0;
-			int32_t tmp = 0;
-			while (i < RECENT_ARRAY_SIZE) {
-				tmp += (int32_t)recent_x_values[i];
-				++i;
-			}
-			tmp /= RECENT_ARRAY_SIZE;
+			AccelConvertValues(&accel_convert, accel, &mg, 1);
+			motion_check(mg);
+#ifdef CONFIG_APP_LCD_SPECTRUM
+			SpectrumAddSample(mg);
+#endif
+			graph_add(mg, (uint32_t)k_ticks_to_us_floor64(now));
+		}
+	}
 
-			int32_t motion_amount = (int32_t)x - tmp;
-			if (motion_amount < 0) {
-				motion_amount *= NEGATIVE_TO_POSITIVE_MULTIPLY;
-			}
+	/* Stopping while a sample was being handled could leave an LED on */
+	if (!atomic_get(&sensor_running)) {
+		while (i < ACCEL_ARRAY_SIZE) {
+			motion_set_led(i, false);
+			++i;
+		}
+	}
+}
 
-			if (motion_amount > RECENT_MOTION_MINIMUM) {
-				lcz_led_turn_on(BLUE_LED1);
-			} else {
-				lcz_led_turn_off(BLUE_LED1);
-			}
+/** @brief Checks each axis for motion against the mean over
+ *  CONFIG_APP_MOTION_WINDOW_MS, which the window keeps as a running sum. An
+ *  LED stays on for CONFIG_APP_MOTION_HOLD_MS after the last motion so that
+ *  single sample transients are visible.
+ */
+static void motion_check(const int16_t *mg)
+{
+	struct motion_axis *axis;
+	int32_t motion_amount;
+	uint8_t i = 0;
 
-			/* Y-axis motion checking */
-			i = 0;
-			tmp = 0;
-			while (i < RECENT_ARRAY_SIZE) {
-				tmp += (int32_t)recent_y_values[i];
-				++i;
-			}
-			tmp /= RECENT_ARRAY_SIZE;
+	while (i < ACCEL_ARRAY_SIZE) {
+		axis = &motion[i];
+		StreamWindowAdd(&axis->window, mg[i]);
 
-			motion_amount = (int32_t)y - tmp;
-			if (motion_amount < 0) {
-				motion_amount *= NEGATIVE_TO_POSITIVE_MULTIPLY;
-			}
+		motion_amount =
+			(int32_t)mg[i] - StreamWindowMean(&axis->window);
+		if (motion_amount < 0) {
+			motion_amount *= NEGATIVE_TO_POSITIVE_MULTIPLY;
+		}
 
-			if (motion_amount > RECENT_MOTION_MINIMUM) {
-				lcz_led_turn_on(BLUE_LED2);
-			} else {
-				lcz_led_turn_off(BLUE_LED2);
-			}
+		if (motion_amount > motion_thresholds[i]) {
+			axis->hold = MOTION_HOLD_SAMPLES;
+		} else if (axis->hold > 0) {
+			--axis->hold;
+		}
 
-			/* Z-axis motion checking */
-			i = 0;
-			tmp = 0;
-			while (i < RECENT_ARRAY_SIZE) {
-				tmp += (int32_t)recent_z_values[i];
-				++i;
-			}
-			tmp /= RECENT_ARRAY_SIZE;
+		motion_set_led(i, (axis->hold > 0));
+		++i;
+	}
+}
 
-			motion_amount = (int32_t)z - tmp;
-			if (motion_amount < 0) {
-				motion_amount *= NEGATIVE_TO_POSITIVE_MULTIPLY;
-			}
+/** @brief Only changes the LED when its state changes. */
+static void motion_set_led(uint8_t axis, bool on)
+{
+	if (motion[axis].led_on == on) {
+		return;
+	}
 
-			if (motion_amount > RECENT_MOTION_MINIMUM) {
-				lcz_led_turn_on(BLUE_LED3);
-			} else {
-				lcz_led_turn_off(BLUE_LED3);
-			}
-		}
+	if (on) {
+		lcz_led_turn_on(motion_leds[axis]);
+	} else {
+		lcz_led_turn_off(motion_leds[axis]);
 	}
+
+	motion[axis].led_on = on;
 }
 
-static void vib_log_update_timer_handler(struct k_timer *dummy)
+/** @brief Reduces the samples to one graph point per
+ *  CONFIG_APP_GRAPH_SAMPLES_PER_POINT, either the mean or, from blocks of
+ *  twice that, the minimum followed by the maximum.
+ */
+static void graph_add(const int16_t *mg, uint32_t timestamp_us)
 {
-	k_work_submit(&vib_log_update);
+	struct graph_block *block = &graph_block;
+	struct accel_sample point;
+	uint8_t i = 0;
+
+	while (i < ACCEL_ARRAY_SIZE) {
+		if (block->count == 0) {
+			block->sum[i] = mg[i];
+			block->min[i] = mg[i];
+			block->max[i] = mg[i];
+		} else {
+			block->sum[i] += mg[i];
+			block->min[i] = MIN(block->min[i], mg[i]);
+			block->max[i] = MAX(block->max[i], mg[i]);
+		}
+		++i;
+	}
+
+	++block->count;
+	if (block->count < GRAPH_BLOCK_SAMPLES) {
+		return;
+	}
+
+	block->count = 0;
+	point.timestamp_us = timestamp_us;
+
+	/* Queued for the render thread, this never blocks */
+#if defined(CONFIG_APP_GRAPH_REDUCTION_MINMAX)
+	memcpy(point.mg, block->min, sizeof(point.mg));
+	UpdateLCDGraph(&point);
+	memcpy(point.mg, block->max, sizeof(point.mg));
+	UpdateLCDGraph(&point);
+#else
+	i = 0;
+	while (i < ACCEL_ARRAY_SIZE) {
+		point.mg[i] = (int16_t)(block->sum[i] / GRAPH_BLOCK_SAMPLES);
+		++i;
+	}
+	UpdateLCDGraph(&point);
+#endif
 }
 
 static void configure_leds(void)
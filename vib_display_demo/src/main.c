@@ -25,6 +25,9 @@
 #ifdef CONFIG_DISPLAY
 #include "lcd.h"
 #endif
+#ifdef CONFIG_APP_LCD_HEADLESS
+#include "lcd_headless.h"
+#endif
 
 LOG_MODULE_REGISTER(main);
 
@@ -33,6 +36,14 @@ LOG_MODULE_REGISTER(main);
 /******************************************************************************/
 void main(void)
 {
+#ifdef CONFIG_APP_LCD_HEADLESS
+	/* The render benchmark draws into memory and feeds the graph in
+	 * place of the sensor
+	 */
+	LCDHeadlessInit();
+	SetupLCD();
+	LCDHeadlessRun();
+#else
 	if (device_get_binding(DT_LABEL(DT_INST(0, st_lis2dh))) == NULL) {
 		printf("Could not get %s device\n",
 		       DT_LABEL(DT_INST(0, st_lis2dh)));
@@ -44,4 +55,5 @@ void main(void)
 #endif
 
 	ApplicationStart();
+#endif
 }
@@ -0,0 +1,289 @@
+/**
+ * @file spectrum.c
+ * @brief Sliding window FFT spectrum for the vibration display graph
+ *
+ * The sensor handler writes every sample into a ring twice the length of
+ * the FFT window, which costs the same as adding a point to the graph. When
+ * the render thread asks for a spectrum, a lower priority thread copies the
+ * latest window out of the ring and calculates a Hann windowed Q15 real FFT
+ * of each axis with CMSIS-DSP, so sampling and drawing are never held up
+ * by the FFT. The result is written into the spectrum which is not being
+ * shown and the two are swapped on the next frame, so the graph series can
+ * draw directly from the bins without a copy.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/atomic.h>
+#include <arm_math.h>
+
+#include "spectrum.h"
+#include "hann_spectrum.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define SPECTRUM_STACK_SIZE 2048
+/* Below the render thread, which is below the sensor driver thread */
+#define SPECTRUM_PRIORITY 12
+
+#define WINDOW_SAMPLES CONFIG_APP_LCD_SPECTRUM_SAMPLES
+
+/* The ring holds a second window of samples, so the sensor can keep
+ * writing while the latest window is copied out
+ */
+#define RING_SAMPLES (2 * WINDOW_SAMPLES)
+#define RING_MASK (RING_SAMPLES - 1)
+
+#define SPECTRUM_BUFFERS 2
+#define Q15_MAX 32767
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+/* Written by the sensor handler, the count of samples written is free
+ * running and wraps with the power of two ring size
+ */
+static int16_t spectrum_ring[SAMPLE_AXIS_COUNT][RING_SAMPLES];
+static atomic_t spectrum_written;
+
+/* Also checks the window length is a power of two, which the ring relies on */
+HANN_SPECTRUM_DEFINE(axis_spectrum, WINDOW_SAMPLES);
+
+/* Working buffers, only used by the spectrum thread */
+static q15_t window[SAMPLE_AXIS_COUNT][WINDOW_SAMPLES];
+static q15_t deviation[WINDOW_SAMPLES];
+static uint16_t amplitudes[SPECTRUM_BINS];
+
+/* The render thread draws from the shown spectrum while the spectrum
+ * thread writes the other, they are only swapped once it is complete
+ */
+static int16_t spectrum_bins[SPECTRUM_BUFFERS][SAMPLE_AXIS_COUNT]
+			    [SPECTRUM_BINS];
+static int16_t spectrum_peak[SPECTRUM_BUFFERS];
+static uint8_t spectrum_shown;
+static bool spectrum_pending;
+static atomic_t spectrum_ready;
+
+static struct spectrum_stats spectrum_stats;
+static struct k_spinlock spectrum_stats_lock;
+
+K_SEM_DEFINE(spectrum_request, 0, 1);
+
+K_THREAD_STACK_DEFINE(spectrum_stack_area, SPECTRUM_STACK_SIZE);
+static struct k_thread spectrum_thread_data;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static uint32_t spectrum_copy_window(void);
+static int16_t spectrum_axis(const q15_t *data, int16_t *bins);
+static void spectrum_record(uint32_t compute_us, uint32_t retries);
+static void spectrum_thread(void *unused1, void *unused2, void *unused3);
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/** @brief Copies the latest window of samples out of the ring, again if the
+ *  sensor wrote far enough round the ring to overwrite part of it before the
+ *  copy finished. Returns the number of repeated copies.
+ */
+static uint32_t spectrum_copy_window(void)
+{
+	uint32_t end;
+	uint32_t position;
+	uint32_t retries = 0;
+	uint32_t i;
+	uint8_t axis;
+
+	while (1) {
+		end = (uint32_t)atomic_get(&spectrum_written);
+		position = end - WINDOW_SAMPLES;
+
+		for (i = 0; i < WINDOW_SAMPLES; ++i, ++position) {
+			axis = 0;
+			while (axis < SAMPLE_AXIS_COUNT) {
+				window[axis][i] =
+					spectrum_ring[axis]
+						     [position & RING_MASK];
+				++axis;
+			}
+		}
+
+		if (((uint32_t)atomic_get(&spectrum_written) - end) <=
+		    (RING_SAMPLES - WINDOW_SAMPLES)) {
+			break;
+		}
+
+		++retries;
+	}
+
+	return retries;
+}
+
+/** @brief Hann windowed magnitude spectrum of the mean removed data, as bin
+ *  amplitudes in milli-g.
+ */
+static int16_t spectrum_axis(const q15_t *data, int16_t *bins)
+{
+	int32_t sum = 0;
+	int32_t value;
+	q15_t peak = 0;
+	int16_t largest = 0;
+	uint32_t i;
+
+	for (i = 0; i < WINDOW_SAMPLES; ++i) {
+		sum += data[i];
+	}
+	sum /= WINDOW_SAMPLES;
+
+	for (i = 0; i < WINDOW_SAMPLES; ++i) {
+		value = MAX(MIN(data[i] - sum, Q15_MAX), -Q15_MAX);
+		deviation[i] = (q15_t)value;
+		peak = MAX(peak, (q15_t)((value < 0) ? -value : value));
+	}
+
+	HannSpectrumAmplitudes(&axis_spectrum, deviation, peak, amplitudes);
+
+	for (i = 0; i < SPECTRUM_BINS; ++i) {
+		bins[i] = (int16_t)MIN(amplitudes[i], SPECTRUM_AMPLITUDE_MAX_MG);
+		largest = MAX(largest, bins[i]);
+	}
+
+	return largest;
+}
+
+static void spectrum_record(uint32_t compute_us, uint32_t retries)
+{
+	k_spinlock_key_t key = k_spin_lock(&spectrum_stats_lock);
+
+	++spectrum_stats.spectra;
+	spectrum_stats.compute_us = compute_us;
+	spectrum_stats.retries += retries;
+
+	if (compute_us > spectrum_stats.max_compute_us) {
+		spectrum_stats.max_compute_us = compute_us;
+	}
+
+	k_spin_unlock(&spectrum_stats_lock, key);
+}
+
+static void spectrum_thread(void *unused1, void *unused2, void *unused3)
+{
+	uint32_t start;
+	uint32_t retries;
+	uint8_t buffer;
+	uint8_t axis;
+	int16_t peak;
+
+	while (1) {
+		k_sem_take(&spectrum_request, K_FOREVER);
+		start = k_cycle_get_32();
+
+		/* The render thread does not swap the spectra while a
+		 * request is outstanding
+		 */
+		buffer = !spectrum_shown;
+		retries = spectrum_copy_window();
+
+		peak = 0;
+		axis = 0;
+		while (axis < SAMPLE_AXIS_COUNT) {
+			peak = MAX(peak,
+				   spectrum_axis(window[axis],
+						 spectrum_bins[buffer][axis]));
+			++axis;
+		}
+		spectrum_peak[buffer] = peak;
+
+		spectrum_record(k_cyc_to_us_floor32(k_cycle_get_32() - start),
+				retries);
+		atomic_set(&spectrum_ready, true);
+	}
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int SpectrumInit(void)
+{
+	if (HannSpectrumInit(&axis_spectrum) != 0) {
+		return -EINVAL;
+	}
+
+	k_thread_create(&spectrum_thread_data, spectrum_stack_area,
+			K_THREAD_STACK_SIZEOF(spectrum_stack_area),
+			spectrum_thread, NULL, NULL, NULL, SPECTRUM_PRIORITY, 0,
+			K_NO_WAIT);
+	k_thread_name_set(&spectrum_thread_data, "spectrum");
+
+	return 0;
+}
+
+void SpectrumAddSample(const int16_t *mg)
+{
+	uint32_t position = (uint32_t)atomic_get(&spectrum_written) & RING_MASK;
+	uint8_t axis = 0;
+
+	while (axis < SAMPLE_AXIS_COUNT) {
+		spectrum_ring[axis][position] = mg[axis];
+		++axis;
+	}
+
+	/* Only counted once written, the spectrum thread never reads past
+	 * the count
+	 */
+	atomic_inc(&spectrum_written);
+}
+
+bool SpectrumUpdate(void)
+{
+	bool updated = false;
+
+	if (atomic_cas(&spectrum_ready, true, false)) {
+		spectrum_shown = !spectrum_shown;
+		spectrum_pending = false;
+		updated = true;
+	}
+
+	if (!spectrum_pending) {
+		spectrum_pending = true;
+		k_sem_give(&spectrum_request);
+	}
+
+	return updated;
+}
+
+int16_t *SpectrumGetAxis(uint8_t axis)
+{
+	return spectrum_bins[spectrum_shown][axis];
+}
+
+int16_t SpectrumGetPeak(void)
+{
+	return spectrum_peak[spectrum_shown];
+}
+
+void SpectrumGetStats(struct spectrum_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&spectrum_stats_lock);
+
+	*stats = spectrum_stats;
+	k_spin_unlock(&spectrum_stats_lock, key);
+}
+
+void SpectrumResetStats(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&spectrum_stats_lock);
+
+	memset(&spectrum_stats, 0, sizeof(spectrum_stats));
+	k_spin_unlock(&spectrum_stats_lock, key);
+}